@@ -2,56 +2,69 @@
 
 
 #include "Block.h"
+#include "VoxelWorld.h"
 
 // Sets default values
 ABlock::ABlock()
 {
 	SM_Block = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("BlockMesh"));
 
-	Resistance = 20.f;
-	BreakingStage = 0.f;
-	MinimumMaterial = 0;
+	BlockType = 1;
+	BlockCoord = FIntVector::ZeroValue;
+	VoxelWorld = nullptr;
 }
 
 void ABlock::Break()
 {
-	++BreakingStage;
-	float CrackingValue = 1.0f - (BreakingStage / 5.f);
-
-	UMaterialInstanceDynamic* MatInstance = SM_Block->CreateDynamicMaterialInstance(0);
-
-	if (MatInstance != nullptr) // if we successfully got the instance
-	{
-		MatInstance->SetScalarParameterValue(FName("CrackingValue"), CrackingValue);
-	}
-
-	if (BreakingStage == 5.f)
+	if (VoxelWorld != nullptr)
 	{
-		OnBroken(true);
+		VoxelWorld->Break(BlockCoord);
 	}
 }
 
 void ABlock::ResetBlock()
 {
-	BreakingStage = 0;
-	UMaterialInstanceDynamic* MatInstance = SM_Block->CreateDynamicMaterialInstance(0);
-
-	if (MatInstance != nullptr)
+	if (VoxelWorld != nullptr)
 	{
-		MatInstance->SetScalarParameterValue(FName("CrackingValue"), 1.0f);
+		VoxelWorld->ResetBlock(BlockCoord);
 	}
 }
 
 void ABlock::OnBroken(bool HasRequiredPickaxe)
 {
-	Destroy();
+	if (VoxelWorld != nullptr)
+	{
+		VoxelWorld->OnBroken(BlockCoord, HasRequiredPickaxe);
+	}
+	else
+	{
+		Destroy();
+	}
 }
 
 // Called when the game starts or when spawned
 void ABlock::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	VoxelWorld = AVoxelWorld::Get(this);
+
+	if (VoxelWorld != nullptr)
+	{
+		// use the mesh bounds so it doesn't matter where the cube's pivot is
+		BlockCoord = VoxelWorld->WorldToBlock(SM_Block->Bounds.Origin);
+		VoxelWorld->RegisterBlockActor(this);
+	}
+}
+
+void ABlock::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (VoxelWorld != nullptr)
+	{
+		VoxelWorld->UnregisterBlockActor(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 
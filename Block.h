@@ -17,13 +17,12 @@ public:
 	UPROPERTY(EditDefaultsOnly)
 		UStaticMeshComponent* SM_Block;
 
-	uint8 MinimumMaterial;
+	//id of this block in the voxel world's block types, which hold its resistance and minimum material
+	UPROPERTY(EditAnywhere)
+		uint16 BlockType;
 
-	UPROPERTY(EditDefaultsOnly)
-		float Resistance;
-
-	UPROPERTY(BlueprintReadWrite)
-		float BreakingStage;
+	//the voxel cell this actor stands for, set once it registers with the voxel world
+	FIntVector BlockCoord;
 
 	//called every time we want to break the block down further
 	void Break();
@@ -37,4 +36,10 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	UPROPERTY()
+		class AVoxelWorld* VoxelWorld;
+
 };
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BlockInstancesComponent.h"
+#include "VoxelWorld.h"
+
+UBlockInstancesComponent::UBlockInstancesComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+}
+
+AVoxelWorld* UBlockInstancesComponent::GetVoxelWorld() const
+{
+	return Cast<AVoxelWorld>(GetOwner());
+}
+
+int32 UBlockInstancesComponent::AddBlock(const FIntVector& Block, const FTransform& InstanceTransform)
+{
+	const int32 InstanceIndex = InstanceBlocks.Add(Block);
+	BlockInstances.Add(Block, InstanceIndex);
+
+	// reuse a slot parked by an earlier removal before growing the instance buffer
+	if (InstanceIndex < GetInstanceCount())
+	{
+		UpdateInstanceTransform(InstanceIndex, InstanceTransform, true, true, true);
+	}
+	else
+	{
+		AddInstanceWorldSpace(InstanceTransform);
+	}
+
+	return InstanceIndex;
+}
+
+void UBlockInstancesComponent::RemoveBlock(int32 InstanceIndex)
+{
+	if (!InstanceBlocks.IsValidIndex(InstanceIndex))
+	{
+		return;
+	}
+
+	const int32 LastIndex = InstanceBlocks.Num() - 1;
+
+	BlockInstances.Remove(InstanceBlocks[InstanceIndex]);
+
+	if (InstanceIndex != LastIndex)
+	{
+		FTransform LastTransform;
+		GetInstanceTransform(LastIndex, LastTransform, true);
+
+		UpdateInstanceTransform(InstanceIndex, LastTransform, true, false, true);
+
+		InstanceBlocks[InstanceIndex] = InstanceBlocks[LastIndex];
+		BlockInstances[InstanceBlocks[InstanceIndex]] = InstanceIndex;
+	}
+
+	// park the tail slot out of sight until the next AddBlock picks it up
+	FTransform ParkedTransform;
+	GetInstanceTransform(LastIndex, ParkedTransform, true);
+	ParkedTransform.SetScale3D(FVector::ZeroVector);
+	UpdateInstanceTransform(LastIndex, ParkedTransform, true, true, true);
+
+	InstanceBlocks.Pop(false);
+}
+
+int32 UBlockInstancesComponent::FindBlockInstance(const FIntVector& Block) const
+{
+	const int32* InstanceIndex = BlockInstances.Find(Block);
+
+	return InstanceIndex != nullptr ? *InstanceIndex : INDEX_NONE;
+}
+
+void UBlockInstancesComponent::Break(int32 InstanceIndex)
+{
+	AVoxelWorld* VoxelWorld = GetVoxelWorld();
+
+	if (VoxelWorld != nullptr && InstanceBlocks.IsValidIndex(InstanceIndex))
+	{
+		VoxelWorld->Break(InstanceBlocks[InstanceIndex]);
+	}
+}
+
+void UBlockInstancesComponent::ResetBlock(int32 InstanceIndex)
+{
+	AVoxelWorld* VoxelWorld = GetVoxelWorld();
+
+	if (VoxelWorld != nullptr && InstanceBlocks.IsValidIndex(InstanceIndex))
+	{
+		VoxelWorld->ResetBlock(InstanceBlocks[InstanceIndex]);
+	}
+}
+
+void UBlockInstancesComponent::OnBroken(int32 InstanceIndex, bool HasRequiredPickaxe)
+{
+	AVoxelWorld* VoxelWorld = GetVoxelWorld();
+
+	if (VoxelWorld != nullptr && InstanceBlocks.IsValidIndex(InstanceIndex))
+	{
+		// the voxel world calls back into RemoveBlock once the cell is cleared
+		VoxelWorld->OnBroken(InstanceBlocks[InstanceIndex], HasRequiredPickaxe);
+	}
+}
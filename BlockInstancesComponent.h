@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "BlockInstancesComponent.generated.h"
+
+// Draws every block of one type as instances of that type's cube mesh. Live instances are
+// kept packed at the front: removing a block moves the last live instance into its slot and
+// parks the freed tail slot at zero scale for the next add, so the instance tree is never
+// rebuilt for a removal and other blocks never shift index.
+UCLASS()
+class MCUE_API UBlockInstancesComponent : public UHierarchicalInstancedStaticMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	UBlockInstancesComponent(const FObjectInitializer& ObjectInitializer);
+
+	// adds an instance for the block and returns its index
+	int32 AddBlock(const FIntVector& Block, const FTransform& InstanceTransform);
+
+	// swap removes the instance of a block
+	void RemoveBlock(int32 InstanceIndex);
+
+	// instance index of a block, INDEX_NONE if this component doesn't draw it
+	int32 FindBlockInstance(const FIntVector& Block) const;
+
+	const FIntVector& GetInstanceBlock(int32 InstanceIndex) const { return InstanceBlocks[InstanceIndex]; }
+
+	int32 GetNumBlocks() const { return InstanceBlocks.Num(); }
+
+	//called every time we want to break the block down further
+	void Break(int32 InstanceIndex);
+
+	void ResetBlock(int32 InstanceIndex);
+
+	//called once the block has hit the final breaking stage
+	void OnBroken(int32 InstanceIndex, bool HasRequiredPickaxe);
+
+private:
+	class AVoxelWorld* GetVoxelWorld() const;
+
+	// block drawn by each live instance, the live instances are [0, InstanceBlocks.Num())
+	TArray<FIntVector> InstanceBlocks;
+
+	TMap<FIntVector, int32> BlockInstances;
+};
@@ -0,0 +1,157 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BlockRegistry.h"
+#include "Engine/DataTable.h"
+#include "VoxelChunk.h"
+#include "VoxelLighting.h"
+
+FBlockRegistry::FBlockRegistry()
+	: NumGivenTypes(0)
+	, bHasLightEmitters(false)
+	, bHasRandomTickingBlocks(false)
+	, bHasFluids(false)
+{
+	// air only, so lookups are valid before Build is called
+	TArray<FVoxelBlockType> AirOnly;
+	AirOnly.AddDefaulted();
+	Build(AirOnly);
+}
+
+void FBlockRegistry::Build(const TArray<FVoxelBlockType>& InTypes)
+{
+	check(InTypes.Num() > 0);
+
+	Types = InTypes;
+
+	// whatever the data says, air is empty and can't be mined
+	FVoxelBlockType& AirType = Types[FVoxelChunk::Air];
+	AirType.Name = TEXT("Air");
+	AirType.Resistance = 0.f;
+	AirType.bOpaque = false;
+	AirType.LightEmission = 0;
+	AirType.bRandomTicks = false;
+	AirType.bFalls = false;
+	AirType.FluidFlowDistance = 0;
+
+	NumGivenTypes = Types.Num();
+
+	FluidSources.SetNumZeroed(NumGivenTypes);
+	FluidLevels.SetNumZeroed(NumGivenTypes);
+	FirstFlowingIds.SetNumZeroed(NumGivenTypes);
+	bHasFluids = false;
+
+	// every fluid owns MaxFluidFlowDistance ids after the given types, in the order of the fluids.
+	// Other fluids' flow distances don't move them.
+	int32 NumFluids = 0;
+
+	for (int32 SourceId = 0; SourceId < NumGivenTypes; ++SourceId)
+	{
+		FVoxelBlockType& Source = Types[SourceId];
+
+		if (Source.FluidFlowDistance == 0)
+		{
+			continue;
+		}
+
+		Source.FluidFlowDistance = (uint8)FMath::Min<int32>(Source.FluidFlowDistance, MaxFluidFlowDistance);
+		Source.FluidTickDelay = FMath::Max(1, Source.FluidTickDelay);
+		FluidSources[SourceId] = (uint16)SourceId;
+		FirstFlowingIds[SourceId] = (uint16)(NumGivenTypes + NumFluids * MaxFluidFlowDistance);
+		bHasFluids = true;
+
+		// a copy, growing Types may move the source
+		const FVoxelBlockType SourceType = Source;
+		const int32 RangeEnd = FirstFlowingIds[SourceId] + MaxFluidFlowDistance;
+		++NumFluids;
+
+		// ids past the fluid's flow distance are unused air, IsValidId turns them down
+		const int32 FirstNewId = Types.Num();
+		Types.SetNum(RangeEnd);
+		FluidSources.SetNumZeroed(RangeEnd);
+		FluidLevels.SetNumZeroed(RangeEnd);
+		FirstFlowingIds.SetNumZeroed(RangeEnd);
+
+		for (int32 Id = FirstNewId; Id < RangeEnd; ++Id)
+		{
+			Types[Id] = Types[FVoxelChunk::Air];
+		}
+
+		for (int32 Level = 1; Level <= SourceType.FluidFlowDistance; ++Level)
+		{
+			const int32 Id = FirstFlowingIds[SourceId] + Level - 1;
+
+			FVoxelBlockType& Flowing = Types[Id];
+			Flowing = SourceType;
+			Flowing.Name = FName(*FString::Printf(TEXT("%s_Flowing%d"), *SourceType.Name.ToString(), Level));
+
+			FluidSources[Id] = (uint16)SourceId;
+			FluidLevels[Id] = (uint8)Level;
+		}
+	}
+
+	check(Types.Num() <= MAX_uint16 + 1);
+
+	OpaqueFlags.SetNumUninitialized(Types.Num());
+	LightEmissions.SetNumUninitialized(Types.Num());
+	bHasLightEmitters = false;
+	RandomTickFlags.SetNumUninitialized(Types.Num());
+	bHasRandomTickingBlocks = false;
+	BreakIntervals.SetNumUninitialized(Types.Num() * NumTools * NumMaterialSlots);
+	IdsByName.Reset();
+
+	for (int32 Id = 0; Id < Types.Num(); ++Id)
+	{
+		const FVoxelBlockType& Type = Types[Id];
+
+		OpaqueFlags[Id] = Type.bOpaque ? 1 : 0;
+		LightEmissions[Id] = (uint8)FMath::Min<int32>(Type.LightEmission, FVoxelLighting::MaxLight);
+		bHasLightEmitters |= LightEmissions[Id] > 0;
+		RandomTickFlags[Id] = Type.bRandomTicks ? 1 : 0;
+		bHasRandomTickingBlocks |= Type.bRandomTicks;
+
+		if (IsValidId(Id))
+		{
+			IdsByName.Add(Type.Name, (uint16)Id);
+		}
+
+		const float BaseInterval = (Type.Resistance / 100.f) / 2;
+
+		for (int32 Tool = 0; Tool < NumTools; ++Tool)
+		{
+			// the right tool mines faster by its material's multiplier, anything else at hand speed
+			const bool bPreferredTool = Tool == (int32)Type.PreferredTool && Tool != (int32)ETool::Unarmed;
+
+			for (int32 Material = 0; Material < NumMaterialSlots; ++Material)
+			{
+				const float Speed = bPreferredTool ? FMath::Max(1, Material) : 1.f;
+				BreakIntervals[(Id * NumTools + Tool) * NumMaterialSlots + Material] = BaseInterval / Speed;
+			}
+		}
+	}
+}
+
+void FBlockRegistry::Build(const UDataTable& BlockTable)
+{
+	TArray<FVoxelBlockType> TableTypes;
+	TableTypes.AddDefaulted();
+
+	BlockTable.ForeachRow<FVoxelBlockType>(TEXT("FBlockRegistry::Build"), [&TableTypes](const FName& RowName, const FVoxelBlockType& Row)
+	{
+		FVoxelBlockType& Type = TableTypes.Add_GetRef(Row);
+
+		if (Type.Name.IsNone())
+		{
+			Type.Name = RowName;
+		}
+	});
+
+	Build(TableTypes);
+}
+
+uint16 FBlockRegistry::FindId(FName Name) const
+{
+	const uint16* Id = IdsByName.Find(Name);
+
+	return Id != nullptr ? *Id : FVoxelChunk::Air;
+}
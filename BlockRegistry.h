@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelBlockType.h"
+#include "Wieldable.h"
+
+class UDataTable;
+
+// Maps compact block ids to immutable block properties. The properties hot loops ask for are
+// also kept in flat arrays indexed by id, so meshing, lighting, AI and mining read a single
+// array slot without branching. Ids handed in must come from this registry. Every fluid type
+// gets MaxFluidFlowDistance ids for its flow levels right after the given types, so fluid levels
+// are stored, saved and lit like any other block and the tables stay as long as the registry.
+// Adding block types moves the flowing ids, saved chunks then read them as other blocks.
+class MCUE_API FBlockRegistry
+{
+public:
+	static constexpr int32 NumTools = (int32)ETool::Sword + 1;
+
+	// EMaterial values are the tool's speed multiplier and all fit below 16
+	static constexpr int32 NumMaterialSlots = 16;
+
+	// a fluid flows this far from its source at most, every level takes up a block id
+	static constexpr int32 MaxFluidFlowDistance = 15;
+
+	FBlockRegistry();
+
+	// id 0 must be air, every other entry gets its index as id
+	void Build(const TArray<FVoxelBlockType>& InTypes);
+
+	// rows get ids in table order starting at 1, air is added as id 0
+	void Build(const UDataTable& BlockTable);
+
+	int32 Num() const { return Types.Num(); }
+
+	// false for the flow level ids a fluid leaves unused by flowing less than MaxFluidFlowDistance
+	bool IsValidId(int32 Id) const { return Types.IsValidIndex(Id) && (Id < NumGivenTypes || FluidLevels[Id] > 0); }
+
+	FORCEINLINE const FVoxelBlockType& Get(uint16 Id) const
+	{
+		checkSlow(IsValidId(Id));
+		return Types[Id];
+	}
+
+	FORCEINLINE bool IsOpaque(uint16 Id) const
+	{
+		checkSlow(IsValidId(Id));
+		return OpaqueFlags[Id] != 0;
+	}
+
+	// light the block gives off, 0 to FVoxelLighting::MaxLight
+	FORCEINLINE uint8 GetLightEmission(uint16 Id) const
+	{
+		checkSlow(IsValidId(Id));
+		return LightEmissions[Id];
+	}
+
+	// false if no block type gives off light, lighting then skips looking for light sources
+	bool HasLightEmitters() const { return bHasLightEmitters; }
+
+	// true for blocks random block ticks are run on
+	FORCEINLINE bool IsRandomTicking(uint16 Id) const
+	{
+		checkSlow(IsValidId(Id));
+		return RandomTickFlags[Id] != 0;
+	}
+
+	// false if no block type takes random ticks, chunks then aren't sampled at all
+	bool HasRandomTickingBlocks() const { return bHasRandomTickingBlocks; }
+
+	// id of the source block of the fluid the block is part of, air for blocks that aren't fluids
+	FORCEINLINE uint16 GetFluidSource(uint16 Id) const
+	{
+		checkSlow(IsValidId(Id));
+		return FluidSources[Id];
+	}
+
+	FORCEINLINE bool IsFluid(uint16 Id) const { return GetFluidSource(Id) != 0; }
+
+	// 0 for fluid sources and blocks that aren't fluids, otherwise the blocks the fluid flowed from its source
+	FORCEINLINE uint8 GetFluidLevel(uint16 Id) const
+	{
+		checkSlow(IsValidId(Id));
+		return FluidLevels[Id];
+	}
+
+	// id of the fluid with the given source at a flow level, the source itself at level 0
+	FORCEINLINE uint16 GetFluidBlock(uint16 SourceId, int32 Level) const
+	{
+		checkSlow(IsValidId(SourceId) && Level <= Types[SourceId].FluidFlowDistance);
+		return Level == 0 ? SourceId : (uint16)(FirstFlowingIds[SourceId] + Level - 1);
+	}
+
+	bool HasFluids() const { return bHasFluids; }
+
+	// seconds between two breaking stages when mining the block with the given tool
+	FORCEINLINE float GetBreakInterval(uint16 Id, ETool Tool, EMaterial Material) const
+	{
+		checkSlow(IsValidId(Id));
+		return BreakIntervals[(Id * NumTools + (int32)Tool) * NumMaterialSlots + ((int32)Material & (NumMaterialSlots - 1))];
+	}
+
+	// id of the block type with the given name, air if there is none
+	uint16 FindId(FName Name) const;
+
+private:
+	TArray<FVoxelBlockType> Types;
+
+	// types passed to Build, air included
+	int32 NumGivenTypes;
+
+	// 1 for opaque blocks, indexed by id
+	TArray<uint8> OpaqueFlags;
+
+	// light emitted per id, already clamped to the light range
+	TArray<uint8> LightEmissions;
+
+	bool bHasLightEmitters;
+
+	// 1 for blocks that take random ticks, indexed by id
+	TArray<uint8> RandomTickFlags;
+
+	bool bHasRandomTickingBlocks;
+
+	// per id, see GetFluidSource and GetFluidLevel
+	TArray<uint16> FluidSources;
+	TArray<uint8> FluidLevels;
+
+	// per fluid source, the id of its first flow level
+	TArray<uint16> FirstFlowingIds;
+
+	bool bHasFluids;
+
+	// [id][tool][material] seconds between breaking stages
+	TArray<float> BreakIntervals;
+
+	TMap<FName, uint16> IdsByName;
+};
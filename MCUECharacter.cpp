@@ -10,10 +10,16 @@
 #include "HeadMountedDisplayFunctionLibrary.h"
 #include "Kismet/GameplayStatics.h"
 #include "MotionControllerComponent.h"
+#include "PickupManager.h"
+#include "VoxelStats.h"
+#include "VoxelWorld.h"
 #include "XRMotionControllerBase.h" // for FXRMotionControllerBase::RightHandSourceId
 
 DEFINE_LOG_CATEGORY_STATIC(LogFPChar, Warning, All);
 
+DECLARE_DWORD_COUNTER_STAT(TEXT("Block Checks"), STAT_BlockChecks, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Block Checks Skipped"), STAT_BlockChecksSkipped, STATGROUP_Voxel);
+
 //////////////////////////////////////////////////////////////////////////
 // AMCUECharacter
 
@@ -84,6 +90,23 @@ AMCUECharacter::AMCUECharacter()
 	//bUsingMotionControllers = true;
 
 	Reach = 250.f;
+	ToolType = ETool::Unarmed;
+	MaterialType = EMaterial::None;
+	bHasCurrentBlock = false;
+	VoxelWorld = nullptr;
+
+	BlockCheckMoveThreshold = 2.f;
+	BlockCheckAngleThreshold = 0.25f;
+	LastBlockCheckLocation = FVector::ZeroVector;
+	LastBlockCheckDirection = FVector::ZeroVector;
+	bBlockCheckDirty = true;
+	NumSkippedBlockChecks = 0;
+
+	Inventory.SetNum(NUM_OF_INVENTORY_SLOTS);
+
+	PickupRadius = 150.f;
+	PickupCheckInterval = 0.f;
+	TimeSinceLastPickupCheck = 0.f;
 }
 
 void AMCUECharacter::BeginPlay()
@@ -105,13 +128,39 @@ void AMCUECharacter::BeginPlay()
 		VR_Gun->SetHiddenInGame(true, true);
 		Mesh1P->SetHiddenInGame(false, true);
 	}
+
+	VoxelWorld = AVoxelWorld::Get(this);
+
+	if (VoxelWorld != nullptr)
+	{
+		VoxelWorld->OnBlockChanged.AddUObject(this, &AMCUECharacter::OnVoxelBlockChanged);
+		VoxelWorld->OnBlocksChanged.AddUObject(this, &AMCUECharacter::OnVoxelBlocksChanged);
+		VoxelWorld->OnChunkLoaded.AddUObject(this, &AMCUECharacter::OnVoxelChunkLoaded);
+	}
 }
 
 void AMCUECharacter::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	CheckForBlocks();
+	// the target can only change if we moved or the blocks around us did
+	if (ShouldCheckForBlocks())
+	{
+		CheckForBlocks();
+	}
+	else
+	{
+		++NumSkippedBlockChecks;
+		INC_DWORD_STAT(STAT_BlockChecksSkipped);
+	}
+
+	TimeSinceLastPickupCheck += DeltaTime;
+
+	if (TimeSinceLastPickupCheck >= PickupCheckInterval)
+	{
+		TimeSinceLastPickupCheck = 0.f;
+		CheckForPickups();
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -151,25 +200,58 @@ void AMCUECharacter::SetupPlayerInputComponent(class UInputComponent* PlayerInpu
 
 	InputComponent->BindAction("InventoryUp", IE_Pressed, this, &AMCUECharacter::MoveUpInventorySlot);
 	InputComponent->BindAction("InventoryDown", IE_Pressed, this, &AMCUECharacter::MoveDownInventorySlot);
+	InputComponent->BindAction("DropItem", IE_Pressed, this, &AMCUECharacter::DropCurrentItem);
 	InputComponent->BindAction("ExitGame", IE_Pressed, this, &AMCUECharacter::ExitGame);
 }
 
 bool AMCUECharacter::AddItemToInventory(AWieldable* Item)
 {
-	if (Item != NULL)
+	if (Item == nullptr)
 	{
-		const int32 AvailableSlot = Inventory.Find(nullptr);
+		return false;
+	}
+
+	Item->Count -= AddStackToInventory(Item->GetItemStack());
+	return Item->Count <= 0;
+}
 
-		if (AvailableSlot != INDEX_NONE)
+int32 AMCUECharacter::AddStackToInventory(const FItemStack& Stack)
+{
+	if (Stack.IsEmpty())
+	{
+		return 0;
+	}
+
+	const int32 MaxCount = Stack.GetMaxCount();
+	int32 NumLeft = Stack.Count;
+
+	// stacks of the same items first, then empty slots
+	for (int32 Pass = 0; Pass < 2 && NumLeft > 0; ++Pass)
+	{
+		for (FItemStack& Slot : Inventory)
 		{
-			Inventory[AvailableSlot] = Item;
-			return true;
+			if (Pass == 0 ? Slot.IsEmpty() || !Slot.CanStackWith(Stack) : !Slot.IsEmpty())
+			{
+				continue;
+			}
+
+			if (Slot.IsEmpty())
+			{
+				Slot = FItemStack(Stack.ItemClass, 0, Stack.Durability);
+			}
+
+			const int32 NumAdded = FMath::Min(NumLeft, MaxCount - Slot.Count);
+			Slot.Count += NumAdded;
+			NumLeft -= NumAdded;
+
+			if (NumLeft == 0)
+			{
+				break;
+			}
 		}
-
-		else return false;
 	}
 
-	return false;
+	return Stack.Count - NumLeft;
 }
 
 int32 AMCUECharacter::GetCurrentInventorySlot()
@@ -179,13 +261,18 @@ int32 AMCUECharacter::GetCurrentInventorySlot()
 
 UTexture2D* AMCUECharacter::GetThumbnailAtInventorySlot(uint8 Slot)
 {
-	if (Inventory[Slot] != NULL)
+	if (Inventory.IsValidIndex(Slot) && !Inventory[Slot].IsEmpty())
 	{
-		return Inventory[Slot]->PickupThumbnail;
+		return Inventory[Slot].ItemClass->GetDefaultObject<AWieldable>()->PickupThumbnail;
 	}
 	else return nullptr;
 }
 
+int32 AMCUECharacter::GetItemCountAtInventorySlot(uint8 Slot)
+{
+	return Inventory.IsValidIndex(Slot) && !Inventory[Slot].IsEmpty() ? Inventory[Slot].Count : 0;
+}
+
 void AMCUECharacter::OnFire()
 {
 
@@ -292,14 +379,79 @@ void AMCUECharacter::MoveDownInventorySlot()
 	CurrentInventorySlot = FMath::Abs((CurrentInventorySlot - 1) % NUM_OF_INVENTORY_SLOTS);
 }
 
+bool AMCUECharacter::PickUpItem(AWieldable* Item)
+{
+	if (Item == nullptr || !Item->bIsActive)
+	{
+		return false;
+	}
+
+	// whatever doesn't fit stays on the ground
+	const int32 NumLying = Item->Count;
+	const bool bTookAll = AddItemToInventory(Item);
+
+	if (Item->Count < NumLying)
+	{
+		FP_WieldedItem->SetSkeletalMesh(Item->WieldableMesh->SkeletalMesh);
+	}
+
+	if (!bTookAll)
+	{
+		return false;
+	}
+
+	Item->OnPickedUp();
+	return true;
+}
+
+void AMCUECharacter::CheckForPickups()
+{
+	APickupManager* PickupManager = APickupManager::Get(this);
+
+	if (PickupManager == nullptr)
+	{
+		return;
+	}
+
+	PickupsInReach.Reset();
+	PickupManager->FindPickupsInRadius(GetActorLocation(), PickupRadius, PickupsInReach);
+
+	// picking up takes items out of the grid, the list was copied out before that
+	for (AWieldable* Item : PickupsInReach)
+	{
+		PickUpItem(Item);
+	}
+}
+
+void AMCUECharacter::DropCurrentItem()
+{
+	APickupManager* PickupManager = APickupManager::Get(this);
+
+	if (PickupManager == nullptr || !Inventory.IsValidIndex(CurrentInventorySlot) || Inventory[CurrentInventorySlot].IsEmpty())
+	{
+		return;
+	}
+
+	FItemStack& Slot = Inventory[CurrentInventorySlot];
+
+	// past our own pickup radius, or the next check would take it straight back
+	const FVector Location = FirstPersonCameraComponent->GetComponentLocation() + FirstPersonCameraComponent->GetForwardVector() * (PickupRadius + 50.f);
+
+	if (PickupManager->SpawnPickup(FItemStack(Slot.ItemClass, 1, Slot.Durability), Location) != nullptr && --Slot.Count == 0)
+	{
+		Slot = FItemStack();
+	}
+}
+
 void AMCUECharacter::OnHit()
 {
 	PlayHitAnim();
 
-	if (CurrentBlock != nullptr) {
+	if (bHasCurrentBlock) {
 		bIsBreaking = true;
 
-		float TimeBetweenBreaks = ((CurrentBlock->Resistance) / 100.f) / 2;
+		// precomputed per block, tool and material by the block registry
+		float TimeBetweenBreaks = VoxelWorld->GetBlockRegistry().GetBreakInterval(VoxelWorld->GetBlock(CurrentBlock), ToolType, MaterialType);
 
 		GetWorld()->GetTimerManager().SetTimer(BlockBreakingHandle, this, &AMCUECharacter::BreakBlock, TimeBetweenBreaks, true);
 		GetWorld()->GetTimerManager().SetTimer(HitAnimHandle, this, &AMCUECharacter::PlayHitAnim, 0.4f, true);
@@ -313,6 +465,12 @@ void AMCUECharacter::EndHit()
 
 	bIsBreaking = false;
 
+	// letting go loses the progress on the block
+	if (bHasCurrentBlock)
+	{
+		VoxelWorld->ResetBlock(CurrentBlock);
+	}
+
 }
 
 void AMCUECharacter::PlayHitAnim()
@@ -330,46 +488,107 @@ void AMCUECharacter::PlayHitAnim()
 
 void AMCUECharacter::CheckForBlocks()
 {
-	FHitResult LinetraceHit;
+	if (VoxelWorld == nullptr)
+	{
+		return;
+	}
 
-	FVector StartTrace = FirstPersonCameraComponent->GetComponentLocation();
-	FVector EndTrace = (FirstPersonCameraComponent->GetForwardVector() * Reach) + StartTrace;
+	INC_DWORD_STAT(STAT_BlockChecks);
 
-	FCollisionQueryParams CQP;
-	CQP.AddIgnoredActor(this); // so the raycast ignores the player
+	FVector StartTrace = FirstPersonCameraComponent->GetComponentLocation();
+	FVector TraceDirection = FirstPersonCameraComponent->GetForwardVector();
 
-	GetWorld()->LineTraceSingleByChannel(LinetraceHit, StartTrace, EndTrace, ECollisionChannel::ECC_WorldDynamic, CQP);
+	LastBlockCheckLocation = StartTrace;
+	LastBlockCheckDirection = TraceDirection;
+	bBlockCheckDirty = false;
 
-	ABlock* PotentialBlock = Cast<ABlock>(LinetraceHit.GetActor());
+	// walk the voxel grid instead of asking the physics scene
+	FVoxelRayHit BlockHit;
+	const bool bFoundBlock = VoxelWorld->Raycast(StartTrace, TraceDirection, Reach, BlockHit);
+	const FIntVector PotentialBlock = BlockHit.Block;
 
-	if (PotentialBlock != CurrentBlock && CurrentBlock != nullptr)
+	if (bHasCurrentBlock && (!bFoundBlock || PotentialBlock != CurrentBlock))
 	{
-		CurrentBlock->ResetBlock();
+		VoxelWorld->ResetBlock(CurrentBlock);
 	}
 
-	if (PotentialBlock == NULL) {
-		CurrentBlock = nullptr;
+	if (!bFoundBlock) {
+		bHasCurrentBlock = false;
 		return;
 	}
 	else {
-		if (CurrentBlock != nullptr && !bIsBreaking)
+		if (bHasCurrentBlock && !bIsBreaking)
 		{
-			CurrentBlock->ResetBlock();
+			VoxelWorld->ResetBlock(CurrentBlock);
 		}
 		CurrentBlock = PotentialBlock;
+		bHasCurrentBlock = true;
+	}
+
+}
+
+bool AMCUECharacter::ShouldCheckForBlocks() const
+{
+	if (bBlockCheckDirty)
+	{
+		return true;
 	}
 
+	const FVector CameraLocation = FirstPersonCameraComponent->GetComponentLocation();
+	const FVector CameraDirection = FirstPersonCameraComponent->GetForwardVector();
+
+	return FVector::DistSquared(CameraLocation, LastBlockCheckLocation) > FMath::Square(BlockCheckMoveThreshold)
+		|| FVector::DotProduct(CameraDirection, LastBlockCheckDirection) < FMath::Cos(FMath::DegreesToRadians(BlockCheckAngleThreshold));
+}
+
+void AMCUECharacter::OnVoxelBlockChanged(const FIntVector& Block)
+{
+	// anything past reach plus a block can't become or stop being our target
+	const float CheckRadius = Reach + VoxelWorld->BlockSize;
+
+	if (FVector::DistSquared(VoxelWorld->GetBlockCenter(Block), LastBlockCheckLocation) <= FMath::Square(CheckRadius))
+	{
+		bBlockCheckDirty = true;
+	}
+}
+
+void AMCUECharacter::OnVoxelBlocksChanged(const FIntVector& Min, const FIntVector& Max)
+{
+	const float CheckRadius = Reach + VoxelWorld->BlockSize;
+	const FBox Bounds(VoxelWorld->BlockToWorld(Min), VoxelWorld->BlockToWorld(Max + FIntVector(1)));
+
+	if (Bounds.ComputeSquaredDistanceToPoint(LastBlockCheckLocation) <= FMath::Square(CheckRadius))
+	{
+		bBlockCheckDirty = true;
+	}
+}
+
+void AMCUECharacter::OnVoxelChunkLoaded(const FIntPoint& ChunkCoord)
+{
+	// the chunk under the camera or one of its neighbours can hold blocks within reach
+	const FIntPoint CameraChunk = FVoxelChunk::ToChunkCoord(VoxelWorld->WorldToBlock(LastBlockCheckLocation));
+
+	if (FMath::Abs(ChunkCoord.X - CameraChunk.X) <= 1 && FMath::Abs(ChunkCoord.Y - CameraChunk.Y) <= 1)
+	{
+		bBlockCheckDirty = true;
+	}
 }
 
 void AMCUECharacter::BreakBlock()
 {
-	if (bIsBreaking && CurrentBlock != nullptr && !CurrentBlock->IsPendingKill()) {
-		CurrentBlock->Break();
+	if (bIsBreaking && bHasCurrentBlock && VoxelWorld->GetBlock(CurrentBlock) != FVoxelChunk::Air) {
+		VoxelWorld->Break(CurrentBlock);
 	}
 }
 
 void AMCUECharacter::ExitGame()
 {
+	// waits for the write so nothing is left to a background thread the quit may cut short
+	if (VoxelWorld != nullptr)
+	{
+		VoxelWorld->SaveWorld(true);
+	}
+
 	UKismetSystemLibrary::QuitGame(GetWorld(), nullptr, EQuitPreference::Quit, 0);
 }
 
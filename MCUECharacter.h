@@ -84,10 +84,16 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
 	uint32 bUsingMotionControllers : 1;
 
-	// add item to inventory
+	// adds the items lying here to the inventory and takes what fit off the item's Count. Returns
+	// whether all of them fit.
 	UFUNCTION(BlueprintCallable, Category = Inventory)
 		bool AddItemToInventory(AWieldable* Item);
 
+	// adds the items to the inventory, topping up stacks of the same items before using empty
+	// slots. Returns how many of them fit.
+	UFUNCTION(BlueprintCallable, Category = Inventory)
+		int32 AddStackToInventory(const FItemStack& Stack);
+
 	UFUNCTION(BlueprintPure, Category = HUD)
 		int32 GetCurrentInventorySlot();
 
@@ -95,10 +101,37 @@ public:
 	UFUNCTION(BlueprintPure, Category = Inventory)
 		UTexture2D* GetThumbnailAtInventorySlot(uint8 Slot);
 
+	// how many items the slot holds
+	UFUNCTION(BlueprintPure, Category = Inventory)
+		int32 GetItemCountAtInventorySlot(uint8 Slot);
+
 	//the type of tool and material of currently wielded item
 	ETool ToolType;
 	EMaterial MaterialType;
 
+	/** How far the camera has to move, in world units, before the targeted block is looked up again. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
+	float BlockCheckMoveThreshold;
+
+	/** How far the camera has to turn, in degrees, before the targeted block is looked up again. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
+	float BlockCheckAngleThreshold;
+
+	/** How close, in world units, items lying in the world have to be to be picked up. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Inventory)
+	float PickupRadius;
+
+	/** Seconds between looking for items to pick up, 0 to look every frame. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Inventory)
+	float PickupCheckInterval;
+
+	// takes as many of the items lying there as fit into the inventory, true if it took all of them
+	bool PickUpItem(AWieldable* Item);
+
+	// number of frames that reused the cached target instead of tracing again
+	UFUNCTION(BlueprintPure, Category = Gameplay)
+		int32 GetNumSkippedBlockChecks() const { return NumSkippedBlockChecks; }
+
 protected:
 	
 	/** Fires a projectile. */
@@ -159,6 +192,17 @@ private:
 	void MoveUpInventorySlot();
 	void MoveDownInventorySlot();
 
+	// drops one item of the current slot in front of the player
+	void DropCurrentItem();
+
+	// picks up the items lying within PickupRadius
+	void CheckForPickups();
+
+	float TimeSinceLastPickupCheck;
+
+	// reused by CheckForPickups, items found in reach this check
+	TArray<AWieldable*> PickupsInReach;
+
 	//true if player is breaking blocks
 	bool bIsBreaking;
 
@@ -172,11 +216,39 @@ private:
 	// check if there is a block in front of a player
 	void CheckForBlocks();
 
+	// true if the camera moved enough or the world changed near us since the last CheckForBlocks
+	bool ShouldCheckForBlocks() const;
+
+	// marks the target out of date when a block within reach changes
+	void OnVoxelBlockChanged(const FIntVector& Block);
+
+	// the same for a bulk edit, which reports the box around everything it changed
+	void OnVoxelBlocksChanged(const FIntVector& Min, const FIntVector& Max);
+
+	// marks the target out of date when terrain shows up around us
+	void OnVoxelChunkLoaded(const FIntPoint& ChunkCoord);
+
 	//Called when we want to break a block
 	void BreakBlock();
 
 	// Stores the block currently being looked at by the player
-	ABlock* CurrentBlock;
+	FIntVector CurrentBlock;
+
+	// true if CurrentBlock holds a block the player is looking at
+	bool bHasCurrentBlock;
+
+	// camera placement CheckForBlocks last ran with
+	FVector LastBlockCheckLocation;
+	FVector LastBlockCheckDirection;
+
+	// set when the world was edited within reach, forces the next CheckForBlocks
+	bool bBlockCheckDirty;
+
+	int32 NumSkippedBlockChecks;
+
+	// the voxel world the blocks we mine live in
+	UPROPERTY()
+	class AVoxelWorld* VoxelWorld;
 
 	// the character's reach
 	float Reach;
@@ -185,8 +257,9 @@ private:
 	FTimerHandle BlockBreakingHandle;
 	FTimerHandle HitAnimHandle;
 
+	// one stack per slot, empty stacks for empty slots
 	UPROPERTY(EditAnywhere)
-	TArray<AWieldable*> Inventory;
+	TArray<FItemStack> Inventory;
 
 	void ExitGame();
 
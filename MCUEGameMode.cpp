@@ -6,6 +6,9 @@
 #include "UObject/ConstructorHelpers.h"
 #include "Blueprint/UserWidget.h"
 #include "MCUECharacter.h"
+#include "PickupManager.h"
+#include "VoxelWorld.h"
+#include "EngineUtils.h"
 #include "Kismet/GameplayStatics.h"
 //#include <Runtime/Engine/Private/GameplayStatics.cpp>
 
@@ -16,40 +19,39 @@ void AMCUEGameMode::BeginPlay()
 
 void AMCUEGameMode::ApplyHUDChanges()
 {
-	// remove the previous hud since we are applying a new one 
+	// hide the previous hud, it stays cached in the viewport for the next time its state comes up
 	if (CurrentWidget != nullptr)
 	{
-		CurrentWidget->RemoveFromParent();
+		CurrentWidget->SetVisibility(ESlateVisibility::Collapsed);
+		CurrentWidget = nullptr;
 	}
 
 	// check the hud state and apply the hud corresponding to whatever hud should be open
 	switch(HUDState)
 	{
-		case EHUDState::HS_Ingame:
-		{
-			ApplyHUD(IngameHUDClass, false, false);
-		}
-
 		case EHUDState::HS_Inventory:
 		{
-			ApplyHUD(InventoryHUDClass, true, true);
+			ApplyHUD(HUDState, InventoryHUDClass, true, true);
+			break;
 		}
 
 		case EHUDState::HS_Craft_Menu:
 		{
-			ApplyHUD(CraftMenuHUDClass, true, true);
+			ApplyHUD(HUDState, CraftMenuHUDClass, true, true);
+			break;
 		}
 
 		default:
 		{
-			ApplyHUD(IngameHUDClass, false, false);
+			ApplyHUD(EHUDState::HS_Ingame, IngameHUDClass, false, false);
+			break;
 		}
 	}
 }
 
 EHUDState AMCUEGameMode::GetHUDState()
 {
-	return EHUDState();
+	return HUDState;
 }
 
 void AMCUEGameMode::ChangeHUDState(EHUDState NewState)
@@ -58,32 +60,66 @@ void AMCUEGameMode::ChangeHUDState(EHUDState NewState)
 	ApplyHUDChanges();
 }
 
-bool AMCUEGameMode::ApplyHUD(TSubclassOf<class UUserWidget> WidgetToApply, bool ShowMouseCursor, bool EnableClickEvents)
+bool AMCUEGameMode::ApplyHUD(EHUDState State, TSubclassOf<class UUserWidget> WidgetToApply, bool ShowMouseCursor, bool EnableClickEvents)
 {
-	// Get a ref to the player and the controller
-	AMCUECharacter* MyCharacter = Cast<AMCUECharacter>(UGameplayStatics::GetPlayerCharacter(this, 0));
+	// Get a ref to the controller
 	APlayerController* MyController = GetWorld()->GetFirstPlayerController();
 	
-	if (WidgetToApply != nullptr) 
+	if (WidgetToApply != nullptr && MyController != nullptr) 
 	{
 		MyController->bShowMouseCursor = ShowMouseCursor;
 		MyController->bEnableClickEvents = EnableClickEvents;
 
-		CurrentWidget = CreateWidget<UUserWidget>(GetWorld(), WidgetToApply);
+		FCachedHUDWidget& Cached = HUDWidgets.FindOrAdd(State);
 
-		if (CurrentWidget != nullptr)
+		// only the first time a state comes up builds its widget, after that it is shown again
+		if (Cached.Widget == nullptr)
 		{
-			CurrentWidget->AddToViewport();
-			return true;
+			Cached.Widget = CreateWidget<UUserWidget>(GetWorld(), WidgetToApply);
+
+			if (Cached.Widget == nullptr)
+			{
+				return false;
+			}
+
+			Cached.ShownVisibility = Cached.Widget->GetVisibility();
+			Cached.Widget->AddToViewport();
 		}
-		else {
-			return false;
+		else
+		{
+			Cached.Widget->SetVisibility(Cached.ShownVisibility);
 		}
+
+		CurrentWidget = Cached.Widget;
+		return true;
 	} else{
 		return false;
 	}
 }
 
+AVoxelWorld* AMCUEGameMode::GetVoxelWorld()
+{
+	if (VoxelWorld == nullptr)
+	{
+		// prefer a voxel world the level designer placed
+		TActorIterator<AVoxelWorld> It(GetWorld());
+		VoxelWorld = It ? *It : GetWorld()->SpawnActor<AVoxelWorld>(VoxelWorldClass != nullptr ? *VoxelWorldClass : AVoxelWorld::StaticClass());
+	}
+
+	return VoxelWorld;
+}
+
+APickupManager* AMCUEGameMode::GetPickupManager()
+{
+	if (PickupManager == nullptr)
+	{
+		TActorIterator<APickupManager> It(GetWorld());
+		PickupManager = It ? *It : GetWorld()->SpawnActor<APickupManager>(PickupManagerClass != nullptr ? *PickupManagerClass : APickupManager::StaticClass());
+	}
+
+	return PickupManager;
+}
+
 AMCUEGameMode::AMCUEGameMode() 
 	: Super()
 {
@@ -94,4 +130,9 @@ AMCUEGameMode::AMCUEGameMode()
 	// use our custom HUD class
 	HUDClass = AMCUEHUD::StaticClass();
 	HUDState = EHUDState::HS_Ingame;
+	VoxelWorldClass = AVoxelWorld::StaticClass();
+	VoxelWorld = nullptr;
+	CurrentWidget = nullptr;
+	PickupManagerClass = APickupManager::StaticClass();
+	PickupManager = nullptr;
 }
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Components/SlateWrapperTypes.h"
 #include "GameFramework/GameModeBase.h"
 #include "MCUEGameMode.generated.h"
 
@@ -14,6 +15,25 @@ enum class EHUDState : uint8
 	HS_Craft_Menu
 };
 
+// the widget of one hud state, created the first time the state comes up and kept for the rest of the game
+USTRUCT()
+struct FCachedHUDWidget
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		class UUserWidget* Widget;
+
+	// what the widget was set to show as while it wasn't hidden
+	ESlateVisibility ShownVisibility;
+
+	FCachedHUDWidget()
+		: Widget(nullptr)
+		, ShownVisibility(ESlateVisibility::Visible)
+	{
+	}
+};
+
 UCLASS(minimalapi)
 class AMCUEGameMode : public AGameModeBase
 {
@@ -30,12 +50,18 @@ class AMCUEGameMode : public AGameModeBase
 	UFUNCTION(BlueprintCallable, Category = "HUD Functions")
 	void ChangeHUDState(EHUDState NewState);
 
-	// applies the hud to the screen. true if successful, false otherwise
-	bool ApplyHUD(TSubclassOf<class UUserWidget> WidgetToApply, bool ShowMouseCursor, bool EnableClickEvents);
+	// shows the hud of the state, creating it the first time. true if successful, false otherwise
+	bool ApplyHUD(EHUDState State, TSubclassOf<class UUserWidget> WidgetToApply, bool ShowMouseCursor, bool EnableClickEvents);
 
 public:
 	AMCUEGameMode();
 
+	// the voxel world holding the level's blocks, found or spawned on first use
+	class AVoxelWorld* GetVoxelWorld();
+
+	// the actor driving the level's dropped items, found or spawned on first use
+	class APickupManager* GetPickupManager();
+
 protected:
 	// the current hudstate
 	EHUDState HUDState;
@@ -53,7 +79,26 @@ protected:
 		TSubclassOf<class UUserWidget> CraftMenuHUDClass;
 
 	// the current hud being display on the screen
-	class UUserWidget* CurrentWidget;
+	UPROPERTY()
+		class UUserWidget* CurrentWidget;
+
+	// every hud created so far, the ones not being displayed are collapsed in the viewport
+	UPROPERTY()
+		TMap<EHUDState, FCachedHUDWidget> HUDWidgets;
+
+	// the voxel world class to spawn when the level doesn't have one placed
+	UPROPERTY(EditDefaultsOnly, Category = "Voxel")
+		TSubclassOf<class AVoxelWorld> VoxelWorldClass;
+
+	UPROPERTY()
+		class AVoxelWorld* VoxelWorld;
+
+	// the pickup manager class to spawn when the level doesn't have one placed
+	UPROPERTY(EditDefaultsOnly, Category = "Pickups")
+		TSubclassOf<class APickupManager> PickupManagerClass;
+
+	UPROPERTY()
+		class APickupManager* PickupManager;
 };
 
 
@@ -0,0 +1,272 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PickupManager.h"
+#include "MCUEGameMode.h"
+#include "VoxelStats.h"
+#include "Wieldable.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Pickup Spin"), STAT_PickupSpin, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Live Pickups"), STAT_LivePickups, STATGROUP_Voxel);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pickups Turned"), STAT_PickupsTurned, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Pickups"), STAT_PooledPickups, STATGROUP_Voxel);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pickup Pool Hits"), STAT_PickupPoolHits, STATGROUP_Voxel);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pickup Pool Misses"), STAT_PickupPoolMisses, STATGROUP_Voxel);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Pickup Pool Hit Rate %"), STAT_PickupPoolHitRate, STATGROUP_Voxel);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pickup Merges"), STAT_PickupMerges, STATGROUP_Voxel);
+DECLARE_CYCLE_STAT(TEXT("Pickup Queries"), STAT_PickupQueries, STATGROUP_Voxel);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pickup Cells Searched"), STAT_PickupCellsSearched, STATGROUP_Voxel);
+
+APickupManager::APickupManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	SpinDegreesPerSecond = 60.f;
+	OffscreenSpinDelay = 0.2f;
+	MergeRadius = 150.f;
+	PickupCellSize = 400.f;
+	MaxPooledPickups = 64;
+
+	NumPooledItems = 0;
+	NumPoolHits = 0;
+	NumPoolMisses = 0;
+	NumMerges = 0;
+}
+
+APickupManager* APickupManager::Get(const UObject* WorldContextObject)
+{
+	AMCUEGameMode* GameMode = Cast<AMCUEGameMode>(UGameplayStatics::GetGameMode(WorldContextObject));
+
+	return GameMode != nullptr ? GameMode->GetPickupManager() : nullptr;
+}
+
+void APickupManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SCOPE_CYCLE_COUNTER(STAT_PickupSpin);
+
+	// the same angle for everyone this frame, each item adds it to where it started
+	const float Spin = FMath::Fmod(GetWorld()->GetTimeSeconds() * SpinDegreesPerSecond, 360.f);
+
+	for (int32 Index = 0; Index < Pickups.Num(); ++Index)
+	{
+		USkeletalMeshComponent* Mesh = Pickups[Index]->WieldableMesh;
+
+		if (Mesh == nullptr || !Mesh->WasRecentlyRendered(OffscreenSpinDelay))
+		{
+			continue;
+		}
+
+		const FRotator& Start = SpinStartRotations[Index];
+		Mesh->SetRelativeRotation(FRotator(Start.Pitch, Start.Yaw + Spin, Start.Roll));
+		INC_DWORD_STAT(STAT_PickupsTurned);
+	}
+
+	SET_DWORD_STAT(STAT_LivePickups, Pickups.Num());
+	SET_DWORD_STAT(STAT_PooledPickups, NumPooledItems);
+
+	const int32 NumDrops = NumPoolHits + NumPoolMisses;
+	SET_FLOAT_STAT(STAT_PickupPoolHitRate, NumDrops > 0 ? 100.f * NumPoolHits / NumDrops : 0.f);
+}
+
+AWieldable* APickupManager::SpawnPickup(const FItemStack& Stack, const FVector& Location)
+{
+	if (Stack.IsEmpty())
+	{
+		return nullptr;
+	}
+
+	const int32 MaxCount = Stack.GetMaxCount();
+	int32 NumLeft = Stack.Count;
+	AWieldable* Item = nullptr;
+
+	while (NumLeft > 0)
+	{
+		// a full stack nearby is passed over, the rest starts a stack of its own
+		if (AWieldable* Target = FindMergeTarget(Stack, Location))
+		{
+			const int32 NumAdded = FMath::Min(NumLeft, MaxCount - Target->Count);
+			Target->Count += NumAdded;
+			NumLeft -= NumAdded;
+			Item = Target;
+
+			++NumMerges;
+			INC_DWORD_STAT(STAT_PickupMerges);
+			continue;
+		}
+
+		FPickupPool* Pool = Pools.Find(Stack.ItemClass);
+
+		if (Pool != nullptr && Pool->Items.Num() > 0)
+		{
+			Item = Pool->Items.Pop(false);
+			--NumPooledItems;
+
+			Item->SetActorLocationAndRotation(Location, FRotator::ZeroRotator);
+			Item->SetActorHiddenInGame(false);
+
+			++NumPoolHits;
+			INC_DWORD_STAT(STAT_PickupPoolHits);
+		}
+		else
+		{
+			FActorSpawnParameters SpawnParameters;
+			SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+			Item = GetWorld()->SpawnActor<AWieldable>(Stack.ItemClass, Location, FRotator::ZeroRotator, SpawnParameters);
+
+			if (Item == nullptr)
+			{
+				break;
+			}
+
+			++NumPoolMisses;
+			INC_DWORD_STAT(STAT_PickupPoolMisses);
+		}
+
+		Item->Count = FMath::Min(NumLeft, MaxCount);
+		Item->Durability = Stack.Durability;
+		Item->bIsActive = true;
+		NumLeft -= Item->Count;
+
+		AddPickup(Item);
+	}
+
+	return Item;
+}
+
+void APickupManager::ReleasePickup(AWieldable* Item)
+{
+	if (Item == nullptr)
+	{
+		return;
+	}
+
+	RemovePickup(Item);
+	Item->bIsActive = false;
+
+	FPickupPool& Pool = Pools.FindOrAdd(Item->GetClass());
+
+	if (Pool.Items.Num() >= MaxPooledPickups)
+	{
+		Item->Destroy();
+		return;
+	}
+
+	// hidden and out of the grid the item costs nothing until it is dropped again
+	Item->SetActorHiddenInGame(true);
+
+	Pool.Items.Add(Item);
+	++NumPooledItems;
+}
+
+AWieldable* APickupManager::FindMergeTarget(const FItemStack& Stack, const FVector& Location) const
+{
+	const int32 MaxCount = Stack.GetMaxCount();
+
+	TArray<AWieldable*> Nearby;
+	FindPickupsInRadius(Location, MergeRadius, Nearby);
+
+	for (AWieldable* Item : Nearby)
+	{
+		if (Item->bIsActive && Item->Count < MaxCount && Item->GetItemStack().CanStackWith(Stack))
+		{
+			return Item;
+		}
+	}
+
+	return nullptr;
+}
+
+void APickupManager::FindPickupsInRadius(const FVector& Center, float Radius, TArray<AWieldable*>& OutItems) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_PickupQueries);
+
+	const FIntVector MinCell = GetPickupCell(Center - FVector(Radius));
+	const FIntVector MaxCell = GetPickupCell(Center + FVector(Radius));
+	const float RadiusSquared = FMath::Square(Radius);
+
+	for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+			{
+				INC_DWORD_STAT(STAT_PickupCellsSearched);
+
+				const TArray<AWieldable*>* Cell = PickupCells.Find(FIntVector(X, Y, Z));
+
+				if (Cell == nullptr)
+				{
+					continue;
+				}
+
+				for (AWieldable* Item : *Cell)
+				{
+					if (FVector::DistSquared(Item->GetActorLocation(), Center) <= RadiusSquared)
+					{
+						OutItems.Add(Item);
+					}
+				}
+			}
+		}
+	}
+}
+
+FIntVector APickupManager::GetPickupCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / PickupCellSize),
+		FMath::FloorToInt(Location.Y / PickupCellSize),
+		FMath::FloorToInt(Location.Z / PickupCellSize));
+}
+
+void APickupManager::AddPickup(AWieldable* Item)
+{
+	if (Item == nullptr || Item->PickupIndex != INDEX_NONE || Item->WieldableMesh == nullptr)
+	{
+		return;
+	}
+
+	// taken back by the spin of the current frame, so the item doesn't jump when it starts
+	FRotator Start = Item->WieldableMesh->GetRelativeRotation();
+	Start.Yaw -= FMath::Fmod(GetWorld()->GetTimeSeconds() * SpinDegreesPerSecond, 360.f);
+
+	Item->PickupIndex = Pickups.Add(Item);
+	SpinStartRotations.Add(Start);
+
+	Item->PickupCell = GetPickupCell(Item->GetActorLocation());
+	PickupCells.FindOrAdd(Item->PickupCell).Add(Item);
+}
+
+void APickupManager::RemovePickup(AWieldable* Item)
+{
+	if (Item == nullptr || !Pickups.IsValidIndex(Item->PickupIndex) || Pickups[Item->PickupIndex] != Item)
+	{
+		return;
+	}
+
+	const int32 Index = Item->PickupIndex;
+	Item->PickupIndex = INDEX_NONE;
+
+	TArray<AWieldable*>& Cell = PickupCells.FindChecked(Item->PickupCell);
+	Cell.RemoveSingleSwap(Item, false);
+
+	if (Cell.Num() == 0)
+	{
+		PickupCells.Remove(Item->PickupCell);
+	}
+
+	// the last item moves into the gap
+	Pickups.RemoveAtSwap(Index, 1, false);
+	SpinStartRotations.RemoveAtSwap(Index, 1, false);
+
+	if (Index < Pickups.Num())
+	{
+		Pickups[Index]->PickupIndex = Index;
+	}
+}
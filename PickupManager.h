@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PickupManager.generated.h"
+
+class AWieldable;
+struct FItemStack;
+
+// picked up items of one class, hidden and waiting to be dropped again
+USTRUCT()
+struct FPickupPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		TArray<AWieldable*> Items;
+};
+
+// Looks after every item lying in the level. Items are turned from one tick, so the items themselves
+// never tick. The spin is worked out from the game time instead of being added up a frame at a time,
+// which keeps it at the same speed whatever the frame rate and lets an item that was skipped for a
+// while pick up where the others are. Items that haven't been rendered lately are skipped. Picked up
+// items are hidden and kept for the next drop of their class instead of being destroyed, and a drop
+// next to a pile of the same items is added to that pile. Items lying in the world are sorted into a
+// grid of cells by location, characters look for pickups in reach through it instead of every item
+// keeping a trigger in the physics scene.
+UCLASS()
+class MCUE_API APickupManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	APickupManager();
+
+	// the pickup manager of the current game, spawned on first use
+	static APickupManager* Get(const UObject* WorldContextObject);
+
+	virtual void Tick(float DeltaTime) override;
+
+	//how fast dropped items turn around their vertical axis
+	UPROPERTY(EditAnywhere, Category = Pickups)
+		float SpinDegreesPerSecond;
+
+	//items that weren't rendered for this many seconds stop turning until they are seen again
+	UPROPERTY(EditAnywhere, Category = Pickups, meta = (ClampMin = "0"))
+		float OffscreenSpinDelay;
+
+	//drops closer than this to items of the same kind join their stack instead of lying next to it
+	UPROPERTY(EditAnywhere, Category = Pickups, meta = (ClampMin = "0"))
+		float MergeRadius;
+
+	//edge of the grid cells items are sorted into, about the largest pickup radius works best
+	UPROPERTY(EditAnywhere, Category = Pickups, meta = (ClampMin = "1"))
+		float PickupCellSize;
+
+	//picked up items kept for reuse per item class, past this they are destroyed
+	UPROPERTY(EditAnywhere, Category = Pickups, meta = (ClampMin = "0"))
+		int32 MaxPooledPickups;
+
+	// puts the items into the world at Location, onto nearby stacks of the same items first and as
+	// pooled or new actors after that. Returns the actor holding the last of them.
+	AWieldable* SpawnPickup(const FItemStack& Stack, const FVector& Location);
+
+	// takes a picked up item out of the world and keeps it for the next drop of its class
+	void ReleasePickup(AWieldable* Item);
+
+	// adds an item lying in the world to the grid and starts turning its mesh from the rotation it
+	// has now, adding it twice does nothing. Items don't move while they are added.
+	void AddPickup(AWieldable* Item);
+
+	void RemovePickup(AWieldable* Item);
+
+	// adds every item lying within Radius of Center to OutItems
+	void FindPickupsInRadius(const FVector& Center, float Radius, TArray<AWieldable*>& OutItems) const;
+
+	int32 GetNumPickups() const { return Pickups.Num(); }
+
+	// drops that reused a pooled item and drops that spawned one, since the game started
+	int32 GetNumPoolHits() const { return NumPoolHits; }
+	int32 GetNumPoolMisses() const { return NumPoolMisses; }
+
+	// drops that went onto a stack already lying there
+	int32 GetNumMerges() const { return NumMerges; }
+
+private:
+	// a live item within MergeRadius of Location that Stack can be added to, null if there is none
+	AWieldable* FindMergeTarget(const FItemStack& Stack, const FVector& Location) const;
+
+	FIntVector GetPickupCell(const FVector& Location) const;
+
+	// every item lying in the world, Item->PickupIndex is its index in here and in SpinStartRotations
+	UPROPERTY()
+		TArray<AWieldable*> Pickups;
+
+	// relative rotation of each item's mesh when it started turning
+	TArray<FRotator> SpinStartRotations;
+
+	// the items of Pickups in each grid cell, kept alive by Pickups
+	TMap<FIntVector, TArray<AWieldable*>> PickupCells;
+
+	UPROPERTY()
+		TMap<UClass*, FPickupPool> Pools;
+
+	int32 NumPooledItems;
+	int32 NumPoolHits;
+	int32 NumPoolMisses;
+	int32 NumMerges;
+};
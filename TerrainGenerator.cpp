@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainGenerator.h"
+#include "BlockRegistry.h"
+#include "VoxelChunk.h"
+#include "Misc/Crc.h"
+
+namespace
+{
+	// edge of the noise cubes caves are carved from, one chunk wide
+	constexpr int32 CaveCubeSize = FVoxelChunk::SizeX;
+
+	// decorrelates the cave noise from the height noise of the same seed
+	constexpr int32 CaveSeedMask = 0x5bd1e995;
+
+	// bump whenever GenerateChunk builds different blocks from the same settings, saved changes
+	// against the old terrain would land on the wrong blocks otherwise
+	constexpr uint32 GeneratorVersion = 1;
+
+	// falls back to the first real block type so terrain shows up even with a bare registry
+	uint16 ResolveBlock(const FBlockRegistry& Registry, FName Name)
+	{
+		const uint16 Id = Registry.FindId(Name);
+
+		return Id != FVoxelChunk::Air ? Id : (uint16)FMath::Min(1, Registry.Num() - 1);
+	}
+}
+
+FTerrainGenerator::FTerrainGenerator(const FTerrainSettings& InSettings, const FBlockRegistry& Registry)
+	: Settings(InSettings)
+	, HeightNoise(InSettings.Seed)
+	, CaveNoise(InSettings.Seed ^ CaveSeedMask)
+{
+	StoneId = ResolveBlock(Registry, Settings.StoneBlock);
+	DirtId = ResolveBlock(Registry, Settings.DirtBlock);
+	GrassId = ResolveBlock(Registry, Settings.GrassBlock);
+
+	// everything the generated blocks depend on
+	VersionStamp = FCrc::MemCrc32(&GeneratorVersion, sizeof(GeneratorVersion));
+
+	auto HashValue = [this](const auto& Value) { VersionStamp = FCrc::MemCrc32(&Value, sizeof(Value), VersionStamp); };
+
+	HashValue(Settings.Seed);
+	HashValue(Settings.BaseHeight);
+	HashValue(Settings.HeightAmplitude);
+	HashValue(Settings.FeatureSize);
+	HashValue(Settings.NumOctaves);
+	HashValue(Settings.DirtDepth);
+	HashValue(Settings.bCaves);
+	HashValue(Settings.CaveFeatureSize);
+	HashValue(Settings.CaveThreshold);
+
+	// block ids rather than names, the same names can map to other ids in another registry
+	HashValue(StoneId);
+	HashValue(DirtId);
+	HashValue(GrassId);
+}
+
+void FTerrainGenerator::GetHeightmap(const FIntPoint& ChunkCoord, int32* OutHeights) const
+{
+	constexpr int32 NumColumns = FVoxelChunk::SizeX * FVoxelChunk::SizeY;
+
+	const float Step = 1.f / Settings.FeatureSize;
+
+	float Noise[NumColumns];
+	HeightNoise.FractalGrid2D(ChunkCoord.X * FVoxelChunk::SizeX * Step, ChunkCoord.Y * FVoxelChunk::SizeY * Step, Step,
+		FVoxelChunk::SizeX, FVoxelChunk::SizeY, Settings.NumOctaves, 2.f, 0.5f, Noise);
+
+	for (int32 Column = 0; Column < NumColumns; ++Column)
+	{
+		const int32 Height = Settings.BaseHeight + FMath::FloorToInt(Noise[Column] * Settings.HeightAmplitude);
+		OutHeights[Column] = FMath::Clamp(Height, 0, FVoxelChunk::SizeZ - 1);
+	}
+}
+
+void FTerrainGenerator::GenerateChunk(FVoxelChunk& Chunk) const
+{
+	int32 Heights[FVoxelChunk::SizeX * FVoxelChunk::SizeY];
+	GetHeightmap(Chunk.Coord, Heights);
+
+	int32 MaxHeight = 0;
+
+	for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+	{
+		for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+		{
+			const int32 Height = Heights[X + Y * FVoxelChunk::SizeX];
+			MaxHeight = FMath::Max(MaxHeight, Height);
+
+			for (int32 Z = 0; Z < FVoxelChunk::SizeZ; ++Z)
+			{
+				uint16 BlockType = FVoxelChunk::Air;
+
+				if (Z == Height)
+				{
+					BlockType = GrassId;
+				}
+				else if (Z < Height)
+				{
+					BlockType = Z >= Height - Settings.DirtDepth ? DirtId : StoneId;
+				}
+
+				Chunk.SetBlock(X, Y, Z, BlockType);
+			}
+		}
+	}
+
+	if (!Settings.bCaves)
+	{
+		return;
+	}
+
+	// carve one cube of noise at a time, only as high as the ground reaches
+	const float Step = 1.f / Settings.CaveFeatureSize;
+	float Noise[CaveCubeSize * CaveCubeSize * CaveCubeSize];
+
+	for (int32 BaseZ = 0; BaseZ <= MaxHeight; BaseZ += CaveCubeSize)
+	{
+		const FVector Origin(Chunk.Coord.X * FVoxelChunk::SizeX * Step, Chunk.Coord.Y * FVoxelChunk::SizeY * Step, BaseZ * Step);
+		CaveNoise.FractalGrid3D(Origin, Step, CaveCubeSize, CaveCubeSize, CaveCubeSize, 2, 2.f, 0.5f, Noise);
+
+		int32 NoiseIndex = 0;
+
+		for (int32 Z = BaseZ; Z < BaseZ + CaveCubeSize; ++Z)
+		{
+			for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+			{
+				for (int32 X = 0; X < FVoxelChunk::SizeX; ++X, ++NoiseIndex)
+				{
+					// the bottom layer stays solid so nothing falls out of the world
+					if (Z > 0 && Z <= Heights[X + Y * FVoxelChunk::SizeX] && Noise[NoiseIndex] > Settings.CaveThreshold)
+					{
+						Chunk.SetBlock(X, Y, Z, FVoxelChunk::Air);
+					}
+				}
+			}
+		}
+	}
+}
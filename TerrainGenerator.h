@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelNoise.h"
+#include "TerrainGenerator.generated.h"
+
+class FBlockRegistry;
+struct FVoxelChunk;
+
+// knobs for procedural terrain, the same settings always produce the same world
+USTRUCT(BlueprintType)
+struct FTerrainSettings
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		int32 Seed;
+
+	//terrain height in blocks where the noise is zero
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		int32 BaseHeight;
+
+	//how far in blocks hills rise above and valleys sink below the base height
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		float HeightAmplitude;
+
+	//size in blocks of the largest hills
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		float FeatureSize;
+
+	UPROPERTY(EditAnywhere, Category = Terrain, meta = (ClampMin = "1", ClampMax = "8"))
+		int32 NumOctaves;
+
+	//blocks of dirt between the grass and the stone
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		int32 DirtDepth;
+
+	//block type names looked up in the block registry
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		FName StoneBlock;
+
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		FName DirtBlock;
+
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		FName GrassBlock;
+
+	//carve caves out of the ground with 3D noise
+	UPROPERTY(EditAnywhere, Category = Caves)
+		bool bCaves;
+
+	//size in blocks of the cave pockets
+	UPROPERTY(EditAnywhere, Category = Caves, meta = (EditCondition = "bCaves"))
+		float CaveFeatureSize;
+
+	//noise above this turns into air, higher values give fewer and smaller caves
+	UPROPERTY(EditAnywhere, Category = Caves, meta = (EditCondition = "bCaves", ClampMin = "-1", ClampMax = "1"))
+		float CaveThreshold;
+
+	FTerrainSettings()
+		: Seed(0)
+		, BaseHeight(64)
+		, HeightAmplitude(24.f)
+		, FeatureSize(128.f)
+		, NumOctaves(4)
+		, DirtDepth(3)
+		, StoneBlock(TEXT("Stone"))
+		, DirtBlock(TEXT("Dirt"))
+		, GrassBlock(TEXT("Grass"))
+		, bCaves(true)
+		, CaveFeatureSize(24.f)
+		, CaveThreshold(0.35f)
+	{
+	}
+};
+
+// Fills chunks from a seed. A chunk's contents depend only on the settings and its
+// coordinate, never on which thread built it or in which order, and the generator has
+// no mutable state so any number of threads can share one.
+class MCUE_API FTerrainGenerator
+{
+public:
+	FTerrainGenerator(const FTerrainSettings& InSettings, const FBlockRegistry& Registry);
+
+	// overwrites every block of the chunk at Chunk.Coord
+	void GenerateChunk(FVoxelChunk& Chunk) const;
+
+	// heights of all columns of a chunk, indexed x + y * SizeX
+	void GetHeightmap(const FIntPoint& ChunkCoord, int32* OutHeights) const;
+
+	// checksum of the generator code version, the settings and the block ids it places. Generators
+	// with the same stamp build the same chunks, so saves can store changes against them.
+	uint32 GetVersionStamp() const { return VersionStamp; }
+
+private:
+	FTerrainSettings Settings;
+
+	uint32 VersionStamp;
+
+	FVoxelNoise HeightNoise;
+	FVoxelNoise CaveNoise;
+
+	uint16 StoneId;
+	uint16 DirtId;
+	uint16 GrassId;
+};
@@ -0,0 +1,1353 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Voxel microbenchmarks and MCUE.VerifySave, run from the in-game console. Results are written to the log under LogVoxel.
+// Benchmarks that time a fast path against a slow one log an error when the two disagree, every other correctness
+// check is an automation test in the Voxel*Tests.cpp files.
+
+#include "CoreMinimal.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/Crc.h"
+#include "Misc/Paths.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "TerrainGenerator.h"
+#include "VoxelBlockTicks.h"
+#include "VoxelFluids.h"
+#include "VoxelLighting.h"
+#include "VoxelNoise.h"
+#include "VoxelPool.h"
+#include "VoxelRegion.h"
+#include "VoxelSection.h"
+#include "VoxelVisibility.h"
+#include "VoxelWorld.h"
+
+namespace
+{
+	// rays per task when the benchmark spreads raycasts over worker threads
+	constexpr int32 RaysPerBatch = 256;
+
+	void BenchRaycast(const TArray<FString>& Args, UWorld* World)
+	{
+		AVoxelWorld* VoxelWorld = AVoxelWorld::Get(World);
+
+		if (VoxelWorld == nullptr)
+		{
+			UE_LOG(LogVoxel, Warning, TEXT("MCUE.Bench.Raycast needs a running game"));
+			return;
+		}
+
+		const int32 NumRays = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 10000;
+		const float Distance = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 1000.f;
+
+		// fire from the player's eyes so the rays see the same blocks the player does
+		APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(World, 0);
+		const FVector Origin = CameraManager != nullptr ? CameraManager->GetCameraLocation() : VoxelWorld->GetActorLocation();
+
+		FRandomStream Random(NumRays);
+		TArray<FVoxelRay> Rays;
+		Rays.Reserve(NumRays);
+
+		for (int32 RayIndex = 0; RayIndex < NumRays; ++RayIndex)
+		{
+			Rays.Emplace(Origin, Random.VRand(), Distance);
+		}
+
+		TArray<FVoxelRayHit> Hits;
+		Hits.SetNum(NumRays);
+
+		double StartTime = FPlatformTime::Seconds();
+		const int32 NumVoxelHits = VoxelWorld->RaycastBatch(Rays, Hits);
+		const double VoxelSeconds = FPlatformTime::Seconds() - StartTime;
+
+		const int32 NumBatches = FMath::DivideAndRoundUp(NumRays, RaysPerBatch);
+
+		StartTime = FPlatformTime::Seconds();
+		ParallelFor(NumBatches, [&](int32 BatchIndex)
+		{
+			const int32 FirstRay = BatchIndex * RaysPerBatch;
+			const int32 BatchSize = FMath::Min(RaysPerBatch, NumRays - FirstRay);
+
+			VoxelWorld->RaycastBatch(TArrayView<const FVoxelRay>(Rays.GetData() + FirstRay, BatchSize), TArrayView<FVoxelRayHit>(Hits.GetData() + FirstRay, BatchSize));
+		});
+		const double ParallelSeconds = FPlatformTime::Seconds() - StartTime;
+
+		FCollisionQueryParams QueryParams;
+		QueryParams.AddIgnoredActor(UGameplayStatics::GetPlayerPawn(World, 0));
+
+		int32 NumPhysicsHits = 0;
+
+		StartTime = FPlatformTime::Seconds();
+		for (const FVoxelRay& Ray : Rays)
+		{
+			FHitResult Hit;
+			NumPhysicsHits += World->LineTraceSingleByChannel(Hit, Ray.Start, Ray.Start + Ray.Direction * Ray.MaxDistance, ECollisionChannel::ECC_WorldDynamic, QueryParams);
+		}
+		const double PhysicsSeconds = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogVoxel, Display, TEXT("Raycast x%d over %.0f units: voxel %.3f ms (%.1f ns/ray, %d hits), voxel parallel %.3f ms, physics line trace %.3f ms (%.1f ns/ray, %d hits)"),
+			NumRays, Distance,
+			VoxelSeconds * 1000.0, VoxelSeconds * 1e9 / NumRays, NumVoxelHits,
+			ParallelSeconds * 1000.0,
+			PhysicsSeconds * 1000.0, PhysicsSeconds * 1e9 / NumRays, NumPhysicsHits);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs BenchRaycastCommand(
+		TEXT("MCUE.Bench.Raycast"),
+		TEXT("Times voxel DDA raycasts against physics line traces. Args: [NumRays=10000] [Distance=1000]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchRaycast));
+
+	// the block types terrain generation asks for, so benchmarks don't need a voxel world
+	FBlockRegistry MakeTerrainRegistry(bool bWithTorch = false)
+	{
+		TArray<FVoxelBlockType> Types;
+		Types.AddDefaulted(4);
+		Types[1].Name = TEXT("Stone");
+		Types[2].Name = TEXT("Dirt");
+		Types[3].Name = TEXT("Grass");
+
+		// grass takes random ticks the way it would to spread in a game
+		Types[3].bRandomTicks = true;
+
+		if (bWithTorch)
+		{
+			FVoxelBlockType& Torch = Types.AddDefaulted_GetRef();
+			Torch.Name = TEXT("Torch");
+			Torch.bOpaque = false;
+			Torch.LightEmission = 14;
+		}
+
+		FBlockRegistry Registry;
+		Registry.Build(Types);
+		return Registry;
+	}
+
+	void BenchTerrainGen(const TArray<FString>& Args)
+	{
+		const int32 NumChunks = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 256;
+		const int32 MaxThreads = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+
+		const FBlockRegistry Registry = MakeTerrainRegistry();
+		const FTerrainGenerator Generator(FTerrainSettings(), Registry);
+
+		// chunks in a square around the origin
+		const int32 Side = FMath::CeilToInt(FMath::Sqrt((float)NumChunks));
+
+		TArray<int32> ThreadCounts;
+		for (int32 NumThreads = 1; NumThreads < MaxThreads; NumThreads *= 2)
+		{
+			ThreadCounts.Add(NumThreads);
+		}
+		ThreadCounts.Add(MaxThreads);
+
+		for (const int32 NumThreads : ThreadCounts)
+		{
+			FThreadSafeCounter NextChunk;
+			TArray<uint32> ChunkCrcs;
+			ChunkCrcs.SetNumZeroed(NumChunks);
+
+			const double StartTime = FPlatformTime::Seconds();
+
+			// dedicated threads so the thread count is exactly what we ask for
+			TArray<TFuture<void>> Workers;
+			for (int32 ThreadIndex = 0; ThreadIndex < NumThreads; ++ThreadIndex)
+			{
+				Workers.Add(Async(EAsyncExecution::Thread, [&]()
+				{
+					FVoxelChunk Chunk(FIntPoint::ZeroValue);
+
+					for (int32 ChunkIndex = NextChunk.Increment() - 1; ChunkIndex < NumChunks; ChunkIndex = NextChunk.Increment() - 1)
+					{
+						Chunk.Coord = FIntPoint(ChunkIndex % Side - Side / 2, ChunkIndex / Side - Side / 2);
+						Generator.GenerateChunk(Chunk);
+						ChunkCrcs[ChunkIndex] = Chunk.GetBlocksCrc();
+					}
+				}));
+			}
+
+			for (TFuture<void>& Worker : Workers)
+			{
+				Worker.Wait();
+			}
+
+			const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+			// the same seed has to give the same world however many threads built it
+			const uint32 WorldCrc = FCrc::MemCrc32(ChunkCrcs.GetData(), ChunkCrcs.Num() * sizeof(uint32));
+
+			UE_LOG(LogVoxel, Display, TEXT("TerrainGen %d chunks on %d threads: %.3f ms, %.1f chunks/s, world crc %08x"),
+				NumChunks, NumThreads, Seconds * 1000.0, NumChunks / Seconds, WorldCrc);
+		}
+	}
+
+	FAutoConsoleCommandWithArgs BenchTerrainGenCommand(
+		TEXT("MCUE.Bench.TerrainGen"),
+		TEXT("Generates chunks on 1, 2, 4 ... N threads and reports chunks per second. Args: [NumChunks=256] [MaxThreads=cores]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchTerrainGen));
+
+	// runs Evaluate(Path) Iterations times on each path and returns ns per sample
+	template<typename EvaluateFunc>
+	double TimeNoisePath(EVoxelNoisePath Path, int32 Iterations, int32 SamplesPerIteration, EvaluateFunc&& Evaluate)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			Evaluate(Iteration, Path);
+		}
+
+		return (FPlatformTime::Seconds() - StartTime) * 1e9 / ((double)Iterations * SamplesPerIteration);
+	}
+
+	void BenchNoise(const TArray<FString>& Args)
+	{
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000;
+
+		constexpr int32 GridSize = 16;
+		constexpr int32 NumSamples2D = GridSize * GridSize;
+		constexpr int32 NumSamples3D = GridSize * GridSize * GridSize;
+
+		const FVoxelNoise Noise(FTerrainSettings().Seed);
+
+		TArray<float> Scalar;
+		TArray<float> Simd;
+		Scalar.SetNumUninitialized(NumSamples3D);
+		Simd.SetNumUninitialized(NumSamples3D);
+
+		// one grid per chunk column, walking along x the way streaming does
+		auto Evaluate2D = [&](int32 Iteration, EVoxelNoisePath Path)
+		{
+			Noise.FractalGrid2D(Iteration * GridSize / 128.f, 0.f, 1.f / 128.f, GridSize, GridSize, 4, 2.f, 0.5f, Path == EVoxelNoisePath::Simd ? Simd.GetData() : Scalar.GetData(), Path);
+		};
+
+		auto Evaluate3D = [&](int32 Iteration, EVoxelNoisePath Path)
+		{
+			Noise.Grid3D(FVector(Iteration * GridSize / 24.f, 0.f, 0.f), 1.f / 24.f, GridSize, GridSize, GridSize, Path == EVoxelNoisePath::Simd ? Simd.GetData() : Scalar.GetData(), Path);
+		};
+
+		const double Scalar2D = TimeNoisePath(EVoxelNoisePath::Scalar, Iterations, NumSamples2D, Evaluate2D);
+		const double Simd2D = TimeNoisePath(EVoxelNoisePath::Simd, Iterations, NumSamples2D, Evaluate2D);
+		const bool bMatch2D = FMemory::Memcmp(Scalar.GetData(), Simd.GetData(), NumSamples2D * sizeof(float)) == 0;
+
+		const double Scalar3D = TimeNoisePath(EVoxelNoisePath::Scalar, Iterations, NumSamples3D, Evaluate3D);
+		const double Simd3D = TimeNoisePath(EVoxelNoisePath::Simd, Iterations, NumSamples3D, Evaluate3D);
+		const bool bMatch3D = FMemory::Memcmp(Scalar.GetData(), Simd.GetData(), NumSamples3D * sizeof(float)) == 0;
+
+		UE_LOG(LogVoxel, Display, TEXT("Noise x%d (simd %s): 16x16 fractal 4 octaves scalar %.2f ns/sample, simd %.2f ns/sample (%s); 16x16x16 scalar %.2f ns/sample, simd %.2f ns/sample (%s)"),
+			Iterations, FVoxelNoise::IsSimdSupported() ? TEXT("native") : TEXT("emulated"),
+			Scalar2D, Simd2D, bMatch2D ? TEXT("identical") : TEXT("MISMATCH"),
+			Scalar3D, Simd3D, bMatch3D ? TEXT("identical") : TEXT("MISMATCH"));
+
+		if (!bMatch2D || !bMatch3D)
+		{
+			UE_LOG(LogVoxel, Error, TEXT("Noise paths disagree, worlds would differ between machines"));
+		}
+	}
+
+	FAutoConsoleCommandWithArgs BenchNoiseCommand(
+		TEXT("MCUE.Bench.Noise"),
+		TEXT("Times the scalar and vector noise paths on chunk sized grids and checks they agree bit for bit. Args: [Iterations=1000]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchNoise));
+
+	void BenchRegion(const TArray<FString>& Args)
+	{
+		const int32 NumChunks = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 256;
+		const FName CompressionFormat = Args.Num() > 1 ? FName(*Args[1]) : NAME_LZ4;
+
+		const FBlockRegistry Registry = MakeTerrainRegistry();
+		const FTerrainGenerator Generator(FTerrainSettings(), Registry);
+		const TSharedRef<const FBlockRegistry, ESPMode::ThreadSafe> StoreRegistry = MakeShared<FBlockRegistry, ESPMode::ThreadSafe>(Registry);
+
+		const int32 Side = FMath::CeilToInt(FMath::Sqrt((float)NumChunks));
+
+		TArray<TUniquePtr<FVoxelChunk>> Chunks;
+		TArray<const FVoxelChunk*> ChunkPointers;
+
+		for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ++ChunkIndex)
+		{
+			TUniquePtr<FVoxelChunk> Chunk = MakeUnique<FVoxelChunk>(FIntPoint(ChunkIndex % Side - Side / 2, ChunkIndex / Side - Side / 2));
+			Generator->GenerateChunk(*Chunk);
+			Chunk->bPopulated = true;
+			ChunkPointers.Add(Chunk.Get());
+			Chunks.Add(MoveTemp(Chunk));
+		}
+
+		const FString Directory = FPaths::ProjectSavedDir() / TEXT("Voxel") / TEXT("RegionBench");
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+		// bytes as the chunks sit in memory, what the MB/s are measured against
+		const double NumMegabytes = (double)NumChunks * FVoxelChunk::NumBlocks * sizeof(uint16) / (1024.0 * 1024.0);
+
+		double StoreSeconds;
+		int64 FileBytes = 0;
+
+		{
+			FVoxelRegionStore Store(Directory, CompressionFormat, StoreRegistry);
+
+			const double StartTime = FPlatformTime::Seconds();
+			Store.SaveChunks(ChunkPointers);
+			StoreSeconds = FPlatformTime::Seconds() - StartTime;
+		}
+
+		TArray<FString> RegionFiles;
+		IFileManager::Get().FindFiles(RegionFiles, *(Directory / TEXT("*.mcr")), true, false);
+
+		for (const FString& RegionFile : RegionFiles)
+		{
+			FileBytes += IFileManager::Get().FileSize(*(Directory / RegionFile));
+		}
+
+		double LoadSeconds;
+		int32 NumMismatched = 0;
+
+		{
+			// a fresh store, so loading includes opening and mapping the files
+			FVoxelRegionStore Store(Directory, CompressionFormat, StoreRegistry);
+			FVoxelChunk Loaded(FIntPoint::ZeroValue);
+
+			const double StartTime = FPlatformTime::Seconds();
+			for (const TUniquePtr<FVoxelChunk>& Chunk : Chunks)
+			{
+				Loaded.Coord = Chunk->Coord;
+				Store.LoadChunk(Loaded);
+			}
+			LoadSeconds = FPlatformTime::Seconds() - StartTime;
+
+			// checked in a second pass so the checksums stay out of the timing
+			for (const TUniquePtr<FVoxelChunk>& Chunk : Chunks)
+			{
+				Loaded.Coord = Chunk->Coord;
+				NumMismatched += !Store.LoadChunk(Loaded) || Loaded.GetBlocksCrc() != Chunk->GetBlocksCrc();
+			}
+		}
+
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+		UE_LOG(LogVoxel, Display, TEXT("Region %s x%d chunks (%.1f MB raw, %.1f MB on disk in %d files): store %.1f MB/s, load %.1f MB/s (%.1f us/chunk)%s"),
+			*CompressionFormat.ToString(), NumChunks, NumMegabytes, FileBytes / (1024.0 * 1024.0), RegionFiles.Num(),
+			NumMegabytes / StoreSeconds, NumMegabytes / LoadSeconds, LoadSeconds * 1e6 / NumChunks,
+			NumMismatched > 0 ? TEXT(", ROUND TRIP FAILED") : TEXT(""));
+	}
+
+	FAutoConsoleCommandWithArgs BenchRegionCommand(
+		TEXT("MCUE.Bench.Region"),
+		TEXT("Stores generated chunks to region files and loads them back, reporting MB/s. Args: [NumChunks=256] [Zlib|LZ4|None=LZ4]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchRegion));
+
+	void BenchSave(const TArray<FString>& Args)
+	{
+		const int32 NumChunks = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 256;
+		const int32 EditsPerChunk = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 64;
+		const bool bStoreWhole = Args.Num() > 2 && Args[2] == TEXT("Whole");
+
+		const FBlockRegistry Registry = MakeTerrainRegistry();
+		const TSharedPtr<const FTerrainGenerator, ESPMode::ThreadSafe> Generator = MakeShared<FTerrainGenerator, ESPMode::ThreadSafe>(FTerrainSettings(), Registry);
+		const TSharedRef<const FBlockRegistry, ESPMode::ThreadSafe> StoreRegistry = MakeShared<FBlockRegistry, ESPMode::ThreadSafe>(Registry);
+
+		// whole chunks are what saves stored before they kept only the changes
+		const TSharedPtr<const FTerrainGenerator, ESPMode::ThreadSafe> SaveGenerator = bStoreWhole ? nullptr : Generator;
+
+		const int32 Side = FMath::CeilToInt(FMath::Sqrt((float)NumChunks));
+
+		TArray<TUniquePtr<FVoxelChunk>> Chunks;
+
+		for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ++ChunkIndex)
+		{
+			TUniquePtr<FVoxelChunk> Chunk = MakeUnique<FVoxelChunk>(FIntPoint(ChunkIndex % Side - Side / 2, ChunkIndex / Side - Side / 2));
+			Generator.GenerateChunk(*Chunk);
+			Chunk->bPopulated = true;
+			Chunks.Add(MoveTemp(Chunk));
+		}
+
+		const FString Directory = FPaths::ProjectSavedDir() / TEXT("Voxel") / TEXT("SaveBench");
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+		double SnapshotSeconds;
+		double WriteSeconds;
+		double SlowestLoadSeconds = 0.0;
+		double LoadSeconds;
+		int32 NumLoadsDuringWrite = 0;
+		int32 NumMismatched = 0;
+		FVoxelRegionWriteStats WriteStats;
+
+		{
+			FVoxelRegionStore Store(Directory, NAME_LZ4, StoreRegistry, SaveGenerator);
+
+			// player edits scattered over every chunk, the way a long session leaves them
+			FRandomStream Random(NumChunks);
+
+			for (const TUniquePtr<FVoxelChunk>& Chunk : Chunks)
+			{
+				for (int32 Edit = 0; Edit < EditsPerChunk; ++Edit)
+				{
+					Chunk->SetBlock(Random.RandHelper(FVoxelChunk::SizeX), Random.RandHelper(FVoxelChunk::SizeY), Random.RandRange(40, 90), Random.RandHelper(Registry.Num()));
+				}
+
+				Chunk->bModified = true;
+			}
+
+			// what the game thread pays, the rest happens on the writer
+			double StartTime = FPlatformTime::Seconds();
+			for (const TUniquePtr<FVoxelChunk>& Chunk : Chunks)
+			{
+				TSharedRef<FVoxelChunk, ESPMode::ThreadSafe> Snapshot(new FVoxelChunk(Chunk->Coord));
+				Snapshot->CopyBlocksFrom(*Chunk);
+				Store.AddPendingChunk(Snapshot);
+			}
+			SnapshotSeconds = FPlatformTime::Seconds() - StartTime;
+
+			StartTime = FPlatformTime::Seconds();
+			TFuture<void> Writer = Async(EAsyncExecution::Thread, [&Store]() { Store.WritePendingChunks(); });
+
+			// streaming keeps loading while the write runs, every load has to see the edits
+			FVoxelChunk Loaded(FIntPoint::ZeroValue);
+
+			while (!Writer.IsReady())
+			{
+				const TUniquePtr<FVoxelChunk>& Chunk = Chunks[NumLoadsDuringWrite++ % NumChunks];
+				Loaded.Coord = Chunk->Coord;
+
+				const double LoadStart = FPlatformTime::Seconds();
+				NumMismatched += !Store.LoadChunk(Loaded) || Loaded.GetBlocksCrc() != Chunk->GetBlocksCrc();
+				SlowestLoadSeconds = FMath::Max(SlowestLoadSeconds, FPlatformTime::Seconds() - LoadStart);
+			}
+
+			Writer.Wait();
+			WriteSeconds = FPlatformTime::Seconds() - StartTime;
+			WriteStats = Store.GetWriteStats();
+		}
+
+		{
+			// a fresh store only has the files to go on, loading chunks stored as changes regenerates them
+			FVoxelRegionStore Store(Directory, NAME_LZ4, StoreRegistry, SaveGenerator);
+			FVoxelChunk Loaded(FIntPoint::ZeroValue);
+
+			const double StartTime = FPlatformTime::Seconds();
+			for (const TUniquePtr<FVoxelChunk>& Chunk : Chunks)
+			{
+				Loaded.Coord = Chunk->Coord;
+				NumMismatched += !Store.LoadChunk(Loaded) || Loaded.GetBlocksCrc() != Chunk->GetBlocksCrc();
+			}
+			LoadSeconds = FPlatformTime::Seconds() - StartTime;
+		}
+
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+		UE_LOG(LogVoxel, Display, TEXT("Save x%d chunks, %d edits each, stored %s: snapshot %.2f ms on the game thread (%.1f us/chunk), write %.1f ms on a worker (%.1f MB/s, %.0f chunks/s, %.1f KB on disk in %d regions), %d loads during the write, slowest %.3f ms, loading back %.1f us/chunk%s"),
+			NumChunks, EditsPerChunk, bStoreWhole ? TEXT("whole") : TEXT("as changes"), SnapshotSeconds * 1000.0, SnapshotSeconds * 1e6 / NumChunks,
+			WriteSeconds * 1000.0, WriteStats.NumBytes / (1024.0 * 1024.0) / WriteStats.Seconds, WriteStats.NumChunks / WriteStats.Seconds, WriteStats.NumBytes / 1024.0, WriteStats.NumRegions,
+			NumLoadsDuringWrite, SlowestLoadSeconds * 1000.0, LoadSeconds * 1e6 / NumChunks,
+			NumMismatched > 0 ? TEXT(", ROUND TRIP FAILED") : TEXT(""));
+	}
+
+	FAutoConsoleCommandWithArgs BenchSaveCommand(
+		TEXT("MCUE.Bench.Save"),
+		TEXT("Snapshots edited chunks and writes them on a worker thread while loading them back, reporting the game thread cost, write MB/s and size on disk. Args: [NumChunks=256] [EditsPerChunk=64] [Changes|Whole=Changes]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchSave));
+
+	void VerifySave(const TArray<FString>& Args, UWorld* World)
+	{
+		AVoxelWorld* VoxelWorld = AVoxelWorld::Get(World);
+
+		if (VoxelWorld == nullptr)
+		{
+			UE_LOG(LogVoxel, Warning, TEXT("MCUE.VerifySave needs a running game"));
+			return;
+		}
+
+		int32 NumChecked = 0;
+		const int32 NumFailed = VoxelWorld->VerifySave(NumChecked);
+
+		UE_LOG(LogVoxel, Display, TEXT("VerifySave: %d of %d edited chunks come back from regenerate and patch as they are%s"),
+			NumChecked - NumFailed, NumChecked, NumFailed > 0 ? TEXT(", SAVE IS LOSING EDITS") : TEXT(""));
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs VerifySaveCommand(
+		TEXT("MCUE.VerifySave"),
+		TEXT("Checks that every loaded edited chunk survives being saved as changes and regenerated, and matches its saved copy"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&VerifySave));
+
+	void BenchPalette(const TArray<FString>& Args)
+	{
+		const int32 NumChunks = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 64;
+
+		FRandomStream Random(NumChunks);
+
+		// each type count pushes the indices to a different width: 1, 2, 4, 8 bits and raw ids
+		const int32 TypeCounts[] = { 2, 4, 16, 256, 1000 };
+		constexpr int32 NumWrites = FVoxelSection::NumBlocks * 8;
+
+		for (int32 Case = 0; Case < UE_ARRAY_COUNT(TypeCounts); ++Case)
+		{
+			FVoxelSection Section;
+
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 Write = 0; Write < NumWrites; ++Write)
+			{
+				Section.Set(Random.RandHelper(FVoxelSection::NumBlocks), (uint16)Random.RandHelper(TypeCounts[Case]));
+			}
+			const double WriteSeconds = FPlatformTime::Seconds() - StartTime;
+
+			UE_LOG(LogVoxel, Display, TEXT("Palette %d types: %d random writes %.2f ns each, %d bits per block"),
+				TypeCounts[Case], NumWrites, WriteSeconds * 1e9 / NumWrites, Section.GetBitsPerBlock());
+		}
+
+		// memory and access speed on real terrain
+		const FBlockRegistry Registry = MakeTerrainRegistry();
+		const FTerrainGenerator Generator(FTerrainSettings(), Registry);
+
+		SIZE_T NumBytes = 0;
+		int32 SectionsByBits[17] = {};
+		uint32 Checksum = 0;
+		double ReadSeconds = 0.0;
+
+		for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ++ChunkIndex)
+		{
+			FVoxelChunk Chunk(FIntPoint(ChunkIndex * 7, ChunkIndex * -3));
+			Generator.GenerateChunk(Chunk);
+
+			NumBytes += Chunk.GetAllocatedSize();
+
+			for (int32 SectionIndex = 0; SectionIndex < FVoxelChunk::NumSections; ++SectionIndex)
+			{
+				++SectionsByBits[Chunk.GetSection(SectionIndex).GetBitsPerBlock()];
+			}
+
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 Z = 0; Z < FVoxelChunk::SizeZ; ++Z)
+			{
+				for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+				{
+					for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+					{
+						Checksum += Chunk.GetBlock(X, Y, Z);
+					}
+				}
+			}
+			ReadSeconds += FPlatformTime::Seconds() - StartTime;
+		}
+
+		const SIZE_T RawBytes = (SIZE_T)NumChunks * FVoxelChunk::NumBlocks * sizeof(uint16);
+
+		UE_LOG(LogVoxel, Display, TEXT("Palette x%d chunks: %.1f KB/chunk vs %.1f KB raw (%.1fx smaller), sections uniform %d, 1 bit %d, 2 bit %d, 4 bit %d, 8 bit %d, raw %d; GetBlock %.2f ns (sum %u)"),
+			NumChunks, NumBytes / 1024.0 / NumChunks, RawBytes / 1024.0 / NumChunks, (double)RawBytes / FMath::Max<SIZE_T>(NumBytes, 1),
+			SectionsByBits[0], SectionsByBits[1], SectionsByBits[2], SectionsByBits[4], SectionsByBits[8], SectionsByBits[16],
+			ReadSeconds * 1e9 / ((double)NumChunks * FVoxelChunk::NumBlocks), Checksum);
+	}
+
+	FAutoConsoleCommandWithArgs BenchPaletteCommand(
+		TEXT("MCUE.Bench.Palette"),
+		TEXT("Times random writes into palette sections of each width, then reports memory and read speed on generated chunks. Args: [NumChunks=64]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchPalette));
+
+	// a few generated chunks standing in for the voxel world, enough for light to cross chunk borders
+	struct FLightingBenchWorld
+	{
+		TMap<FIntPoint, TUniquePtr<FVoxelChunk>> Chunks;
+
+		FVoxelChunk* FindChunk(const FIntPoint& ChunkCoord) const
+		{
+			const TUniquePtr<FVoxelChunk>* Chunk = Chunks.Find(ChunkCoord);
+			return Chunk != nullptr ? Chunk->Get() : nullptr;
+		}
+
+		uint16 GetBlock(const FIntVector& Block) const
+		{
+			const FIntVector Local = FVoxelChunk::ToLocal(Block);
+			return FindChunk(FVoxelChunk::ToChunkCoord(Block))->GetBlock(Local.X, Local.Y, Local.Z);
+		}
+
+		// the same way AVoxelWorld::SetBlock queues its light update
+		void SetBlock(FVoxelLighting& Lighting, const FIntVector& Block, uint16 BlockType)
+		{
+			const FIntVector Local = FVoxelChunk::ToLocal(Block);
+			FVoxelChunk* Chunk = FindChunk(FVoxelChunk::ToChunkCoord(Block));
+			const uint16 OldBlockType = Chunk->GetBlock(Local.X, Local.Y, Local.Z);
+
+			Chunk->SetBlock(Local.X, Local.Y, Local.Z, BlockType);
+			Lighting.AddBlockChange(Block, OldBlockType, BlockType);
+		}
+
+		// lights every chunk from scratch the way streaming does, each on its own and then joined up
+		void Relight(const FBlockRegistry& Registry)
+		{
+			FVoxelLighting Lighting(Registry);
+
+			for (const TPair<FIntPoint, TUniquePtr<FVoxelChunk>>& Pair : Chunks)
+			{
+				FVoxelLighting::LightChunk(*Pair.Value, Registry);
+				Lighting.AddChunk(Pair.Key);
+			}
+
+			Lighting.Update([this](const FIntPoint& ChunkCoord) { return FindChunk(ChunkCoord); });
+		}
+
+		uint32 GetLightCrc() const
+		{
+			uint32 Crc = 0;
+			uint8 Layer[FVoxelChunk::SizeX * FVoxelChunk::SizeY];
+
+			for (const TPair<FIntPoint, TUniquePtr<FVoxelChunk>>& Pair : Chunks)
+			{
+				for (int32 Z = 0; Z < FVoxelChunk::SizeZ; ++Z)
+				{
+					for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+					{
+						for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+						{
+							Layer[X + Y * FVoxelChunk::SizeX] = Pair.Value->GetLight(X, Y, Z);
+						}
+					}
+
+					Crc = FCrc::MemCrc32(Layer, sizeof(Layer), Crc);
+				}
+			}
+
+			return Crc;
+		}
+	};
+
+	void BenchLighting(const TArray<FString>& Args)
+	{
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100;
+		const int32 NumTorches = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 64;
+
+		const FBlockRegistry Registry = MakeTerrainRegistry(true);
+		const FTerrainGenerator Generator(FTerrainSettings(), Registry);
+		const uint16 Stone = Registry.FindId(TEXT("Stone"));
+		const uint16 Torch = Registry.FindId(TEXT("Torch"));
+
+		FLightingBenchWorld World;
+
+		for (int32 Y = -1; Y <= 1; ++Y)
+		{
+			for (int32 X = -1; X <= 1; ++X)
+			{
+				TUniquePtr<FVoxelChunk> Chunk = MakeUnique<FVoxelChunk>(FIntPoint(X, Y));
+				Generator.GenerateChunk(*Chunk);
+				World.Chunks.Add(FIntPoint(X, Y), MoveTemp(Chunk));
+			}
+		}
+
+		FVoxelLighting Lighting(Registry);
+		auto FindChunk = [&World](const FIntPoint& ChunkCoord) { return World.FindChunk(ChunkCoord); };
+
+		// worst case for an edit: a 30 block cave across four chunks whose only sky light comes down a one block shaft
+		int32 Surface = FVoxelChunk::SizeZ - 1;
+		while (Surface > 0 && World.GetBlock(FIntVector(8, 8, Surface)) == FVoxelChunk::Air)
+		{
+			--Surface;
+		}
+
+		const FIntVector CaveMin(-14, -14, FMath::Max(1, Surface - 40));
+		const FIntVector CaveMax(15, 15, FMath::Max(2, Surface - 10));
+
+		for (int32 Z = CaveMin.Z; Z <= CaveMax.Z; ++Z)
+		{
+			for (int32 Y = CaveMin.Y; Y <= CaveMax.Y; ++Y)
+			{
+				for (int32 X = CaveMin.X; X <= CaveMax.X; ++X)
+				{
+					World.SetBlock(Lighting, FIntVector(X, Y, Z), FVoxelChunk::Air);
+				}
+			}
+		}
+
+		for (int32 Z = CaveMax.Z; Z <= Surface; ++Z)
+		{
+			World.SetBlock(Lighting, FIntVector(8, 8, Z), FVoxelChunk::Air);
+		}
+
+		Lighting.Update(FindChunk);
+		World.Relight(Registry);
+
+		// capping the shaft takes the sky light out of the whole cave, opening it floods the cave again
+		const FIntVector ShaftTop(8, 8, Surface);
+		int64 NumCellsChanged = 0;
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			World.SetBlock(Lighting, ShaftTop, Stone);
+			NumCellsChanged += Lighting.Update(FindChunk);
+
+			World.SetBlock(Lighting, ShaftTop, FVoxelChunk::Air);
+			NumCellsChanged += Lighting.Update(FindChunk);
+		}
+		const double ToggleSeconds = FPlatformTime::Seconds() - StartTime;
+		const int32 NumToggles = Iterations * 2;
+
+		// the same torches lit one update at a time, then all in one batch
+		FRandomStream Random(NumTorches);
+		TArray<FIntVector> Torches;
+
+		for (int32 TorchIndex = 0; TorchIndex < NumTorches; ++TorchIndex)
+		{
+			Torches.Add(FIntVector(Random.RandRange(CaveMin.X, CaveMax.X), Random.RandRange(CaveMin.Y, CaveMax.Y), CaveMin.Z));
+		}
+
+		StartTime = FPlatformTime::Seconds();
+		for (const FIntVector& Block : Torches)
+		{
+			World.SetBlock(Lighting, Block, Torch);
+			Lighting.Update(FindChunk);
+		}
+		const double SingleSeconds = FPlatformTime::Seconds() - StartTime;
+
+		for (const FIntVector& Block : Torches)
+		{
+			World.SetBlock(Lighting, Block, FVoxelChunk::Air);
+		}
+		Lighting.Update(FindChunk);
+
+		StartTime = FPlatformTime::Seconds();
+		for (const FIntVector& Block : Torches)
+		{
+			World.SetBlock(Lighting, Block, Torch);
+		}
+		Lighting.Update(FindChunk);
+		const double BatchSeconds = FPlatformTime::Seconds() - StartTime;
+
+		// every update above was incremental, lighting everything from scratch has to agree with it
+		const uint32 IncrementalCrc = World.GetLightCrc();
+		World.Relight(Registry);
+		const bool bMatches = World.GetLightCrc() == IncrementalCrc;
+
+		UE_LOG(LogVoxel, Display, TEXT("Lighting x%d: cave shaft open/close %.1f updates/s (%.3f ms, %lld cells each); %d torches one update each %.3f ms, one batch %.3f ms; %s"),
+			Iterations, NumToggles / ToggleSeconds, ToggleSeconds * 1000.0 / NumToggles, NumCellsChanged / NumToggles,
+			NumTorches, SingleSeconds * 1000.0, BatchSeconds * 1000.0, bMatches ? TEXT("matches a full relight") : TEXT("DIFFERS FROM A FULL RELIGHT"));
+
+		if (!bMatches)
+		{
+			UE_LOG(LogVoxel, Error, TEXT("Incremental light updates left different light than lighting from scratch"));
+		}
+	}
+
+	FAutoConsoleCommandWithArgs BenchLightingCommand(
+		TEXT("MCUE.Bench.Lighting"),
+		TEXT("Times incremental light updates on a cave lit through a single shaft, one by one and batched, and checks them against a full relight. Args: [Iterations=100] [NumTorches=64]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchLighting));
+
+	void BenchBlockTicks(const TArray<FString>& Args)
+	{
+		const int32 NumTicks = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100000;
+		const int32 Budget = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 4096;
+		const int32 GameTicks = 200;
+
+		const FBlockRegistry Registry = MakeTerrainRegistry();
+		const FTerrainGenerator Generator(FTerrainSettings(), Registry);
+
+		// the default generation radius of 8 loads a little over 200 chunks
+		TMap<FIntPoint, TUniquePtr<FVoxelChunk>> Chunks;
+
+		for (int32 Y = -8; Y <= 8; ++Y)
+		{
+			for (int32 X = -8; X <= 8; ++X)
+			{
+				if (X * X + Y * Y <= 64)
+				{
+					TUniquePtr<FVoxelChunk> Chunk = MakeUnique<FVoxelChunk>(FIntPoint(X, Y));
+					Generator.GenerateChunk(*Chunk);
+					Chunks.Add(FIntPoint(X, Y), MoveTemp(Chunk));
+				}
+			}
+		}
+
+		auto FindChunk = [&Chunks](const FIntPoint& ChunkCoord) -> const FVoxelChunk*
+		{
+			const TUniquePtr<FVoxelChunk>* Chunk = Chunks.Find(ChunkCoord);
+			return Chunk != nullptr ? Chunk->Get() : nullptr;
+		};
+
+		// nothing scheduled and random ticks off, what the world costs when no block needs updating
+		FVoxelBlockTicks BlockTicks(Registry, NumTicks);
+
+		for (const TPair<FIntPoint, TUniquePtr<FVoxelChunk>>& Pair : Chunks)
+		{
+			BlockTicks.AddChunk(*Pair.Value);
+		}
+
+		int32 NumRun = 0;
+		auto CountTick = [&NumRun](const FIntVector& Block, uint16 BlockType, bool bRandom) { ++NumRun; };
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 GameTick = 0; GameTick < GameTicks; ++GameTick)
+		{
+			BlockTicks.Tick(0, Budget, MAX_dbl, FindChunk, CountTick);
+		}
+		const double IdleSeconds = FPlatformTime::Seconds() - StartTime;
+
+		// random ticks on every grass section
+		StartTime = FPlatformTime::Seconds();
+		for (int32 GameTick = 0; GameTick < GameTicks; ++GameTick)
+		{
+			BlockTicks.Tick(3, Budget, MAX_dbl, FindChunk, CountTick);
+		}
+		const double RandomSeconds = FPlatformTime::Seconds() - StartTime;
+		const int32 NumRandomRun = NumRun;
+
+		// scheduled ticks on random blocks of the loaded chunks, due over the next 50 game ticks
+		TArray<FIntPoint> ChunkCoords;
+		Chunks.GetKeys(ChunkCoords);
+
+		FRandomStream Random(NumTicks);
+		TArray<FIntVector> Blocks;
+		TArray<int32> Delays;
+
+		for (int32 TickIndex = 0; TickIndex < NumTicks; ++TickIndex)
+		{
+			const FIntPoint& ChunkCoord = ChunkCoords[Random.RandHelper(ChunkCoords.Num())];
+			Blocks.Emplace(ChunkCoord.X * FVoxelChunk::SizeX + Random.RandHelper(FVoxelChunk::SizeX), ChunkCoord.Y * FVoxelChunk::SizeY + Random.RandHelper(FVoxelChunk::SizeY), Random.RandHelper(FVoxelChunk::SizeZ));
+			Delays.Add(Random.RandRange(1, 50));
+		}
+
+		StartTime = FPlatformTime::Seconds();
+		for (int32 TickIndex = 0; TickIndex < NumTicks; ++TickIndex)
+		{
+			const FIntVector& Block = Blocks[TickIndex];
+			const FIntVector Local = FVoxelChunk::ToLocal(Block);
+
+			BlockTicks.ScheduleTick(Block, FindChunk(FVoxelChunk::ToChunkCoord(Block))->GetBlock(Local.X, Local.Y, Local.Z), Delays[TickIndex]);
+		}
+		const double ScheduleSeconds = FPlatformTime::Seconds() - StartTime;
+
+		// a block scheduled twice keeps its first tick
+		TMap<FIntVector, int64> DueTicks;
+
+		for (int32 TickIndex = 0; TickIndex < NumTicks; ++TickIndex)
+		{
+			if (!DueTicks.Contains(Blocks[TickIndex]))
+			{
+				DueTicks.Add(Blocks[TickIndex], BlockTicks.GetCurrentTick() + Delays[TickIndex]);
+			}
+		}
+
+		const int32 NumScheduled = BlockTicks.GetNumScheduledTicks();
+		const int32 NumScheduledChunks = BlockTicks.GetNumScheduledChunks();
+		const int32 NumOverrunsBefore = BlockTicks.GetNumBudgetOverruns();
+
+		// ticks must never run early and always in the order they fall due, even when the budget holds them back
+		int64 LastDueTick = 0;
+		int32 NumOutOfOrder = 0;
+		NumRun = 0;
+
+		StartTime = FPlatformTime::Seconds();
+		while (BlockTicks.GetNumScheduledTicks() > 0)
+		{
+			BlockTicks.Tick(0, Budget, MAX_dbl, FindChunk, [&](const FIntVector& Block, uint16 BlockType, bool bRandom)
+			{
+				const int64 DueTick = DueTicks.FindRef(Block);
+
+				if (DueTick > BlockTicks.GetCurrentTick() || DueTick < LastDueTick)
+				{
+					++NumOutOfOrder;
+				}
+
+				LastDueTick = DueTick;
+				++NumRun;
+			});
+		}
+		const double RunSeconds = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogVoxel, Display, TEXT("BlockTicks over %d chunks: idle %.2f us/game tick; random ticks %.2f us/game tick (%d chunks, %.1f ticks each); %d scheduled in %d chunks at %.0f ns each, run at %.0f ns each with budget %d (%d game ticks over budget); %s"),
+			Chunks.Num(), IdleSeconds * 1e6 / GameTicks,
+			RandomSeconds * 1e6 / GameTicks, BlockTicks.GetNumRandomTickChunks(), (float)NumRandomRun / GameTicks,
+			NumScheduled, NumScheduledChunks, ScheduleSeconds * 1e9 / NumTicks, RunSeconds * 1e9 / FMath::Max(1, NumRun), Budget,
+			BlockTicks.GetNumBudgetOverruns() - NumOverrunsBefore, NumOutOfOrder == 0 && NumRun == NumScheduled ? TEXT("all in order") : TEXT("OUT OF ORDER OR MISSING"));
+	}
+
+	FAutoConsoleCommandWithArgs BenchBlockTicksCommand(
+		TEXT("MCUE.Bench.BlockTicks"),
+		TEXT("Times block ticks with nothing to do, random ticks on generated terrain and scheduled ticks run under a budget. Args: [NumTicks=100000] [Budget=4096]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchBlockTicks));
+
+	// a handful of chunks with the edit hooks AVoxelWorld::SetBlock runs for fluids
+	struct FFluidBenchWorld
+	{
+		const FBlockRegistry& Registry;
+		FVoxelFluids Fluids;
+		FVoxelBlockTicks Ticks;
+		TMap<FIntPoint, TUniquePtr<FVoxelChunk>> Chunks;
+
+		explicit FFluidBenchWorld(const FBlockRegistry& InRegistry)
+			: Registry(InRegistry), Fluids(InRegistry), Ticks(InRegistry, 0) {}
+
+		FVoxelChunk* FindChunk(const FIntPoint& ChunkCoord) const
+		{
+			const TUniquePtr<FVoxelChunk>* Chunk = Chunks.Find(ChunkCoord);
+			return Chunk != nullptr ? Chunk->Get() : nullptr;
+		}
+
+		uint16 GetBlock(const FIntVector& Block) const
+		{
+			const FVoxelChunk* Chunk = (uint32)Block.Z < (uint32)FVoxelChunk::SizeZ ? FindChunk(FVoxelChunk::ToChunkCoord(Block)) : nullptr;
+			const FIntVector Local = FVoxelChunk::ToLocal(Block);
+
+			return Chunk != nullptr ? Chunk->GetBlock(Local.X, Local.Y, Local.Z) : FVoxelChunk::Air;
+		}
+
+		void SetBlock(const FIntVector& Block, uint16 BlockType)
+		{
+			FVoxelChunk* Chunk = FindChunk(FVoxelChunk::ToChunkCoord(Block));
+			const FIntVector Local = FVoxelChunk::ToLocal(Block);
+			const uint16 OldBlockType = Chunk->GetBlock(Local.X, Local.Y, Local.Z);
+
+			Chunk->SetBlock(Local.X, Local.Y, Local.Z, BlockType);
+			Fluids.OnBlockChanged(Block, OldBlockType, BlockType, [this](const FIntVector& Cell) { return GetBlock(Cell); }, Ticks);
+		}
+	};
+
+	void BenchFluids(const TArray<FString>& Args)
+	{
+		const int32 BasinSize = Args.Num() > 0 ? FMath::Max(16, FCString::Atoi(*Args[0])) : 128;
+		const float BudgetMs = Args.Num() > 1 ? FMath::Max(0.1f, FCString::Atof(*Args[1])) : 2.f;
+
+		TArray<FVoxelBlockType> Types;
+		Types.AddDefaulted(3);
+		Types[1].Name = TEXT("Stone");
+		Types[2].Name = TEXT("Water");
+		Types[2].bOpaque = false;
+		Types[2].FluidFlowDistance = 7;
+		Types[2].FluidTickDelay = 5;
+
+		FBlockRegistry Registry;
+		Registry.Build(Types);
+
+		const uint16 Stone = Registry.FindId(TEXT("Stone"));
+		const uint16 Water = Registry.FindId(TEXT("Water"));
+
+		// a stone plateau with a basin Depth blocks deep sunk into it, plus a block of rim all around
+		constexpr int32 Depth = 8;
+		constexpr int32 Ground = 64;
+		const int32 NumChunks = FMath::DivideAndRoundUp(BasinSize + 2, FVoxelChunk::SizeX);
+
+		FFluidBenchWorld World(Registry);
+
+		for (int32 Y = 0; Y < NumChunks; ++Y)
+		{
+			for (int32 X = 0; X < NumChunks; ++X)
+			{
+				TUniquePtr<FVoxelChunk> Chunk = MakeUnique<FVoxelChunk>(FIntPoint(X, Y));
+
+				for (int32 Z = 0; Z < Ground; ++Z)
+				{
+					for (int32 LocalY = 0; LocalY < FVoxelChunk::SizeY; ++LocalY)
+					{
+						for (int32 LocalX = 0; LocalX < FVoxelChunk::SizeX; ++LocalX)
+						{
+							const int32 BlockX = X * FVoxelChunk::SizeX + LocalX;
+							const int32 BlockY = Y * FVoxelChunk::SizeY + LocalY;
+							const bool bInBasin = BlockX >= 1 && BlockX <= BasinSize && BlockY >= 1 && BlockY <= BasinSize && Z >= Ground - Depth;
+
+							if (!bInBasin)
+							{
+								Chunk->SetBlock(LocalX, LocalY, Z, Stone);
+							}
+						}
+					}
+				}
+
+				World.Chunks.Add(FIntPoint(X, Y), MoveTemp(Chunk));
+			}
+		}
+
+		// springs spaced so their flow just meets, each falls to the floor and spreads out from there
+		const int32 FlowDistance = Registry.Get(Water).FluidFlowDistance;
+		const int32 Spacing = FlowDistance * 2;
+		int32 NumSprings = 0;
+
+		for (int32 Y = 1 + FlowDistance; Y <= BasinSize; Y += Spacing)
+		{
+			for (int32 X = 1 + FlowDistance; X <= BasinSize; X += Spacing)
+			{
+				World.SetBlock(FIntVector(X, Y, Ground + 2), Water);
+				++NumSprings;
+			}
+		}
+
+		int32 NumGameTicks = 0;
+		int64 NumUpdates = 0;
+		int64 NumChanges = 0;
+		double MaxTickSeconds = 0.0;
+
+		auto RunTick = [&](const FIntVector& Block, uint16 BlockType, bool bRandom)
+		{
+			++NumUpdates;
+			NumChanges += World.Fluids.UpdateCell(Block,
+				[&World](const FIntVector& Cell) { return World.GetBlock(Cell); },
+				[&World](const FIntVector& Cell, uint16 CellType) { World.SetBlock(Cell, CellType); });
+		};
+
+		// every game tick gets the same budget as in game, the flood goes on until nothing is scheduled anymore
+		const double StartTime = FPlatformTime::Seconds();
+		while (World.Ticks.GetNumScheduledTicks() > 0)
+		{
+			const double TickStartTime = FPlatformTime::Seconds();
+
+			World.Ticks.Tick(0, MAX_int32, TickStartTime + BudgetMs / 1000.0, [&World](const FIntPoint& ChunkCoord) { return World.FindChunk(ChunkCoord); }, RunTick);
+
+			MaxTickSeconds = FMath::Max(MaxTickSeconds, FPlatformTime::Seconds() - TickStartTime);
+			++NumGameTicks;
+		}
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+		int32 NumWaterCells = 0;
+
+		for (int32 Y = 1; Y <= BasinSize; ++Y)
+		{
+			for (int32 X = 1; X <= BasinSize; ++X)
+			{
+				NumWaterCells += Registry.GetFluidSource(World.GetBlock(FIntVector(X, Y, Ground - Depth))) == Water;
+			}
+		}
+
+		UE_LOG(LogVoxel, Display, TEXT("Fluids in a %dx%d basin from %d springs: %lld cell updates (%lld changed) over %d game ticks in %.1f ms, %.0f updates/s, slowest game tick %.3f ms of a %.1f ms budget (%d over budget); %.1f%% of the floor covered"),
+			BasinSize, BasinSize, NumSprings, NumUpdates, NumChanges, NumGameTicks, Seconds * 1000.0, NumUpdates / Seconds,
+			MaxTickSeconds * 1000.0, BudgetMs, World.Ticks.GetNumBudgetOverruns(), 100.f * NumWaterCells / (BasinSize * BasinSize));
+	}
+
+	FAutoConsoleCommandWithArgs BenchFluidsCommand(
+		TEXT("MCUE.Bench.Fluids"),
+		TEXT("Floods a basin from a grid of springs under the block tick time budget and reports cell updates per second. Args: [BasinSize=128] [BudgetMs=2]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchFluids));
+
+	// every pool added together, to see whether any of them grew or fell back to the heap
+	FVoxelPoolStats GetPoolTotals()
+	{
+		FVoxelPoolStats Totals;
+
+		FVoxelPools::ForEachPool([&Totals](const FVoxelBufferPool& Pool)
+		{
+			const FVoxelPoolStats Stats = Pool.GetStats();
+
+			Totals.NumInUse += Stats.NumInUse;
+			Totals.HighWater += Stats.HighWater;
+			Totals.NumFallbacks += Stats.NumFallbacks;
+			Totals.SlabBytes += Stats.SlabBytes;
+		});
+
+		return Totals;
+	}
+
+	void LogPools(const TArray<FString>& Args)
+	{
+		FVoxelPools::ForEachPool([](const FVoxelBufferPool& Pool)
+		{
+			const FVoxelPoolStats Stats = Pool.GetStats();
+
+			UE_LOG(LogVoxel, Display, TEXT("%-14s %6d B buffers: %6d in use, %6d high water, %4d fallbacks, %.1f MB in slabs"),
+				Pool.GetName(), (int32)Pool.GetBufferSize(), Stats.NumInUse, Stats.HighWater, Stats.NumFallbacks, Stats.SlabBytes / (1024.0 * 1024.0));
+		});
+	}
+
+	FAutoConsoleCommandWithArgs LogPoolsCommand(
+		TEXT("MCUE.Pools"),
+		TEXT("Logs the occupancy of every voxel buffer pool."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&LogPools));
+
+	// a Width x Width window of columns sliding along x, the way chunks stream in around a player walking in a straight line
+	struct FStreamingBenchWindow
+	{
+		int32 Width;
+		TArray<TUniquePtr<FVoxelChunk>> Slots;
+
+		explicit FStreamingBenchWindow(int32 InWidth)
+			: Width(InWidth)
+		{
+			Slots.SetNum(Width * Width);
+		}
+
+		TUniquePtr<FVoxelChunk>& GetSlot(const FIntPoint& ChunkCoord)
+		{
+			return Slots[(ChunkCoord.X % Width + Width) % Width + ChunkCoord.Y * Width];
+		}
+
+		const FVoxelChunk* FindChunk(const FIntPoint& ChunkCoord)
+		{
+			if (ChunkCoord.Y < 0 || ChunkCoord.Y >= Width)
+			{
+				return nullptr;
+			}
+
+			const TUniquePtr<FVoxelChunk>& Slot = GetSlot(ChunkCoord);
+			return Slot.IsValid() && Slot->Coord == ChunkCoord ? Slot.Get() : nullptr;
+		}
+	};
+
+	void BenchStreaming(const TArray<FString>& Args)
+	{
+		const int32 NumSteps = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 64;
+		const int32 Width = Args.Num() > 1 ? FMath::Clamp(FCString::Atoi(*Args[1]), 3, 32) : 8;
+
+		const FBlockRegistry Registry = MakeTerrainRegistry(true);
+		const FTerrainGenerator Generator(FTerrainSettings(), Registry);
+
+		FStreamingBenchWindow Window(Width);
+		FVoxelChunkMesh Mesh;
+		int64 NumTriangles = 0;
+
+		// drops the column Width steps behind, generates and lights column X in its place and
+		// meshes the column before it, whose neighbours are all in now
+		auto StreamColumn = [&](int32 X)
+		{
+			for (int32 Y = 0; Y < Width; ++Y)
+			{
+				TUniquePtr<FVoxelChunk>& Slot = Window.GetSlot(FIntPoint(X, Y));
+				Slot.Reset();
+				Slot = MakeUnique<FVoxelChunk>(FIntPoint(X, Y));
+
+				Generator.GenerateChunk(*Slot);
+				Slot->bPopulated = true;
+				FVoxelLighting::LightChunk(*Slot, Registry);
+			}
+
+			for (int32 Y = 0; Y < Width; ++Y)
+			{
+				const FIntPoint ChunkCoord(X - 1, Y);
+				const FVoxelChunk* Chunk = Window.FindChunk(ChunkCoord);
+
+				if (Chunk == nullptr)
+				{
+					continue;
+				}
+
+				FVoxelChunkNeighbours Neighbours;
+				Neighbours.PosX = Window.FindChunk(ChunkCoord + FIntPoint(1, 0));
+				Neighbours.NegX = Window.FindChunk(ChunkCoord + FIntPoint(-1, 0));
+				Neighbours.PosY = Window.FindChunk(ChunkCoord + FIntPoint(0, 1));
+				Neighbours.NegY = Window.FindChunk(ChunkCoord + FIntPoint(0, -1));
+
+				FVoxelMesher::BuildChunkMesh(*Chunk, Neighbours, Registry, 100.f, Mesh);
+				NumTriangles += Mesh.GetNumTriangles();
+			}
+		};
+
+		// fill the window, then turn it over twice so every pool and the mesh buffers reach their working size
+		int32 X = 0;
+		for (; X < Width * 3; ++X)
+		{
+			StreamColumn(X);
+		}
+
+		NumTriangles = 0;
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < NumSteps; ++Step, ++X)
+		{
+			StreamColumn(X);
+		}
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+		const int32 NumChunks = NumSteps * Width;
+
+		UE_LOG(LogVoxel, Display, TEXT("Streaming %d chunks through a %dx%d window: %.3f ms/chunk generated, lit and meshed (%lld triangles); %d pooled buffers in use"),
+			NumChunks, Width, Width, Seconds * 1000.0 / NumChunks, NumTriangles, GetPoolTotals().NumInUse);
+	}
+
+	FAutoConsoleCommandWithArgs BenchStreamingCommand(
+		TEXT("MCUE.Bench.Streaming"),
+		TEXT("Times generating, lighting and meshing chunks streamed through a sliding window once it is warm. Args: [NumSteps=64] [Width=8]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchStreaming));
+
+	// a generated chunk with what cave culling keeps of its mesh
+	struct FVisibilityBenchChunk
+	{
+		TUniquePtr<FVoxelChunk> Chunk;
+		uint16 SectionConnections[FVoxelChunk::NumSections];
+		TArray<uint8> MeshSections;
+	};
+
+	void BenchVisibility(const TArray<FString>& Args)
+	{
+		const int32 Width = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 32) : 9;
+		const int32 Iterations = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 100;
+
+		const FBlockRegistry Registry = MakeTerrainRegistry();
+
+		// a square of generated chunks around the origin, meshed once all of them are in
+		const FTerrainGenerator Generator(FTerrainSettings(), Registry);
+		const int32 Radius = Width / 2;
+
+		TMap<FIntPoint, FVisibilityBenchChunk> Chunks;
+
+		for (int32 Y = -Radius; Y <= Radius; ++Y)
+		{
+			for (int32 X = -Radius; X <= Radius; ++X)
+			{
+				FVisibilityBenchChunk& BenchChunk = Chunks.Add(FIntPoint(X, Y));
+				BenchChunk.Chunk = MakeUnique<FVoxelChunk>(FIntPoint(X, Y));
+				Generator.GenerateChunk(*BenchChunk.Chunk);
+			}
+		}
+
+		auto FindChunk = [&Chunks](const FIntPoint& ChunkCoord) -> const FVoxelChunk*
+		{
+			const FVisibilityBenchChunk* BenchChunk = Chunks.Find(ChunkCoord);
+			return BenchChunk != nullptr ? BenchChunk->Chunk.Get() : nullptr;
+		};
+
+		FVoxelChunkMesh Mesh;
+		int32 NumMeshSections = 0;
+		double StartTime = FPlatformTime::Seconds();
+
+		for (TPair<FIntPoint, FVisibilityBenchChunk>& Pair : Chunks)
+		{
+			FVoxelChunkNeighbours Neighbours;
+			Neighbours.PosX = FindChunk(Pair.Key + FIntPoint(1, 0));
+			Neighbours.NegX = FindChunk(Pair.Key + FIntPoint(-1, 0));
+			Neighbours.PosY = FindChunk(Pair.Key + FIntPoint(0, 1));
+			Neighbours.NegY = FindChunk(Pair.Key + FIntPoint(0, -1));
+
+			FVoxelMesher::BuildChunkMesh(*Pair.Value.Chunk, Neighbours, Registry, 100.f, Mesh);
+
+			FMemory::Memcpy(Pair.Value.SectionConnections, Mesh.SectionConnections, sizeof(Mesh.SectionConnections));
+
+			for (const FVoxelMeshSection& Section : Mesh.Sections)
+			{
+				Pair.Value.MeshSections.Add((uint8)Section.ChunkSection);
+			}
+
+			NumMeshSections += Mesh.Sections.Num();
+		}
+
+		const double MeshSeconds = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogVoxel, Display, TEXT("Visibility: meshed %d chunks with connections in %.3f ms/chunk, %d mesh sections"),
+			Chunks.Num(), MeshSeconds * 1000.0 / Chunks.Num(), NumMeshSections);
+
+		auto FindSection = [&Chunks](const FIntVector& Section, uint16& OutConnections)
+		{
+			const FVisibilityBenchChunk* BenchChunk = Chunks.Find(FIntPoint(Section.X, Section.Y));
+
+			if (BenchChunk == nullptr)
+			{
+				return false;
+			}
+
+			OutConnections = BenchChunk->SectionConnections[Section.Z];
+			return true;
+		};
+
+		// a camera deep in the rock against one high above the ground in the middle chunk
+		const int32 CameraHeights[2] = { 24, 120 };
+
+		for (const int32 CameraHeight : CameraHeights)
+		{
+			const FIntVector StartSection(0, 0, CameraHeight >> FVoxelSection::SizeShift);
+
+			TMap<FIntPoint, uint16> Reached;
+			int32 NumVisible = 0;
+
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+			{
+				Reached.Reset();
+				NumVisible = FVoxelVisibility::FindVisibleSections(StartSection, Radius, FindSection, [&Reached](const FIntVector& Section)
+				{
+					Reached.FindOrAdd(FIntPoint(Section.X, Section.Y)) |= 1 << Section.Z;
+				});
+			}
+			const double WalkSeconds = FPlatformTime::Seconds() - StartTime;
+
+			int32 NumHidden = 0;
+
+			for (const TPair<FIntPoint, FVisibilityBenchChunk>& Pair : Chunks)
+			{
+				const uint16 Shown = Reached.FindRef(Pair.Key);
+
+				for (const uint8 ChunkSection : Pair.Value.MeshSections)
+				{
+					NumHidden += (Shown >> ChunkSection & 1) == 0;
+				}
+			}
+
+			UE_LOG(LogVoxel, Display, TEXT("Visibility: camera at height %d sees %d of %d sections, %d of %d mesh sections hidden (%.1f%%), %.3f ms per walk"),
+				CameraHeight, NumVisible, Chunks.Num() * FVoxelChunk::NumSections, NumHidden, NumMeshSections,
+				NumMeshSections > 0 ? 100.f * NumHidden / NumMeshSections : 0.f, WalkSeconds * 1000.0 / Iterations);
+		}
+	}
+
+	FAutoConsoleCommandWithArgs BenchVisibilityCommand(
+		TEXT("MCUE.Bench.Visibility"),
+		TEXT("Measures how much of a generated area cave culling hides from a camera underground and one above the ground, and how long meshing and the walk take. Args: [Width=9] [Iterations=100]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchVisibility));
+
+	void BenchBulkEdit(const TArray<FString>& Args, UWorld* World)
+	{
+		AVoxelWorld* VoxelWorld = AVoxelWorld::Get(World);
+
+		if (VoxelWorld == nullptr)
+		{
+			UE_LOG(LogVoxel, Warning, TEXT("MCUE.Bench.BulkEdit needs a running game"));
+			return;
+		}
+
+		// the edits are taken back at the end, the world has to keep both of them
+		if (VoxelWorld->MaxUndoEdits < 2)
+		{
+			UE_LOG(LogVoxel, Warning, TEXT("MCUE.Bench.BulkEdit needs MaxUndoEdits of at least 2 to leave the world as it was"));
+			return;
+		}
+
+		const int32 Radius = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 512) : 64;
+		const uint16 Dirt = VoxelWorld->GetBlockRegistry().FindId(TEXT("Dirt"));
+
+		APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(World, 0);
+		const FIntVector Center = VoxelWorld->WorldToBlock(CameraManager != nullptr ? CameraManager->GetCameraLocation() : VoxelWorld->GetActorLocation());
+
+		// the ground under the player out to Radius, only loaded columns are edited
+		const FIntVector Min(Center.X - Radius, Center.Y - Radius, 1);
+		const FIntVector Max(Center.X + Radius, Center.Y + Radius, FMath::Clamp(Center.Z - 3, 1, FVoxelChunk::SizeZ - 1));
+		const int32 SphereRadius = FMath::Min(Radius, 48);
+
+		// whatever the world had queued isn't part of the timing
+		VoxelWorld->FlushEdits();
+
+		// one bulk edit, timed as the edit itself and as the relight and remesh of what it touched
+		auto TimeEdit = [VoxelWorld](TFunctionRef<int32()> Edit, int32& OutNumChanged, double& OutFlushSeconds)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			OutNumChanged = Edit();
+			const double EditSeconds = FPlatformTime::Seconds() - StartTime;
+
+			const double FlushStartTime = FPlatformTime::Seconds();
+			VoxelWorld->FlushEdits();
+			OutFlushSeconds = FPlatformTime::Seconds() - FlushStartTime;
+
+			return EditSeconds;
+		};
+
+		int32 NumFilled = 0;
+		double FillFlushSeconds = 0.0;
+		const double FillSeconds = TimeEdit([&]() { return VoxelWorld->FillBox(Min, Max, Dirt); }, NumFilled, FillFlushSeconds);
+
+		int32 NumCarved = 0;
+		double CarveFlushSeconds = 0.0;
+		const double CarveSeconds = TimeEdit([&]() { return VoxelWorld->FillSphere(FIntVector(Center.X, Center.Y, Max.Z), SphereRadius, FVoxelChunk::Air); }, NumCarved, CarveFlushSeconds);
+
+		const SIZE_T JournalBytes = VoxelWorld->GetUndoAllocatedSize();
+
+		int32 NumUndone = 0;
+		double UndoFlushSeconds = 0.0;
+		const double UndoSeconds = TimeEdit([&]() { return (int32)VoxelWorld->UndoEdit() + (int32)VoxelWorld->UndoEdit(); }, NumUndone, UndoFlushSeconds);
+
+		UE_LOG(LogVoxel, Display, TEXT("Bulk edit: filling %d blocks %.2f ms + %.2f ms relight and remesh; carving a sphere of radius %d out of %d blocks %.2f ms + %.2f ms; undoing both %.2f ms + %.2f ms, journals %.1f KB"),
+			NumFilled, FillSeconds * 1000.0, FillFlushSeconds * 1000.0,
+			SphereRadius, NumCarved, CarveSeconds * 1000.0, CarveFlushSeconds * 1000.0,
+			UndoSeconds * 1000.0, UndoFlushSeconds * 1000.0, JournalBytes / 1024.0);
+
+		if (NumUndone != 2)
+		{
+			UE_LOG(LogVoxel, Warning, TEXT("MCUE.Bench.BulkEdit could only undo %d of its 2 edits"), NumUndone);
+		}
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs BenchBulkEditCommand(
+		TEXT("MCUE.Bench.BulkEdit"),
+		TEXT("Fills the ground under the player with dirt, carves a sphere out of it and undoes both through the voxel world, timing each edit and the relight and remesh after it. Args: [Radius=64]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchBulkEdit));
+}
@@ -0,0 +1,279 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelBlockTicks.h"
+#include "BlockRegistry.h"
+
+namespace
+{
+	// reading the clock costs about as much as a cheap tick, so the deadline is only checked every so often
+	constexpr int32 TicksPerClockCheck = 16;
+}
+
+FVoxelBlockTicks::FVoxelBlockTicks(const FBlockRegistry& InRegistry, int32 Seed)
+	: Registry(InRegistry)
+	, Random(Seed)
+	, CurrentTick(0)
+	, NextSequence(0)
+	, NumScheduledTicks(0)
+	, RandomTickCursor(0)
+	, NumScheduledTicksRun(0)
+	, NumRandomTicksRun(0)
+	, NumBudgetOverruns(0)
+{
+}
+
+FIntVector FVoxelBlockTicks::ToBlock(const FIntPoint& ChunkCoord, int32 Index)
+{
+	return FIntVector(
+		ChunkCoord.X * FVoxelChunk::SizeX + (Index & (FVoxelChunk::SizeX - 1)),
+		ChunkCoord.Y * FVoxelChunk::SizeY + ((Index >> FVoxelChunk::SizeShift) & (FVoxelChunk::SizeY - 1)),
+		Index >> (FVoxelChunk::SizeShift * 2));
+}
+
+void FVoxelBlockTicks::ScheduleTick(const FIntVector& Block, uint16 BlockType, int32 Delay)
+{
+	if ((uint32)Block.Z >= (uint32)FVoxelChunk::SizeZ)
+	{
+		return;
+	}
+
+	const FIntPoint ChunkCoord = FVoxelChunk::ToChunkCoord(Block);
+	const FIntVector Local = FVoxelChunk::ToLocal(Block);
+	const int32 Index = FVoxelChunk::GetIndex(Local.X, Local.Y, Local.Z);
+
+	FChunkTicks& ChunkTicks = ScheduledChunks.FindOrAdd(ChunkCoord);
+
+	bool bAlreadyScheduled = false;
+	ChunkTicks.Blocks.Add(Index, &bAlreadyScheduled);
+
+	if (bAlreadyScheduled)
+	{
+		return;
+	}
+
+	// a tick never runs on the game tick that scheduled it, so ticks scheduling ticks can't loop
+	FScheduledTick Tick;
+	Tick.DueTick = CurrentTick + FMath::Max(1, Delay);
+	Tick.Sequence = NextSequence++;
+	Tick.Index = Index;
+	Tick.BlockType = BlockType;
+
+	const bool bNewHead = ChunkTicks.Ticks.Num() == 0 || Tick < ChunkTicks.Ticks.HeapTop();
+
+	ChunkTicks.Ticks.HeapPush(Tick);
+	++NumScheduledTicks;
+
+	if (bNewHead)
+	{
+		DueChunks.HeapPush(FDueChunk{ Tick.DueTick, Tick.Sequence, ChunkCoord });
+	}
+}
+
+bool FVoxelBlockTicks::IsTickScheduled(const FIntVector& Block) const
+{
+	const FChunkTicks* ChunkTicks = ScheduledChunks.Find(FVoxelChunk::ToChunkCoord(Block));
+
+	if (ChunkTicks == nullptr || (uint32)Block.Z >= (uint32)FVoxelChunk::SizeZ)
+	{
+		return false;
+	}
+
+	const FIntVector Local = FVoxelChunk::ToLocal(Block);
+	return ChunkTicks->Blocks.Contains(FVoxelChunk::GetIndex(Local.X, Local.Y, Local.Z));
+}
+
+bool FVoxelBlockTicks::HasRandomTickingBlocks(const FVoxelSection& Section) const
+{
+	return Section.ContainsAny([this](uint16 BlockType) { return Registry.IsRandomTicking(BlockType); });
+}
+
+void FVoxelBlockTicks::AddChunk(const FVoxelChunk& Chunk)
+{
+	if (!Registry.HasRandomTickingBlocks())
+	{
+		return;
+	}
+
+	uint16 SectionMask = 0;
+
+	for (int32 SectionIndex = 0; SectionIndex < FVoxelChunk::NumSections; ++SectionIndex)
+	{
+		if (HasRandomTickingBlocks(Chunk.GetSection(SectionIndex)))
+		{
+			SectionMask |= (uint16)(1 << SectionIndex);
+		}
+	}
+
+	if (SectionMask != 0)
+	{
+		RandomTickSections.Add(Chunk.Coord, SectionMask);
+	}
+	else
+	{
+		RandomTickSections.Remove(Chunk.Coord);
+	}
+}
+
+void FVoxelBlockTicks::RemoveChunk(const FIntPoint& ChunkCoord)
+{
+	FChunkTicks ChunkTicks;
+
+	// the chunk's entries in DueChunks go stale and drop out as they come up
+	if (ScheduledChunks.RemoveAndCopyValue(ChunkCoord, ChunkTicks))
+	{
+		NumScheduledTicks -= ChunkTicks.Ticks.Num();
+	}
+
+	RandomTickSections.Remove(ChunkCoord);
+}
+
+void FVoxelBlockTicks::OnBlockChanged(const FIntVector& Block, uint16 NewBlockType)
+{
+	if ((uint32)Block.Z >= (uint32)FVoxelChunk::SizeZ || !Registry.IsRandomTicking(NewBlockType))
+	{
+		return;
+	}
+
+	// blocks going away are noticed when their section is sampled next
+	RandomTickSections.FindOrAdd(FVoxelChunk::ToChunkCoord(Block)) |= (uint16)(1 << (Block.Z >> FVoxelSection::SizeShift));
+}
+
+void FVoxelBlockTicks::ClearRandomTickSection(const FIntPoint& ChunkCoord, int32 SectionIndex)
+{
+	uint16* SectionMask = RandomTickSections.Find(ChunkCoord);
+
+	if (SectionMask == nullptr)
+	{
+		return;
+	}
+
+	*SectionMask &= (uint16)~(1 << SectionIndex);
+
+	if (*SectionMask == 0)
+	{
+		RandomTickSections.Remove(ChunkCoord);
+	}
+}
+
+bool FVoxelBlockTicks::IsOverBudget(int32 MaxTicks, double Deadline) const
+{
+	const int32 NumRun = NumScheduledTicksRun + NumRandomTicksRun;
+
+	return NumRun >= MaxTicks || (NumRun % TicksPerClockCheck == 0 && NumRun > 0 && FPlatformTime::Seconds() >= Deadline);
+}
+
+void FVoxelBlockTicks::Tick(int32 RandomTicksPerSection, int32 MaxTicks, double Deadline, FFindChunk FindChunk, FRunTick RunTick)
+{
+	++CurrentTick;
+	NumScheduledTicksRun = 0;
+	NumRandomTicksRun = 0;
+
+	while (DueChunks.Num() > 0 && DueChunks.HeapTop().DueTick <= CurrentTick)
+	{
+		if (IsOverBudget(MaxTicks, Deadline))
+		{
+			++NumBudgetOverruns;
+			return;
+		}
+
+		FDueChunk Due;
+		DueChunks.HeapPop(Due, false);
+
+		FChunkTicks* ChunkTicks = ScheduledChunks.Find(Due.Coord);
+
+		if (ChunkTicks == nullptr || ChunkTicks->Ticks.HeapTop().Sequence != Due.Sequence)
+		{
+			continue;
+		}
+
+		FScheduledTick Tick;
+		ChunkTicks->Ticks.HeapPop(Tick, false);
+		ChunkTicks->Blocks.Remove(Tick.Index);
+		--NumScheduledTicks;
+
+		if (ChunkTicks->Ticks.Num() > 0)
+		{
+			const FScheduledTick& Next = ChunkTicks->Ticks.HeapTop();
+			DueChunks.HeapPush(FDueChunk{ Next.DueTick, Next.Sequence, Due.Coord });
+		}
+		else
+		{
+			ScheduledChunks.Remove(Due.Coord);
+		}
+
+		// the block may have changed since the tick was scheduled
+		const FVoxelChunk* Chunk = FindChunk(Due.Coord);
+		const FIntVector Block = ToBlock(Due.Coord, Tick.Index);
+
+		if (Chunk != nullptr && Chunk->GetBlock(Block.X & (FVoxelChunk::SizeX - 1), Block.Y & (FVoxelChunk::SizeY - 1), Block.Z) == Tick.BlockType)
+		{
+			RunTick(Block, Tick.BlockType, false);
+			++NumScheduledTicksRun;
+		}
+	}
+
+	if (RandomTicksPerSection <= 0 || RandomTickSections.Num() == 0)
+	{
+		return;
+	}
+
+	// ticks may add sections while they run, those are first sampled next game tick
+	RandomTickChunks.Reset();
+	RandomTickSections.GetKeys(RandomTickChunks);
+
+	const int32 NumChunks = RandomTickChunks.Num();
+	const int32 FirstChunk = RandomTickCursor++ % NumChunks;
+
+	for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ++ChunkIndex)
+	{
+		const FIntPoint ChunkCoord = RandomTickChunks[(FirstChunk + ChunkIndex) % NumChunks];
+		const uint16* SectionMask = RandomTickSections.Find(ChunkCoord);
+		const FVoxelChunk* Chunk = FindChunk(ChunkCoord);
+
+		if (SectionMask == nullptr || Chunk == nullptr)
+		{
+			RandomTickSections.Remove(ChunkCoord);
+			continue;
+		}
+
+		// a copy, ticks may change the mask under us
+		const uint16 Sections = *SectionMask;
+
+		for (int32 SectionIndex = 0; SectionIndex < FVoxelChunk::NumSections; ++SectionIndex)
+		{
+			if ((Sections & (1 << SectionIndex)) == 0)
+			{
+				continue;
+			}
+
+			const FVoxelSection& Section = Chunk->GetSection(SectionIndex);
+
+			if (!HasRandomTickingBlocks(Section))
+			{
+				ClearRandomTickSection(ChunkCoord, SectionIndex);
+				continue;
+			}
+
+			for (int32 Sample = 0; Sample < RandomTicksPerSection; ++Sample)
+			{
+				const int32 Index = Random.RandHelper(FVoxelSection::NumBlocks);
+				const uint16 BlockType = Section.Get(Index);
+
+				if (!Registry.IsRandomTicking(BlockType))
+				{
+					continue;
+				}
+
+				if (IsOverBudget(MaxTicks, Deadline))
+				{
+					return;
+				}
+
+				// a section's index continues straight on from the chunk index of its first block
+				RunTick(ToBlock(ChunkCoord, SectionIndex * FVoxelSection::NumBlocks + Index), BlockType, true);
+				++NumRandomTicksRun;
+			}
+		}
+	}
+}
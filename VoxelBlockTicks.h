@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelChunk.h"
+
+class FBlockRegistry;
+
+// Block updates for the voxel world, so blocks like falling sand or growing crops don't each need
+// an actor that ticks. Scheduled ticks run a block a given number of game ticks from now and are
+// queued per chunk ordered by the tick they are due on. Random ticks pick a few random blocks in
+// every section that holds a block type taking them. Chunks with nothing scheduled and no random
+// ticking blocks cost nothing. Touches no engine objects, ticks are handed to a callback.
+class MCUE_API FVoxelBlockTicks
+{
+public:
+	// loaded chunk at the coordinate, null if there is none
+	typedef TFunctionRef<const FVoxelChunk*(const FIntPoint&)> FFindChunk;
+
+	// runs one block tick, bRandom is false for scheduled ticks. May schedule ticks and change blocks.
+	typedef TFunctionRef<void(const FIntVector& Block, uint16 BlockType, bool bRandom)> FRunTick;
+
+	FVoxelBlockTicks(const FBlockRegistry& InRegistry, int32 Seed);
+
+	// ticks the block Delay game ticks from now, at least one. Only runs if the block is still of the
+	// given type by then. A block has one tick pending at most, scheduling it again keeps the first.
+	void ScheduleTick(const FIntVector& Block, uint16 BlockType, int32 Delay);
+
+	bool IsTickScheduled(const FIntVector& Block) const;
+
+	// looks for random ticking blocks in a chunk that was added to the world
+	void AddChunk(const FVoxelChunk& Chunk);
+
+	// forgets the chunk's scheduled ticks along with its random ticking sections
+	void RemoveChunk(const FIntPoint& ChunkCoord);
+
+	// a block changed type, its section gets sampled if the new type takes random ticks
+	void OnBlockChanged(const FIntVector& Block, uint16 NewBlockType);
+
+	// advances one game tick. Runs the scheduled ticks that are due, earliest first, then
+	// RandomTicksPerSection random blocks in every section with random ticking blocks. Stops after
+	// MaxTicks ticks or once FPlatformTime::Seconds passes Deadline, scheduled ticks left over stay
+	// due for the next game tick.
+	void Tick(int32 RandomTicksPerSection, int32 MaxTicks, double Deadline, FFindChunk FindChunk, FRunTick RunTick);
+
+	int64 GetCurrentTick() const { return CurrentTick; }
+
+	int32 GetNumScheduledTicks() const { return NumScheduledTicks; }
+
+	int32 GetNumScheduledChunks() const { return ScheduledChunks.Num(); }
+
+	int32 GetNumRandomTickChunks() const { return RandomTickSections.Num(); }
+
+	// ticks run by the last call to Tick
+	int32 GetNumScheduledTicksRun() const { return NumScheduledTicksRun; }
+	int32 GetNumRandomTicksRun() const { return NumRandomTicksRun; }
+
+	// game ticks that ran out of budget with scheduled ticks still due
+	int32 GetNumBudgetOverruns() const { return NumBudgetOverruns; }
+
+private:
+	static_assert(FVoxelChunk::NumSections <= 16, "random tick sections are kept as a 16 bit mask");
+
+	struct FScheduledTick
+	{
+		int64 DueTick;
+
+		// ticks due on the same game tick run in the order they were scheduled
+		uint32 Sequence;
+
+		// FVoxelChunk::GetIndex of the block
+		int32 Index;
+
+		uint16 BlockType;
+
+		bool operator<(const FScheduledTick& Other) const
+		{
+			return DueTick != Other.DueTick ? DueTick < Other.DueTick : Sequence < Other.Sequence;
+		}
+	};
+
+	struct FChunkTicks
+	{
+		// a heap with the earliest tick on top
+		TArray<FScheduledTick> Ticks;
+
+		// index of every block in Ticks
+		TSet<int32> Blocks;
+	};
+
+	// the earliest tick of a chunk. Goes stale once that tick ran or an earlier one was scheduled,
+	// stale entries are skipped when they come up.
+	struct FDueChunk
+	{
+		int64 DueTick;
+		uint32 Sequence;
+		FIntPoint Coord;
+
+		bool operator<(const FDueChunk& Other) const
+		{
+			return DueTick != Other.DueTick ? DueTick < Other.DueTick : Sequence < Other.Sequence;
+		}
+	};
+
+	static FIntVector ToBlock(const FIntPoint& ChunkCoord, int32 Index);
+
+	// true once MaxTicks ran or, looking at the clock every few ticks, the deadline passed
+	bool IsOverBudget(int32 MaxTicks, double Deadline) const;
+
+	// true if the section holds a block type that takes random ticks
+	bool HasRandomTickingBlocks(const FVoxelSection& Section) const;
+
+	void ClearRandomTickSection(const FIntPoint& ChunkCoord, int32 SectionIndex);
+
+	const FBlockRegistry& Registry;
+
+	FRandomStream Random;
+
+	int64 CurrentTick;
+
+	uint32 NextSequence;
+
+	TMap<FIntPoint, FChunkTicks> ScheduledChunks;
+
+	// a heap over the chunks in ScheduledChunks, the one with the earliest tick on top
+	TArray<FDueChunk> DueChunks;
+
+	int32 NumScheduledTicks;
+
+	// bit n is set while section n of the chunk may hold random ticking blocks
+	TMap<FIntPoint, uint16> RandomTickSections;
+
+	// kept between ticks so its memory is reused
+	TArray<FIntPoint> RandomTickChunks;
+
+	// the chunk random ticks start with, moves on every game tick so no chunk keeps losing out to the budget
+	int32 RandomTickCursor;
+
+	int32 NumScheduledTicksRun;
+	int32 NumRandomTicksRun;
+	int32 NumBudgetOverruns;
+};
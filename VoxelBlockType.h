@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataTable.h"
+#include "Wieldable.h"
+#include "VoxelBlockType.generated.h"
+
+// properties shared by every block of one type, one row per block type in the block table
+USTRUCT(BlueprintType)
+struct FVoxelBlockType : public FTableRowBase
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		FName Name;
+
+	//how long the block takes to mine
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		float Resistance;
+
+	//lowest tool material that gets a drop out of the block
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		uint8 MinimumMaterial;
+
+	//tool that mines this block faster the better its material is
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		ETool PreferredTool;
+
+	//false for blocks you can see through, their neighbours keep the faces touching them
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		bool bOpaque;
+
+	//light the block gives off, 0 for none up to 15 for the brightest
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMax = "15"))
+		uint8 LightEmission;
+
+	//picked up by random block ticks, for slow changes like crops growing or grass spreading
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		bool bRandomTicks;
+
+	//falls down while there is air below it, like sand and gravel
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		bool bFalls;
+
+	//0 for blocks that aren't fluids, otherwise how many blocks the fluid flows sideways from its source
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMax = "15"))
+		uint8 FluidFlowDistance;
+
+	//game ticks the fluid takes to flow on by one block
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMin = "1", EditCondition = "FluidFlowDistance > 0"))
+		int32 FluidTickDelay;
+
+	//material used for this block's faces in chunk meshes
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		class UMaterialInterface* Material;
+
+	//cube mesh instanced for this block when the world draws instanced meshes
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		class UStaticMesh* Mesh;
+
+	FVoxelBlockType()
+		: Resistance(20.f)
+		, MinimumMaterial(0)
+		, PreferredTool(ETool::Pickaxe)
+		, bOpaque(true)
+		, LightEmission(0)
+		, bRandomTicks(false)
+		, bFalls(false)
+		, FluidFlowDistance(0)
+		, FluidTickDelay(5)
+		, Material(nullptr)
+		, Mesh(nullptr)
+	{
+	}
+};
@@ -0,0 +1,301 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelChunk.h"
+#include "BlockRegistry.h"
+#include "Misc/Crc.h"
+#include "Serialization/Archive.h"
+#include "VoxelPool.h"
+
+FVoxelChunk::FVoxelChunk(const FIntPoint& InCoord)
+	: Coord(InCoord)
+	, bPopulated(false)
+	, bModified(false)
+	, NumSolidBlocks(0)
+{
+	for (uint8*& Light : SectionLight)
+	{
+		Light = nullptr;
+	}
+
+	ResetLight(OpenSkyLight);
+}
+
+FVoxelChunk::~FVoxelChunk()
+{
+	ResetLight(0);
+}
+
+void* FVoxelChunk::operator new(size_t Size)
+{
+	check(Size == sizeof(FVoxelChunk));
+	return FVoxelPools::GetChunkPool().Allocate();
+}
+
+void FVoxelChunk::operator delete(void* Chunk)
+{
+	FVoxelPools::GetChunkPool().Free(Chunk);
+}
+
+void FVoxelChunk::SetBlock(int32 X, int32 Y, int32 Z, uint16 BlockType)
+{
+	FVoxelSection& Section = Sections[Z >> FVoxelSection::SizeShift];
+	const int32 Index = GetIndex(X, Y, Z) & (FVoxelSection::NumBlocks - 1);
+
+	NumSolidBlocks += (BlockType != Air) - (Section.Get(Index) != Air);
+	Section.Set(Index, BlockType);
+}
+
+void FVoxelChunk::AssignSection(int32 SectionIndex, const uint16* Blocks)
+{
+	FVoxelSection& Section = Sections[SectionIndex];
+
+	for (int32 Index = 0; Index < FVoxelSection::NumBlocks; ++Index)
+	{
+		NumSolidBlocks += (Blocks[Index] != Air) - (Section.Get(Index) != Air);
+	}
+
+	Section.Assign(Blocks);
+}
+
+void FVoxelChunk::SetLight(int32 X, int32 Y, int32 Z, uint8 Light)
+{
+	const int32 SectionIndex = Z >> FVoxelSection::SizeShift;
+	uint8*& Cells = SectionLight[SectionIndex];
+
+	if (Cells == nullptr)
+	{
+		if (Light == UniformLight[SectionIndex])
+		{
+			return;
+		}
+
+		Cells = (uint8*)FVoxelPools::GetLightPool().Allocate();
+		FMemory::Memset(Cells, UniformLight[SectionIndex], FVoxelSection::NumBlocks);
+	}
+
+	Cells[GetIndex(X, Y, Z) & (FVoxelSection::NumBlocks - 1)] = Light;
+}
+
+void FVoxelChunk::ResetLight(uint8 Light)
+{
+	for (int32 SectionIndex = 0; SectionIndex < NumSections; ++SectionIndex)
+	{
+		FVoxelPools::GetLightPool().Free(SectionLight[SectionIndex]);
+		SectionLight[SectionIndex] = nullptr;
+		UniformLight[SectionIndex] = Light;
+	}
+}
+
+void FVoxelChunk::CompactLight()
+{
+	for (int32 SectionIndex = 0; SectionIndex < NumSections; ++SectionIndex)
+	{
+		uint8*& Cells = SectionLight[SectionIndex];
+
+		if (Cells == nullptr)
+		{
+			continue;
+		}
+
+		const uint8 First = Cells[0];
+		int32 Index = 1;
+
+		while (Index < FVoxelSection::NumBlocks && Cells[Index] == First)
+		{
+			++Index;
+		}
+
+		if (Index == FVoxelSection::NumBlocks)
+		{
+			FVoxelPools::GetLightPool().Free(Cells);
+			Cells = nullptr;
+			UniformLight[SectionIndex] = First;
+		}
+	}
+}
+
+uint32 FVoxelChunk::GetBlocksCrc() const
+{
+	// the same checksum as over one flat array of ids, however the sections store them
+	uint16 Blocks[FVoxelSection::NumBlocks];
+	uint32 Crc = 0;
+
+	for (const FVoxelSection& Section : Sections)
+	{
+		Section.CopyTo(Blocks);
+		Crc = FCrc::MemCrc32(Blocks, sizeof(Blocks), Crc);
+	}
+
+	return Crc;
+}
+
+SIZE_T FVoxelChunk::GetAllocatedSize() const
+{
+	SIZE_T Size = 0;
+
+	for (const FVoxelSection& Section : Sections)
+	{
+		Size += Section.GetAllocatedSize();
+	}
+
+	for (const uint8* Light : SectionLight)
+	{
+		Size += Light != nullptr ? FVoxelSection::NumBlocks : 0;
+	}
+
+	return Size;
+}
+
+void FVoxelChunk::Save(FArchive& Ar) const
+{
+	check(Ar.IsSaving());
+
+	bool bSavedPopulated = bPopulated;
+	bool bSavedModified = bModified;
+	Ar << bSavedPopulated;
+	Ar << bSavedModified;
+
+	// stored flat, the region file's compression takes care of runs
+	uint16 Blocks[FVoxelSection::NumBlocks];
+
+	for (const FVoxelSection& Section : Sections)
+	{
+		Section.CopyTo(Blocks);
+		Ar.Serialize(Blocks, sizeof(Blocks));
+	}
+}
+
+void FVoxelChunk::SaveChanges(FArchive& Ar, const FVoxelChunk& Generated) const
+{
+	check(Ar.IsSaving());
+	static_assert(NumBlocks <= 1 << 16, "changed blocks store their chunk index in 16 bits");
+
+	bool bSavedPopulated = bPopulated;
+	bool bSavedModified = bModified;
+	Ar << bSavedPopulated;
+	Ar << bSavedModified;
+
+	// chunk index and block of every change
+	TArray<uint16> Changes;
+
+	uint16 Blocks[FVoxelSection::NumBlocks];
+	uint16 GeneratedBlocks[FVoxelSection::NumBlocks];
+
+	for (int32 SectionIndex = 0; SectionIndex < NumSections; ++SectionIndex)
+	{
+		const FVoxelSection& Section = Sections[SectionIndex];
+		const FVoxelSection& GeneratedSection = Generated.Sections[SectionIndex];
+
+		// the sky and solid stone, most of the column, never need unpacking
+		if (Section.IsUniform() && GeneratedSection.IsUniform() && Section.Get(0) == GeneratedSection.Get(0))
+		{
+			continue;
+		}
+
+		Section.CopyTo(Blocks);
+		GeneratedSection.CopyTo(GeneratedBlocks);
+
+		for (int32 Index = 0; Index < FVoxelSection::NumBlocks; ++Index)
+		{
+			if (Blocks[Index] != GeneratedBlocks[Index])
+			{
+				Changes.Add((uint16)(SectionIndex * FVoxelSection::NumBlocks + Index));
+				Changes.Add(Blocks[Index]);
+			}
+		}
+	}
+
+	int32 NumChanges = Changes.Num() / 2;
+	Ar << NumChanges;
+	Ar.Serialize(Changes.GetData(), Changes.Num() * sizeof(uint16));
+}
+
+bool FVoxelChunk::LoadChanges(FArchive& Ar, const FBlockRegistry& Registry, int32& OutNumUnknownBlocks)
+{
+	check(Ar.IsLoading());
+
+	OutNumUnknownBlocks = 0;
+
+	Ar << bPopulated;
+	Ar << bModified;
+
+	int32 NumChanges = 0;
+	Ar << NumChanges;
+
+	if (Ar.IsError() || NumChanges < 0 || NumChanges > NumBlocks)
+	{
+		return false;
+	}
+
+	TArray<uint16> Changes;
+	Changes.SetNumUninitialized(NumChanges * 2);
+	Ar.Serialize(Changes.GetData(), Changes.Num() * sizeof(uint16));
+
+	if (Ar.IsError())
+	{
+		return false;
+	}
+
+	for (int32 Change = 0; Change < Changes.Num(); Change += 2)
+	{
+		const int32 Index = Changes[Change];
+		uint16 Block = Changes[Change + 1];
+
+		// the player's edit is lost either way, air at least can't be read past the registry's tables
+		if (!Registry.IsValidId(Block))
+		{
+			Block = Air;
+			++OutNumUnknownBlocks;
+		}
+
+		SetBlock(Index & (SizeX - 1), (Index >> SizeShift) & (SizeY - 1), Index >> (SizeShift * 2), Block);
+	}
+
+	return true;
+}
+
+void FVoxelChunk::CopyBlocksFrom(const FVoxelChunk& Other)
+{
+	bPopulated = Other.bPopulated;
+	bModified = Other.bModified;
+	NumSolidBlocks = Other.NumSolidBlocks;
+
+	for (int32 SectionIndex = 0; SectionIndex < NumSections; ++SectionIndex)
+	{
+		Sections[SectionIndex] = Other.Sections[SectionIndex];
+	}
+}
+
+bool FVoxelChunk::Load(FArchive& Ar, const FBlockRegistry& Registry, int32& OutNumUnknownBlocks)
+{
+	check(Ar.IsLoading());
+
+	Ar << bPopulated;
+	Ar << bModified;
+
+	uint16 Blocks[FVoxelSection::NumBlocks];
+	NumSolidBlocks = 0;
+	OutNumUnknownBlocks = 0;
+
+	for (FVoxelSection& Section : Sections)
+	{
+		Ar.Serialize(Blocks, sizeof(Blocks));
+
+		// the registry's tables are only as long as its ids, anything else would be read past their end
+		for (uint16& Block : Blocks)
+		{
+			if (!Registry.IsValidId(Block))
+			{
+				Block = Air;
+				++OutNumUnknownBlocks;
+			}
+
+			NumSolidBlocks += Block != Air;
+		}
+
+		Section.Assign(Blocks);
+	}
+
+	return !Ar.IsError();
+}
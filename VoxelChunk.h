@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelSection.h"
+
+class FBlockRegistry;
+
+// A 16x16 column of block ids, SizeZ blocks tall. Blocks are stored as compact
+// ids into the voxel world's block types instead of one actor per block, in a stack
+// of palette compressed 16 block tall sections. Chunks and their light come out of the voxel
+// buffer pools, so streaming columns in and out reuses the same memory.
+struct MCUE_API FVoxelChunk
+{
+	static constexpr int32 SizeShift = 4;
+	static constexpr int32 SizeX = 1 << SizeShift;
+	static constexpr int32 SizeY = 1 << SizeShift;
+	static constexpr int32 SizeZ = 256;
+	static constexpr int32 NumBlocks = SizeX * SizeY * SizeZ;
+	static constexpr int32 NumSections = SizeZ / FVoxelSection::Size;
+
+	// id of an empty cell
+	static constexpr uint16 Air = 0;
+
+	// light of a cell in an empty column under open sky, full sky light and no block light
+	static constexpr uint8 OpenSkyLight = 0xF0;
+
+	explicit FVoxelChunk(const FIntPoint& InCoord);
+	~FVoxelChunk();
+
+	// copies go through CopyBlocksFrom, light is never copied
+	FVoxelChunk(const FVoxelChunk&) = delete;
+	FVoxelChunk& operator=(const FVoxelChunk&) = delete;
+
+	static void* operator new(size_t Size);
+	static void operator delete(void* Chunk);
+
+	// position of this column in chunk units
+	FIntPoint Coord;
+
+	// true once the chunk holds its full contents, false while it only has blocks placed into an unloaded column
+	bool bPopulated;
+
+	// true once a block was changed by hand, the chunk can't be regenerated from the seed anymore
+	bool bModified;
+
+	FORCEINLINE static bool IsInside(int32 X, int32 Y, int32 Z)
+	{
+		return (uint32)X < (uint32)SizeX && (uint32)Y < (uint32)SizeY && (uint32)Z < (uint32)SizeZ;
+	}
+
+	// x runs fastest, then y, then z so every horizontal layer is contiguous
+	FORCEINLINE static int32 GetIndex(int32 X, int32 Y, int32 Z)
+	{
+		return X + SizeX * (Y + SizeY * Z);
+	}
+
+	// chunk that contains the given block coordinate
+	FORCEINLINE static FIntPoint ToChunkCoord(const FIntVector& Block)
+	{
+		return FIntPoint(Block.X >> SizeShift, Block.Y >> SizeShift);
+	}
+
+	// block coordinate relative to its chunk
+	FORCEINLINE static FIntVector ToLocal(const FIntVector& Block)
+	{
+		return FIntVector(Block.X & (SizeX - 1), Block.Y & (SizeY - 1), Block.Z);
+	}
+
+	FORCEINLINE uint16 GetBlock(int32 X, int32 Y, int32 Z) const
+	{
+		// a chunk's block index continues straight into its section's index
+		return Sections[Z >> FVoxelSection::SizeShift].Get(GetIndex(X, Y, Z) & (FVoxelSection::NumBlocks - 1));
+	}
+
+	void SetBlock(int32 X, int32 Y, int32 Z, uint16 BlockType);
+
+	// replaces every block of one section with FVoxelSection::NumBlocks ids in section index order,
+	// for edits that touch too many blocks of a section to set them one by one
+	void AssignSection(int32 SectionIndex, const uint16* Blocks);
+
+	// true if the column holds nothing but air
+	FORCEINLINE bool IsEmpty() const { return NumSolidBlocks == 0; }
+
+	// sky light in the high four bits and block light in the low four, kept up to date by FVoxelLighting
+	FORCEINLINE uint8 GetLight(int32 X, int32 Y, int32 Z) const
+	{
+		const int32 SectionIndex = Z >> FVoxelSection::SizeShift;
+		const uint8* Light = SectionLight[SectionIndex];
+
+		return Light != nullptr ? Light[GetIndex(X, Y, Z) & (FVoxelSection::NumBlocks - 1)] : UniformLight[SectionIndex];
+	}
+
+	void SetLight(int32 X, int32 Y, int32 Z, uint8 Light);
+
+	// gives every cell the same light
+	void ResetLight(uint8 Light);
+
+	// frees the per cell light of sections that ended up evenly lit
+	void CompactLight();
+
+	// checksum of the block contents, equal chunks always hash the same
+	uint32 GetBlocksCrc() const;
+
+	// writes the flags and blocks in the format region files store
+	void Save(FArchive& Ar) const;
+
+	// reads what Save wrote, false if the data was cut short. Ids the registry doesn't know, saved
+	// with a bigger registry or damaged, become air and are counted in OutNumUnknownBlocks.
+	bool Load(FArchive& Ar, const FBlockRegistry& Registry, int32& OutNumUnknownBlocks);
+
+	// writes the flags and only the blocks that differ from Generated, the same column straight out
+	// of the terrain generator
+	void SaveChanges(FArchive& Ar, const FVoxelChunk& Generated) const;
+
+	// reads what SaveChanges wrote on top of the generated blocks already in the chunk, false if the
+	// data was cut short. Changes to ids the registry doesn't know become air and are counted in
+	// OutNumUnknownBlocks, changes saved against another registry are expected to hold some.
+	bool LoadChanges(FArchive& Ar, const FBlockRegistry& Registry, int32& OutNumUnknownBlocks);
+
+	// takes over the flags and blocks of another chunk, light is left as it is. Sections are palette
+	// compressed, so copying a whole chunk costs a few kilobytes for most terrain.
+	void CopyBlocksFrom(const FVoxelChunk& Other);
+
+	// size of the block and light storage, not counting the struct itself
+	SIZE_T GetAllocatedSize() const;
+
+	const FVoxelSection& GetSection(int32 SectionIndex) const { return Sections[SectionIndex]; }
+
+	// calls Visit(X, Y, Z, BlockType) for every block of this chunk that Other holds something else
+	// in, air included. Sections that are all air here or the same uniform block in both are skipped.
+	template<typename VisitorType>
+	void ForEachReplacedBlock(const FVoxelChunk& Other, VisitorType Visit) const
+	{
+		for (int32 SectionIndex = 0; SectionIndex < NumSections; ++SectionIndex)
+		{
+			const FVoxelSection& Section = Sections[SectionIndex];
+			const FVoxelSection& OtherSection = Other.Sections[SectionIndex];
+
+			if (Section.IsUniform() && (Section.Get(0) == Air || (OtherSection.IsUniform() && OtherSection.Get(0) == Section.Get(0))))
+			{
+				continue;
+			}
+
+			for (int32 Z = SectionIndex * FVoxelSection::Size; Z < (SectionIndex + 1) * FVoxelSection::Size; ++Z)
+			{
+				for (int32 Y = 0; Y < SizeY; ++Y)
+				{
+					for (int32 X = 0; X < SizeX; ++X)
+					{
+						const uint16 BlockType = GetBlock(X, Y, Z);
+
+						if (BlockType != Air && BlockType != Other.GetBlock(X, Y, Z))
+						{
+							Visit(X, Y, Z, BlockType);
+						}
+					}
+				}
+			}
+		}
+	}
+
+private:
+	// bottom to top, all air to begin with
+	FVoxelSection Sections[NumSections];
+
+	// pooled light per cell of each section, null while every cell of the section has its UniformLight
+	uint8* SectionLight[NumSections];
+	uint8 UniformLight[NumSections];
+
+	int32 NumSolidBlocks;
+};
@@ -0,0 +1,237 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelEdit.h"
+
+namespace
+{
+	// block coordinate of a cell of a chunk section
+	FIntVector GetSectionBlock(const FIntPoint& ChunkCoord, int32 SectionIndex, int32 Index)
+	{
+		constexpr int32 Mask = FVoxelSection::Size - 1;
+
+		return FIntVector(
+			ChunkCoord.X * FVoxelChunk::SizeX + (Index & Mask),
+			ChunkCoord.Y * FVoxelChunk::SizeY + ((Index >> FVoxelSection::SizeShift) & Mask),
+			SectionIndex * FVoxelSection::Size + (Index >> (2 * FVoxelSection::SizeShift)));
+	}
+}
+
+void FVoxelEditJournal::Reset()
+{
+	Sections.Reset();
+	Runs.Reset();
+	NumChanges = 0;
+}
+
+void FVoxelEditJournal::AddChange(int32 Index, uint16 OldBlockType)
+{
+	FSectionChanges& Section = Sections.Last();
+	++NumChanges;
+
+	if (Section.NumRuns > 0)
+	{
+		FRun& Run = Runs.Last();
+
+		if (Run.Start + Run.Count == Index && Run.BlockType == OldBlockType)
+		{
+			++Run.Count;
+			return;
+		}
+	}
+
+	Runs.Add({ (uint16)Index, 1, OldBlockType });
+	++Section.NumRuns;
+}
+
+int32 FVoxelEdit::EditBox(const FIntVector& Min, const FIntVector& Max, FFindChunk FindChunk, FEditBlock Edit, FOnBlockChanged OnChanged, FVoxelEditJournal& Journal)
+{
+	const int32 MinZ = FMath::Max(Min.Z, 0);
+	const int32 MaxZ = FMath::Min(Max.Z, FVoxelChunk::SizeZ - 1);
+
+	if (Min.X > Max.X || Min.Y > Max.Y || MinZ > MaxZ)
+	{
+		return 0;
+	}
+
+	constexpr int32 Size = FVoxelSection::Size;
+
+	const FIntPoint MinChunk = FVoxelChunk::ToChunkCoord(FIntVector(Min.X, Min.Y, 0));
+	const FIntPoint MaxChunk = FVoxelChunk::ToChunkCoord(FIntVector(Max.X, Max.Y, 0));
+
+	uint16 Blocks[FVoxelSection::NumBlocks];
+	const int32 NumChangesBefore = Journal.NumChanges;
+
+	for (int32 ChunkY = MinChunk.Y; ChunkY <= MaxChunk.Y; ++ChunkY)
+	{
+		for (int32 ChunkX = MinChunk.X; ChunkX <= MaxChunk.X; ++ChunkX)
+		{
+			const FIntPoint ChunkCoord(ChunkX, ChunkY);
+			FVoxelChunk* Chunk = FindChunk(ChunkCoord);
+
+			if (Chunk == nullptr)
+			{
+				continue;
+			}
+
+			// the part of the box inside this column, in local coordinates
+			const FIntVector Base(ChunkX * FVoxelChunk::SizeX, ChunkY * FVoxelChunk::SizeY, 0);
+			const int32 MinX = FMath::Max(Min.X - Base.X, 0);
+			const int32 MaxX = FMath::Min(Max.X - Base.X, FVoxelChunk::SizeX - 1);
+			const int32 MinY = FMath::Max(Min.Y - Base.Y, 0);
+			const int32 MaxY = FMath::Min(Max.Y - Base.Y, FVoxelChunk::SizeY - 1);
+
+			for (int32 SectionIndex = MinZ >> FVoxelSection::SizeShift; SectionIndex <= MaxZ >> FVoxelSection::SizeShift; ++SectionIndex)
+			{
+				const int32 SectionZ = SectionIndex * Size;
+				const int32 SectionMinZ = FMath::Max(MinZ - SectionZ, 0);
+				const int32 SectionMaxZ = FMath::Min(MaxZ - SectionZ, Size - 1);
+
+				Chunk->GetSection(SectionIndex).CopyTo(Blocks);
+				Journal.Sections.Add({ ChunkCoord, SectionIndex, Journal.Runs.Num(), 0 });
+
+				for (int32 Z = SectionMinZ; Z <= SectionMaxZ; ++Z)
+				{
+					for (int32 Y = MinY; Y <= MaxY; ++Y)
+					{
+						for (int32 X = MinX; X <= MaxX; ++X)
+						{
+							const int32 Index = X + Size * (Y + Size * Z);
+							const uint16 OldBlockType = Blocks[Index];
+							const uint16 NewBlockType = Edit(Base + FIntVector(X, Y, SectionZ + Z), OldBlockType);
+
+							if (NewBlockType != OldBlockType)
+							{
+								Journal.AddChange(Index, OldBlockType);
+								Blocks[Index] = NewBlockType;
+							}
+						}
+					}
+				}
+
+				// a pass that changed nothing leaves the section and the journal alone
+				if (Journal.Sections.Last().NumRuns == 0)
+				{
+					Journal.Sections.Pop(false);
+					continue;
+				}
+
+				Chunk->AssignSection(SectionIndex, Blocks);
+				ReportSection(Journal, Blocks, OnChanged);
+			}
+		}
+	}
+
+	return Journal.NumChanges - NumChangesBefore;
+}
+
+int32 FVoxelEdit::Undo(const FVoxelEditJournal& Journal, FFindChunk FindChunk, FOnBlockChanged OnChanged, FVoxelEditJournal& OutRedo)
+{
+	uint16 Blocks[FVoxelSection::NumBlocks];
+	const int32 NumChangesBefore = OutRedo.NumChanges;
+
+	// a block changed by several passes gets back what it held before the first one
+	for (int32 SectionIndex = Journal.Sections.Num() - 1; SectionIndex >= 0; --SectionIndex)
+	{
+		const FVoxelEditJournal::FSectionChanges& Changes = Journal.Sections[SectionIndex];
+		FVoxelChunk* Chunk = FindChunk(Changes.ChunkCoord);
+
+		if (Chunk == nullptr)
+		{
+			continue;
+		}
+
+		Chunk->GetSection(Changes.SectionIndex).CopyTo(Blocks);
+		OutRedo.Sections.Add({ Changes.ChunkCoord, Changes.SectionIndex, OutRedo.Runs.Num(), 0 });
+
+		for (int32 RunIndex = Changes.FirstRun; RunIndex < Changes.FirstRun + Changes.NumRuns; ++RunIndex)
+		{
+			const FVoxelEditJournal::FRun& Run = Journal.Runs[RunIndex];
+
+			for (int32 Index = Run.Start; Index < Run.Start + Run.Count; ++Index)
+			{
+				if (Blocks[Index] != Run.BlockType)
+				{
+					OutRedo.AddChange(Index, Blocks[Index]);
+					Blocks[Index] = Run.BlockType;
+				}
+			}
+		}
+
+		if (OutRedo.Sections.Last().NumRuns == 0)
+		{
+			OutRedo.Sections.Pop(false);
+			continue;
+		}
+
+		Chunk->AssignSection(Changes.SectionIndex, Blocks);
+		ReportSection(OutRedo, Blocks, OnChanged);
+	}
+
+	return OutRedo.NumChanges - NumChangesBefore;
+}
+
+void FVoxelEdit::Copy(const FIntVector& Min, const FIntVector& Max, FFindChunk FindChunk, FVoxelClipboard& OutClipboard)
+{
+	OutClipboard.Size = FIntVector(FMath::Max(Max.X - Min.X + 1, 0), FMath::Max(Max.Y - Min.Y + 1, 0), FMath::Max(Max.Z - Min.Z + 1, 0));
+
+	// air where nothing is copied in
+	OutClipboard.Blocks.Reset();
+	OutClipboard.Blocks.SetNumZeroed(OutClipboard.Size.X * OutClipboard.Size.Y * OutClipboard.Size.Z);
+
+	if (OutClipboard.IsEmpty())
+	{
+		return;
+	}
+
+	const int32 MinZ = FMath::Max(Min.Z, 0);
+	const int32 MaxZ = FMath::Min(Max.Z, FVoxelChunk::SizeZ - 1);
+
+	const FIntPoint MinChunk = FVoxelChunk::ToChunkCoord(FIntVector(Min.X, Min.Y, 0));
+	const FIntPoint MaxChunk = FVoxelChunk::ToChunkCoord(FIntVector(Max.X, Max.Y, 0));
+
+	for (int32 ChunkY = MinChunk.Y; ChunkY <= MaxChunk.Y; ++ChunkY)
+	{
+		for (int32 ChunkX = MinChunk.X; ChunkX <= MaxChunk.X; ++ChunkX)
+		{
+			const FVoxelChunk* Chunk = FindChunk(FIntPoint(ChunkX, ChunkY));
+
+			if (Chunk == nullptr)
+			{
+				continue;
+			}
+
+			const FIntVector Base(ChunkX * FVoxelChunk::SizeX, ChunkY * FVoxelChunk::SizeY, 0);
+			const int32 MinX = FMath::Max(Min.X - Base.X, 0);
+			const int32 MaxX = FMath::Min(Max.X - Base.X, FVoxelChunk::SizeX - 1);
+			const int32 MinY = FMath::Max(Min.Y - Base.Y, 0);
+			const int32 MaxY = FMath::Min(Max.Y - Base.Y, FVoxelChunk::SizeY - 1);
+
+			for (int32 Z = MinZ; Z <= MaxZ; ++Z)
+			{
+				for (int32 Y = MinY; Y <= MaxY; ++Y)
+				{
+					for (int32 X = MinX; X <= MaxX; ++X)
+					{
+						OutClipboard.Blocks[OutClipboard.GetIndex(Base + FIntVector(X, Y, Z) - Min)] = Chunk->GetBlock(X, Y, Z);
+					}
+				}
+			}
+		}
+	}
+}
+
+void FVoxelEdit::ReportSection(const FVoxelEditJournal& Journal, const uint16* Blocks, FOnBlockChanged OnChanged)
+{
+	const FVoxelEditJournal::FSectionChanges& Changes = Journal.Sections.Last();
+
+	for (int32 RunIndex = Changes.FirstRun; RunIndex < Changes.FirstRun + Changes.NumRuns; ++RunIndex)
+	{
+		const FVoxelEditJournal::FRun& Run = Journal.Runs[RunIndex];
+
+		for (int32 Index = Run.Start; Index < Run.Start + Run.Count; ++Index)
+		{
+			OnChanged(GetSectionBlock(Changes.ChunkCoord, Changes.SectionIndex, Index), Run.BlockType, Blocks[Index]);
+		}
+	}
+}
@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelChunk.h"
+
+// blocks copied out of a box of the world, x running fastest, then y, then z
+struct MCUE_API FVoxelClipboard
+{
+	FIntVector Size;
+	TArray<uint16> Blocks;
+
+	FVoxelClipboard() : Size(FIntVector::ZeroValue) {}
+
+	FORCEINLINE int32 GetIndex(const FIntVector& Offset) const
+	{
+		return Offset.X + Size.X * (Offset.Y + Size.Y * Offset.Z);
+	}
+
+	bool IsEmpty() const { return Blocks.Num() == 0; }
+};
+
+// What a bulk edit overwrote, enough to put it back. Changes are kept per chunk section as runs of
+// neighbouring cells that held the same block type, so filling or carving big boxes costs a few bytes
+// per row of blocks instead of a few bytes per block.
+class MCUE_API FVoxelEditJournal
+{
+public:
+	FVoxelEditJournal() : NumChanges(0) {}
+
+	bool IsEmpty() const { return NumChanges == 0; }
+
+	// blocks changed, counted once for every time they were changed
+	int32 GetNumChanges() const { return NumChanges; }
+
+	SIZE_T GetAllocatedSize() const { return Sections.GetAllocatedSize() + Runs.GetAllocatedSize(); }
+
+	void Reset();
+
+private:
+	friend class FVoxelEdit;
+
+	// cells Start to Start + Count - 1 of a section, all of which held BlockType
+	struct FRun
+	{
+		uint16 Start;
+		uint16 Count;
+		uint16 BlockType;
+	};
+
+	// the runs one pass over a section recorded, in the order the passes ran
+	struct FSectionChanges
+	{
+		FIntPoint ChunkCoord;
+		int32 SectionIndex;
+		int32 FirstRun;
+		int32 NumRuns;
+	};
+
+	// adds a cell to the last run if it continues it, otherwise starts a run
+	void AddChange(int32 Index, uint16 OldBlockType);
+
+	TArray<FSectionChanges> Sections;
+	TArray<FRun> Runs;
+	int32 NumChanges;
+};
+
+// Bulk edits applied straight to chunk storage. A box is edited a section at a time: the section's
+// blocks are unpacked once, changed in place and packed again, so the palette is rebuilt once per
+// section rather than once per block. Every change goes into a journal and is reported to a callback
+// once its section is written, callers batch their light, mesh and save updates from there. Columns
+// the chunk lookup doesn't know are skipped. Touches no engine objects, so edits run headless too.
+class MCUE_API FVoxelEdit
+{
+public:
+	// loaded chunk at the coordinate, null if there is none
+	typedef TFunctionRef<FVoxelChunk*(const FIntPoint&)> FFindChunk;
+
+	// the block type a block becomes, returning OldBlockType leaves it as it is
+	typedef TFunctionRef<uint16(const FIntVector& Block, uint16 OldBlockType)> FEditBlock;
+
+	// called for every block that changed, after its section was written
+	typedef TFunctionRef<void(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType)> FOnBlockChanged;
+
+	// runs Edit over every block from Min to Max, both included, and records what changed in Journal.
+	// Returns the number of blocks changed.
+	static int32 EditBox(const FIntVector& Min, const FIntVector& Max, FFindChunk FindChunk, FEditBlock Edit, FOnBlockChanged OnChanged, FVoxelEditJournal& Journal);
+
+	// puts back what the journal recorded, latest change first, and records what that overwrote in
+	// OutRedo. Chunks that are no longer loaded keep their blocks. Returns the number of blocks changed.
+	static int32 Undo(const FVoxelEditJournal& Journal, FFindChunk FindChunk, FOnBlockChanged OnChanged, FVoxelEditJournal& OutRedo);
+
+	// copies the blocks from Min to Max, both included, blocks outside the loaded world are copied as air
+	static void Copy(const FIntVector& Min, const FIntVector& Max, FFindChunk FindChunk, FVoxelClipboard& OutClipboard);
+
+private:
+	// reports the changes of the journal's last section, Blocks holds what the section has now
+	static void ReportSection(const FVoxelEditJournal& Journal, const uint16* Blocks, FOnBlockChanged OnChanged);
+};
@@ -0,0 +1,210 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelEdit.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Crc.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr uint16 Stone = 1;
+	constexpr uint16 Dirt = 2;
+
+	// a square of chunks around the origin, stone up to the middle and air above
+	struct FEditTestArea
+	{
+		static constexpr int32 Radius = 1;
+		static constexpr int32 GroundHeight = 64;
+
+		TMap<FIntPoint, TUniquePtr<FVoxelChunk>> Chunks;
+
+		FEditTestArea()
+		{
+			for (int32 Y = -Radius; Y <= Radius; ++Y)
+			{
+				for (int32 X = -Radius; X <= Radius; ++X)
+				{
+					TUniquePtr<FVoxelChunk> Chunk = MakeUnique<FVoxelChunk>(FIntPoint(X, Y));
+
+					for (int32 Z = 0; Z < GroundHeight; ++Z)
+					{
+						for (int32 LocalY = 0; LocalY < FVoxelChunk::SizeY; ++LocalY)
+						{
+							for (int32 LocalX = 0; LocalX < FVoxelChunk::SizeX; ++LocalX)
+							{
+								Chunk->SetBlock(LocalX, LocalY, Z, Stone);
+							}
+						}
+					}
+
+					Chunks.Add(FIntPoint(X, Y), MoveTemp(Chunk));
+				}
+			}
+		}
+
+		FVoxelChunk* FindChunk(const FIntPoint& ChunkCoord) const
+		{
+			const TUniquePtr<FVoxelChunk>* Chunk = Chunks.Find(ChunkCoord);
+			return Chunk != nullptr ? Chunk->Get() : nullptr;
+		}
+
+		// CRCs of every chunk's blocks in coordinate order, to compare the area before and after an edit
+		uint32 GetCrc() const
+		{
+			uint32 Crc = 0;
+
+			for (int32 Y = -Radius; Y <= Radius; ++Y)
+			{
+				for (int32 X = -Radius; X <= Radius; ++X)
+				{
+					const uint32 ChunkCrc = FindChunk(FIntPoint(X, Y))->GetBlocksCrc();
+					Crc = FCrc::MemCrc32(&ChunkCrc, sizeof(ChunkCrc), Crc);
+				}
+			}
+
+			return Crc;
+		}
+	};
+
+	// a box across every chunk border of the area, from the bottom to above the ground
+	const FIntVector EditMin(-FVoxelChunk::SizeX + 3, -FVoxelChunk::SizeY + 3, 1);
+	const FIntVector EditMax(2 * FVoxelChunk::SizeX - 4, 2 * FVoxelChunk::SizeY - 4, 100);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelEditFillTest, "MCUE.Voxel.Edit.FillMatchesSetBlock", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelEditFillTest::RunTest(const FString& Parameters)
+{
+	FEditTestArea PerBlock;
+
+	for (int32 Z = EditMin.Z; Z <= EditMax.Z; ++Z)
+	{
+		for (int32 Y = EditMin.Y; Y <= EditMax.Y; ++Y)
+		{
+			for (int32 X = EditMin.X; X <= EditMax.X; ++X)
+			{
+				const FIntVector Local = FVoxelChunk::ToLocal(FIntVector(X, Y, Z));
+				PerBlock.FindChunk(FVoxelChunk::ToChunkCoord(FIntVector(X, Y, Z)))->SetBlock(Local.X, Local.Y, Local.Z, Dirt);
+			}
+		}
+	}
+
+	FEditTestArea Bulk;
+	FVoxelEditJournal Journal;
+	int32 NumReported = 0;
+
+	const int32 NumChanged = FVoxelEdit::EditBox(EditMin, EditMax,
+		[&Bulk](const FIntPoint& ChunkCoord) { return Bulk.FindChunk(ChunkCoord); },
+		[](const FIntVector&, uint16) { return Dirt; },
+		[&NumReported](const FIntVector&, uint16, uint16) { ++NumReported; },
+		Journal);
+
+	const FIntVector Size = EditMax - EditMin + FIntVector(1);
+
+	TestEqual(TEXT("a bulk fill leaves the same blocks as filling block by block"), Bulk.GetCrc(), PerBlock.GetCrc());
+	TestEqual(TEXT("every block of the box changed"), NumChanged, Size.X * Size.Y * Size.Z);
+	TestEqual(TEXT("every change is reported"), NumReported, NumChanged);
+	TestEqual(TEXT("every change is journaled"), Journal.GetNumChanges(), NumChanged);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelEditUndoTest, "MCUE.Voxel.Edit.UndoRedo", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelEditUndoTest::RunTest(const FString& Parameters)
+{
+	FEditTestArea Area;
+	auto FindChunk = [&Area](const FIntPoint& ChunkCoord) { return Area.FindChunk(ChunkCoord); };
+	auto IgnoreChange = [](const FIntVector&, uint16, uint16) {};
+
+	const uint32 OriginalCrc = Area.GetCrc();
+
+	// two passes in the same journal, undo has to see through both
+	FVoxelEditJournal Journal;
+	FVoxelEdit::EditBox(EditMin, EditMax, FindChunk, [](const FIntVector&, uint16) { return Dirt; }, IgnoreChange, Journal);
+
+	const FIntVector Center(0, 0, 64);
+	constexpr int32 SphereRadius = 12;
+
+	FVoxelEdit::EditBox(Center - FIntVector(SphereRadius), Center + FIntVector(SphereRadius), FindChunk,
+		[&Center](const FIntVector& Block, uint16 OldBlockType)
+		{
+			const FIntVector Offset = Block - Center;
+			return Offset.X * Offset.X + Offset.Y * Offset.Y + Offset.Z * Offset.Z <= SphereRadius * SphereRadius ? FVoxelChunk::Air : OldBlockType;
+		},
+		IgnoreChange, Journal);
+
+	const uint32 EditedCrc = Area.GetCrc();
+	TestTrue(TEXT("the edit changed the area"), EditedCrc != OriginalCrc);
+
+	FVoxelEditJournal Redo;
+	FVoxelEdit::Undo(Journal, FindChunk, IgnoreChange, Redo);
+	TestEqual(TEXT("undo puts back the area as it was"), Area.GetCrc(), OriginalCrc);
+
+	FVoxelEditJournal Undo;
+	FVoxelEdit::Undo(Redo, FindChunk, IgnoreChange, Undo);
+	TestEqual(TEXT("redo applies both passes again"), Area.GetCrc(), EditedCrc);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelEditPasteTest, "MCUE.Voxel.Edit.PasteInPlace", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelEditPasteTest::RunTest(const FString& Parameters)
+{
+	FEditTestArea Area;
+	auto FindChunk = [&Area](const FIntPoint& ChunkCoord) { return Area.FindChunk(ChunkCoord); };
+
+	FVoxelClipboard Clipboard;
+	FVoxelEdit::Copy(EditMin, EditMax, FindChunk, Clipboard);
+
+	FVoxelEditJournal Journal;
+	const int32 NumPasted = FVoxelEdit::EditBox(EditMin, EditMax, FindChunk,
+		[&Clipboard](const FIntVector& Block, uint16) { return Clipboard.Blocks[Clipboard.GetIndex(Block - EditMin)]; },
+		[](const FIntVector&, uint16, uint16) {}, Journal);
+
+	TestEqual(TEXT("pasting a copy back where it came from changes nothing"), NumPasted, 0);
+	TestTrue(TEXT("and journals nothing"), Journal.IsEmpty());
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelEditSavedChunkTest, "MCUE.Voxel.Edit.SavedChunkReplacesPlacedBlocks", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelEditSavedChunkTest::RunTest(const FString& Parameters)
+{
+	// blocks placed into a column before it streamed in, the world has instances for these
+	FVoxelChunk Placed(FIntPoint::ZeroValue);
+	Placed.SetBlock(3, 4, 100, Stone);
+	Placed.SetBlock(5, 5, 101, Stone);
+	Placed.SetBlock(7, 7, 102, Dirt);
+
+	// the save has the first one broken, the second as it was and the third replaced
+	FEditTestArea Saved;
+	FVoxelChunk& Loaded = *Saved.FindChunk(FIntPoint::ZeroValue);
+	Loaded.SetBlock(5, 5, 101, Stone);
+	Loaded.SetBlock(7, 7, 102, Stone);
+
+	TArray<FIntVector> Replaced;
+	TArray<uint16> ReplacedTypes;
+
+	Placed.ForEachReplacedBlock(Loaded, [&](int32 X, int32 Y, int32 Z, uint16 BlockType)
+	{
+		Replaced.Add(FIntVector(X, Y, Z));
+		ReplacedTypes.Add(BlockType);
+	});
+
+	TestEqual(TEXT("the broken and the replaced block lose their instances"), Replaced.Num(), 2);
+
+	if (Replaced.Num() == 2)
+	{
+		TestTrue(TEXT("the broken block is found"), Replaced[0] == FIntVector(3, 4, 100) && ReplacedTypes[0] == Stone);
+		TestTrue(TEXT("the replaced block is found with its old type"), Replaced[1] == FIntVector(7, 7, 102) && ReplacedTypes[1] == Dirt);
+	}
+
+	int32 NumUnchanged = 0;
+	Loaded.ForEachReplacedBlock(Loaded, [&NumUnchanged](int32, int32, int32, uint16) { ++NumUnchanged; });
+	TestEqual(TEXT("a chunk replacing itself replaces nothing"), NumUnchanged, 0);
+	return true;
+}
+
+#endif
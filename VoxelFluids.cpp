@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelFluids.h"
+#include "BlockRegistry.h"
+#include "VoxelBlockTicks.h"
+#include "VoxelChunk.h"
+
+namespace
+{
+	const FIntVector Up(0, 0, 1);
+	const FIntVector Down(0, 0, -1);
+
+	const FIntVector Sideways[] =
+	{
+		FIntVector(1, 0, 0), FIntVector(-1, 0, 0),
+		FIntVector(0, 1, 0), FIntVector(0, -1, 0)
+	};
+
+	const FIntVector Neighbours[] =
+	{
+		FIntVector(1, 0, 0), FIntVector(-1, 0, 0),
+		FIntVector(0, 1, 0), FIntVector(0, -1, 0),
+		FIntVector(0, 0, 1), FIntVector(0, 0, -1)
+	};
+}
+
+FVoxelFluids::FVoxelFluids(const FBlockRegistry& InRegistry)
+	: Registry(InRegistry)
+{
+}
+
+bool FVoxelFluids::CanChange(uint16 BlockType) const
+{
+	return BlockType == FVoxelChunk::Air || Registry.GetFluidLevel(BlockType) > 0;
+}
+
+void FVoxelFluids::OnBlockChanged(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType, FGetBlock GetBlock, FVoxelBlockTicks& Ticks) const
+{
+	if (!Registry.HasFluids())
+	{
+		return;
+	}
+
+	uint16 FluidSource = Registry.IsFluid(NewBlockType) ? Registry.GetFluidSource(NewBlockType) : Registry.GetFluidSource(OldBlockType);
+
+	// a block that went away or showed up next to fluid, the fluid it touches decides how soon it reacts
+	for (int32 Direction = 0; FluidSource == FVoxelChunk::Air && Direction < UE_ARRAY_COUNT(Neighbours); ++Direction)
+	{
+		FluidSource = Registry.GetFluidSource(GetBlock(Block + Neighbours[Direction]));
+	}
+
+	if (FluidSource == FVoxelChunk::Air)
+	{
+		return;
+	}
+
+	const int32 Delay = Registry.Get(FluidSource).FluidTickDelay;
+
+	if (CanChange(NewBlockType))
+	{
+		Ticks.ScheduleTick(Block, NewBlockType, Delay);
+	}
+
+	for (const FIntVector& Direction : Neighbours)
+	{
+		const FIntVector Neighbour = Block + Direction;
+		const uint16 NeighbourType = GetBlock(Neighbour);
+
+		if (CanChange(NeighbourType))
+		{
+			Ticks.ScheduleTick(Neighbour, NeighbourType, Delay);
+		}
+	}
+}
+
+bool FVoxelFluids::SpreadsSideways(const FIntVector& Block, uint16 FluidSource, FGetBlock GetBlock) const
+{
+	if (Block.Z == 0)
+	{
+		return true;
+	}
+
+	// fluid keeps falling into air and into fluid of its own kind that is flowing, it only spreads once it rests on something
+	const uint16 Below = GetBlock(Block + Down);
+
+	return Below != FVoxelChunk::Air && (Registry.GetFluidSource(Below) != FluidSource || Registry.GetFluidLevel(Below) == 0);
+}
+
+bool FVoxelFluids::UpdateCell(const FIntVector& Block, FGetBlock GetBlock, FSetBlock SetBlock) const
+{
+	const uint16 Current = GetBlock(Block);
+
+	// sources and every other block stay what they are
+	if (!CanChange(Current))
+	{
+		return false;
+	}
+
+	uint16 FluidSource = Registry.GetFluidSource(Current);
+	int32 Level = MAX_int32;
+
+	// fluid from above keeps the cell as full as fluid gets short of a source, so it spreads out again where it lands
+	const uint16 Above = Block.Z + 1 < FVoxelChunk::SizeZ ? GetBlock(Block + Up) : FVoxelChunk::Air;
+
+	if (Registry.IsFluid(Above) && (FluidSource == FVoxelChunk::Air || Registry.GetFluidSource(Above) == FluidSource))
+	{
+		FluidSource = Registry.GetFluidSource(Above);
+		Level = 1;
+	}
+	else
+	{
+		for (const FIntVector& Direction : Sideways)
+		{
+			const FIntVector Neighbour = Block + Direction;
+			const uint16 NeighbourType = GetBlock(Neighbour);
+			const uint16 NeighbourSource = Registry.GetFluidSource(NeighbourType);
+
+			// two fluids don't mix, the cell sticks with the first one it found
+			if (NeighbourSource == FVoxelChunk::Air || (FluidSource != FVoxelChunk::Air && NeighbourSource != FluidSource))
+			{
+				continue;
+			}
+
+			const int32 NeighbourLevel = Registry.GetFluidLevel(NeighbourType) + 1;
+
+			if (NeighbourLevel < Level && SpreadsSideways(Neighbour, NeighbourSource, GetBlock))
+			{
+				FluidSource = NeighbourSource;
+				Level = NeighbourLevel;
+			}
+		}
+	}
+
+	// flowing fluid cut off from its source gets further from it with every update around it until it is past the flow distance and dries up
+	uint16 NewBlockType = FVoxelChunk::Air;
+
+	if (FluidSource != FVoxelChunk::Air && Level <= Registry.Get(FluidSource).FluidFlowDistance)
+	{
+		NewBlockType = Registry.GetFluidBlock(FluidSource, Level);
+	}
+
+	if (NewBlockType == Current)
+	{
+		return false;
+	}
+
+	SetBlock(Block, NewBlockType);
+	return true;
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FBlockRegistry;
+class FVoxelBlockTicks;
+
+// Fluids like water and lava as a cellular automaton on the block grid. A fluid source never
+// changes on its own, fluid falls straight down from any fluid above and flows sideways from
+// fluid resting on something, one flow level further from its source per block. Each cell works
+// out its own fluid from its neighbours, so after a change only the cells around it are
+// scheduled as block ticks, a flood front moves one block per FluidTickDelay game ticks and
+// runs under the block tick budget. Touches no engine objects, blocks are read and written
+// through callbacks.
+class MCUE_API FVoxelFluids
+{
+public:
+	typedef TFunctionRef<uint16(const FIntVector&)> FGetBlock;
+	typedef TFunctionRef<void(const FIntVector&, uint16)> FSetBlock;
+
+	explicit FVoxelFluids(const FBlockRegistry& InRegistry);
+
+	// schedules the cells a block going from OldBlockType to NewBlockType may make flow or dry up.
+	// Costs a few block reads for changes away from any fluid.
+	void OnBlockChanged(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType, FGetBlock GetBlock, FVoxelBlockTicks& Ticks) const;
+
+	// works out the fluid of one cell from its neighbours and writes it if it changed. Only air and
+	// flowing fluid are ever replaced. Returns true if the cell changed.
+	bool UpdateCell(const FIntVector& Block, FGetBlock GetBlock, FSetBlock SetBlock) const;
+
+private:
+	// true if fluid in the cell spreads sideways instead of falling on down
+	bool SpreadsSideways(const FIntVector& Block, uint16 FluidSource, FGetBlock GetBlock) const;
+
+	// air or flowing fluid, the cells fluid can flow into
+	bool CanChange(uint16 BlockType) const;
+
+	const FBlockRegistry& Registry;
+};
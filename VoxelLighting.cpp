@@ -0,0 +1,524 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelLighting.h"
+#include "BlockRegistry.h"
+#include "VoxelChunk.h"
+
+namespace
+{
+	// the six neighbours of a cell, straight down last
+	const FIntVector NeighbourOffsets[] =
+	{
+		FIntVector(1, 0, 0),
+		FIntVector(-1, 0, 0),
+		FIntVector(0, 1, 0),
+		FIntVector(0, -1, 0),
+		FIntVector(0, 0, 1),
+		FIntVector(0, 0, -1)
+	};
+
+	constexpr int32 DownIndex = 5;
+
+	// where each channel sits in a cell's light byte, sky light high and block light low
+	constexpr int32 ChannelShifts[] = { 4, 0 };
+}
+
+FVoxelLighting::FVoxelLighting(const FBlockRegistry& InRegistry)
+	: Registry(InRegistry)
+	, RemovalQueues{ TVoxelArenaQueue<FRemovalNode>(Scratch), TVoxelArenaQueue<FRemovalNode>(Scratch) }
+	, AddQueues{ TVoxelArenaQueue<FIntVector>(Scratch), TVoxelArenaQueue<FIntVector>(Scratch) }
+	, FindChunkFunc(nullptr)
+	, CachedCoord(FIntPoint::ZeroValue)
+	, CachedChunk(nullptr)
+	, bHasCachedChunk(false)
+	, LastChangedChunk(nullptr)
+	, bTrackChangedChunks(true)
+	, NumChangedCells(0)
+{
+}
+
+void FVoxelLighting::LightChunk(FVoxelChunk& Chunk, const FBlockRegistry& BlockRegistry)
+{
+	FVoxelLighting Lighting(BlockRegistry);
+
+	auto FindOnlyChunk = [&Chunk](const FIntPoint& ChunkCoord) { return ChunkCoord == Chunk.Coord ? &Chunk : nullptr; };
+	const FFindChunk FindChunk(FindOnlyChunk);
+	Lighting.FindChunkFunc = &FindChunk;
+	Lighting.bTrackChangedChunks = false;
+
+	Chunk.ResetLight(0);
+
+	const FIntVector Base(Chunk.Coord.X * FVoxelChunk::SizeX, Chunk.Coord.Y * FVoxelChunk::SizeY, 0);
+
+	// lowest cell of each column that sunlight still reaches
+	int32 Heights[FVoxelChunk::SizeX * FVoxelChunk::SizeY];
+
+	for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+	{
+		for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+		{
+			int32 Z = FVoxelChunk::SizeZ;
+
+			while (Z > 0 && !BlockRegistry.IsOpaque(Chunk.GetBlock(X, Y, Z - 1)))
+			{
+				--Z;
+				Chunk.SetLight(X, Y, Z, FVoxelChunk::OpenSkyLight);
+			}
+
+			Heights[X + Y * FVoxelChunk::SizeX] = Z;
+		}
+	}
+
+	// sunlit cells next to a column that is still in shade at their height light it from the side
+	for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+	{
+		for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+		{
+			for (int32 Direction = 0; Direction < 4; ++Direction)
+			{
+				const int32 NeighbourX = X + NeighbourOffsets[Direction].X;
+				const int32 NeighbourY = Y + NeighbourOffsets[Direction].Y;
+
+				if (!FVoxelChunk::IsInside(NeighbourX, NeighbourY, 0))
+				{
+					continue;
+				}
+
+				const int32 NeighbourHeight = Heights[NeighbourX + NeighbourY * FVoxelChunk::SizeX];
+
+				for (int32 Z = Heights[X + Y * FVoxelChunk::SizeX]; Z < NeighbourHeight; ++Z)
+				{
+					Lighting.AddQueues[SkyChannel].Add(Base + FIntVector(X, Y, Z));
+				}
+			}
+		}
+	}
+
+	if (BlockRegistry.HasLightEmitters())
+	{
+		for (int32 SectionIndex = 0; SectionIndex < FVoxelChunk::NumSections; ++SectionIndex)
+		{
+			const FVoxelSection& Section = Chunk.GetSection(SectionIndex);
+
+			// a whole section of air or rock has nothing to look at
+			if (Section.IsUniform() && BlockRegistry.GetLightEmission(Section.Get(0)) == 0)
+			{
+				continue;
+			}
+
+			for (int32 Z = SectionIndex * FVoxelSection::Size; Z < (SectionIndex + 1) * FVoxelSection::Size; ++Z)
+			{
+				for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+				{
+					for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+					{
+						const uint8 Emission = BlockRegistry.GetLightEmission(Chunk.GetBlock(X, Y, Z));
+
+						if (Emission > 0)
+						{
+							Lighting.WriteLevel(Chunk, FIntVector(X, Y, Z), BlockChannel, Emission);
+							Lighting.AddQueues[BlockChannel].Add(Base + FIntVector(X, Y, Z));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	Lighting.RunAdd(SkyChannel);
+	Lighting.RunAdd(BlockChannel);
+
+	Chunk.CompactLight();
+}
+
+void FVoxelLighting::AddBlockChange(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType)
+{
+	// blocks that pass and give off light alike leave it as it was, like fluid flowing into air
+	if (Registry.IsOpaque(OldBlockType) == Registry.IsOpaque(NewBlockType) && Registry.GetLightEmission(OldBlockType) == Registry.GetLightEmission(NewBlockType))
+	{
+		return;
+	}
+
+	BlockChanges.Add({ Block, OldBlockType, NewBlockType });
+}
+
+void FVoxelLighting::AddChunk(const FIntPoint& ChunkCoord)
+{
+	AddedChunks.Add(ChunkCoord);
+}
+
+void FVoxelLighting::AddEditedChunk(const FIntPoint& ChunkCoord)
+{
+	EditedChunks.AddUnique(ChunkCoord);
+}
+
+int32 FVoxelLighting::Update(FFindChunk FindChunk)
+{
+	FindChunkFunc = &FindChunk;
+	bHasCachedChunk = false;
+	LastChangedChunk = nullptr;
+	NumChangedCells = 0;
+
+	// every removal reads the old light, so none of the edited chunks may be relit before
+	for (const FIntPoint& ChunkCoord : EditedChunks)
+	{
+		SeedChunkRemoval(ChunkCoord);
+	}
+
+	for (const FIntPoint& ChunkCoord : EditedChunks)
+	{
+		if (FVoxelChunk* Chunk = (*FindChunkFunc)(ChunkCoord))
+		{
+			LightChunk(*Chunk, Registry);
+			SeedChunkBorders(ChunkCoord);
+
+			if (bTrackChangedChunks)
+			{
+				ChangedChunks.Add(ChunkCoord);
+			}
+		}
+	}
+
+	for (const FBlockChange& Change : BlockChanges)
+	{
+		SeedBlockChange(Change);
+	}
+
+	for (const FIntPoint& ChunkCoord : AddedChunks)
+	{
+		SeedChunkBorders(ChunkCoord);
+	}
+
+	BlockChanges.Reset();
+	AddedChunks.Reset();
+	EditedChunks.Reset();
+
+	for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+	{
+		// removal goes first, it queues up the cells light has to flow back in from
+		RunRemoval(Channel);
+		RunAdd(Channel);
+	}
+
+	FindChunkFunc = nullptr;
+
+	return NumChangedCells;
+}
+
+TSet<FIntPoint> FVoxelLighting::ConsumeChangedChunks()
+{
+	TSet<FIntPoint> Result = MoveTemp(ChangedChunks);
+	ChangedChunks.Reset();
+	return Result;
+}
+
+FVoxelChunk* FVoxelLighting::FindCell(const FIntVector& Block, FIntVector& OutLocal)
+{
+	if ((uint32)Block.Z >= (uint32)FVoxelChunk::SizeZ)
+	{
+		return nullptr;
+	}
+
+	const FIntPoint ChunkCoord = FVoxelChunk::ToChunkCoord(Block);
+
+	if (!bHasCachedChunk || ChunkCoord != CachedCoord)
+	{
+		CachedCoord = ChunkCoord;
+		CachedChunk = (*FindChunkFunc)(ChunkCoord);
+		bHasCachedChunk = true;
+	}
+
+	OutLocal = FVoxelChunk::ToLocal(Block);
+	return CachedChunk;
+}
+
+uint8 FVoxelLighting::ReadLevel(const FVoxelChunk& Chunk, const FIntVector& Local, int32 Channel)
+{
+	return (Chunk.GetLight(Local.X, Local.Y, Local.Z) >> ChannelShifts[Channel]) & MaxLight;
+}
+
+void FVoxelLighting::WriteLevel(FVoxelChunk& Chunk, const FIntVector& Local, int32 Channel, uint8 Level)
+{
+	const int32 Shift = ChannelShifts[Channel];
+	const uint8 Light = Chunk.GetLight(Local.X, Local.Y, Local.Z);
+
+	Chunk.SetLight(Local.X, Local.Y, Local.Z, (uint8)((Light & ~(MaxLight << Shift)) | (Level << Shift)));
+	++NumChangedCells;
+
+	if (!bTrackChangedChunks)
+	{
+		return;
+	}
+
+	if (&Chunk != LastChangedChunk)
+	{
+		LastChangedChunk = &Chunk;
+		ChangedChunks.Add(Chunk.Coord);
+	}
+
+	// faces of the neighbouring column that look at a border cell are lit by it
+	if (Local.X == 0)
+	{
+		ChangedChunks.Add(Chunk.Coord + FIntPoint(-1, 0));
+	}
+	else if (Local.X == FVoxelChunk::SizeX - 1)
+	{
+		ChangedChunks.Add(Chunk.Coord + FIntPoint(1, 0));
+	}
+
+	if (Local.Y == 0)
+	{
+		ChangedChunks.Add(Chunk.Coord + FIntPoint(0, -1));
+	}
+	else if (Local.Y == FVoxelChunk::SizeY - 1)
+	{
+		ChangedChunks.Add(Chunk.Coord + FIntPoint(0, 1));
+	}
+}
+
+void FVoxelLighting::SeedBlockChange(const FBlockChange& Change)
+{
+	FIntVector Local;
+	FVoxelChunk* Chunk = FindCell(Change.Block, Local);
+
+	if (Chunk == nullptr)
+	{
+		return;
+	}
+
+	const bool bOpaque = Registry.IsOpaque(Change.NewBlockType);
+	const uint8 OldEmission = Registry.GetLightEmission(Change.OldBlockType);
+	const uint8 NewEmission = Registry.GetLightEmission(Change.NewBlockType);
+
+	for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+	{
+		const uint8 Level = ReadLevel(*Chunk, Local, Channel);
+
+		// an opaque block swallows the light that was here, a light source going out takes its light with it
+		if (Level > 0 && (bOpaque || (Channel == BlockChannel && OldEmission > 0)))
+		{
+			WriteLevel(*Chunk, Local, Channel, 0);
+			RemovalQueues[Channel].Add({ Change.Block, Level });
+		}
+
+		if (Channel == BlockChannel && NewEmission > ReadLevel(*Chunk, Local, Channel))
+		{
+			WriteLevel(*Chunk, Local, Channel, NewEmission);
+			AddQueues[Channel].Add(Change.Block);
+		}
+
+		if (bOpaque)
+		{
+			continue;
+		}
+
+		// nothing sits above the top layer, the sun shines on it directly
+		if (Channel == SkyChannel && Change.Block.Z == FVoxelChunk::SizeZ - 1 && Level < MaxLight)
+		{
+			WriteLevel(*Chunk, Local, Channel, MaxLight);
+			AddQueues[Channel].Add(Change.Block);
+		}
+
+		// light around an opened up cell flows into it
+		for (const FIntVector& Offset : NeighbourOffsets)
+		{
+			AddQueues[Channel].Add(Change.Block + Offset);
+		}
+	}
+}
+
+void FVoxelLighting::SeedChunkBorders(const FIntPoint& ChunkCoord)
+{
+	if ((*FindChunkFunc)(ChunkCoord) == nullptr)
+	{
+		return;
+	}
+
+	const FIntPoint Sides[] = { FIntPoint(1, 0), FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(0, -1) };
+	const FIntVector Base(ChunkCoord.X * FVoxelChunk::SizeX, ChunkCoord.Y * FVoxelChunk::SizeY, 0);
+
+	for (const FIntPoint& Side : Sides)
+	{
+		if ((*FindChunkFunc)(ChunkCoord + Side) == nullptr)
+		{
+			continue;
+		}
+
+		const int32 RowLength = Side.X != 0 ? FVoxelChunk::SizeY : FVoxelChunk::SizeX;
+
+		// the row of cells along this side and the row facing it in the neighbour, light may cross either way
+		for (int32 Index = 0; Index < RowLength; ++Index)
+		{
+			const int32 X = Side.X > 0 ? FVoxelChunk::SizeX - 1 : (Side.X < 0 ? 0 : Index);
+			const int32 Y = Side.Y > 0 ? FVoxelChunk::SizeY - 1 : (Side.Y < 0 ? 0 : Index);
+
+			for (int32 Z = 0; Z < FVoxelChunk::SizeZ; ++Z)
+			{
+				const FIntVector Inner = Base + FIntVector(X, Y, Z);
+				const FIntVector Outer = Inner + FIntVector(Side.X, Side.Y, 0);
+
+				for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+				{
+					AddQueues[Channel].Add(Inner);
+					AddQueues[Channel].Add(Outer);
+				}
+			}
+		}
+	}
+}
+
+void FVoxelLighting::SeedChunkRemoval(const FIntPoint& ChunkCoord)
+{
+	const FVoxelChunk* Chunk = (*FindChunkFunc)(ChunkCoord);
+
+	if (Chunk == nullptr)
+	{
+		return;
+	}
+
+	const FIntPoint Sides[] = { FIntPoint(1, 0), FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(0, -1) };
+	const FIntVector Base(ChunkCoord.X * FVoxelChunk::SizeX, ChunkCoord.Y * FVoxelChunk::SizeY, 0);
+
+	for (const FIntPoint& Side : Sides)
+	{
+		FVoxelChunk* Neighbour = (*FindChunkFunc)(ChunkCoord + Side);
+
+		if (Neighbour == nullptr)
+		{
+			continue;
+		}
+
+		const int32 RowLength = Side.X != 0 ? FVoxelChunk::SizeY : FVoxelChunk::SizeX;
+
+		for (int32 Index = 0; Index < RowLength; ++Index)
+		{
+			const int32 X = Side.X > 0 ? FVoxelChunk::SizeX - 1 : (Side.X < 0 ? 0 : Index);
+			const int32 Y = Side.Y > 0 ? FVoxelChunk::SizeY - 1 : (Side.Y < 0 ? 0 : Index);
+
+			for (int32 Z = 0; Z < FVoxelChunk::SizeZ; ++Z)
+			{
+				const FIntVector Inner(X, Y, Z);
+				const FIntVector Outer = Base + FIntVector(X + Side.X, Y + Side.Y, Z);
+				const FIntVector OuterLocal = FVoxelChunk::ToLocal(Outer);
+
+				for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+				{
+					const uint8 Level = ReadLevel(*Neighbour, OuterLocal, Channel);
+
+					// one level darker than the cell across the border, the light may have come from it
+					if (Level > 0 && ReadLevel(*Chunk, Inner, Channel) == Level + 1)
+					{
+						WriteLevel(*Neighbour, OuterLocal, Channel, 0);
+						RemovalQueues[Channel].Add({ Outer, Level });
+					}
+				}
+			}
+		}
+	}
+}
+
+void FVoxelLighting::RunRemoval(int32 Channel)
+{
+	TVoxelArenaQueue<FRemovalNode>& Queue = RemovalQueues[Channel];
+	TVoxelArenaQueue<FIntVector>& AddQueue = AddQueues[Channel];
+
+	for (int32 Head = 0; Head < Queue.Num(); ++Head)
+	{
+		// copied, the queue grows while it is walked
+		const FRemovalNode Node = Queue[Head];
+
+		for (int32 Direction = 0; Direction < UE_ARRAY_COUNT(NeighbourOffsets); ++Direction)
+		{
+			const FIntVector Neighbour = Node.Block + NeighbourOffsets[Direction];
+
+			FIntVector Local;
+			FVoxelChunk* Chunk = FindCell(Neighbour, Local);
+
+			if (Chunk == nullptr)
+			{
+				continue;
+			}
+
+			const uint8 Level = ReadLevel(*Chunk, Local, Channel);
+
+			if (Level == 0)
+			{
+				continue;
+			}
+
+			// sunlight falling straight down is as bright as the light above it, so it goes however bright it is
+			const bool bSunlightBelow = Channel == SkyChannel && Direction == DownIndex && Node.Level == MaxLight && Level == MaxLight;
+
+			if (Level < Node.Level || bSunlightBelow)
+			{
+				// a light source keeps its own light and spreads it again afterwards
+				const uint8 Emission = Channel == BlockChannel ? Registry.GetLightEmission(Chunk->GetBlock(Local.X, Local.Y, Local.Z)) : 0;
+
+				WriteLevel(*Chunk, Local, Channel, Emission);
+				Queue.Add({ Neighbour, Level });
+
+				if (Emission > 0)
+				{
+					AddQueue.Add(Neighbour);
+				}
+			}
+			else
+			{
+				// lit from somewhere else, that light flows back into the cleared cells
+				AddQueue.Add(Neighbour);
+			}
+		}
+	}
+
+	Queue.Reset();
+}
+
+void FVoxelLighting::RunAdd(int32 Channel)
+{
+	TVoxelArenaQueue<FIntVector>& Queue = AddQueues[Channel];
+
+	for (int32 Head = 0; Head < Queue.Num(); ++Head)
+	{
+		const FIntVector Block = Queue[Head];
+
+		FIntVector Local;
+		const FVoxelChunk* Chunk = FindCell(Block, Local);
+
+		if (Chunk == nullptr)
+		{
+			continue;
+		}
+
+		const uint8 Level = ReadLevel(*Chunk, Local, Channel);
+
+		if (Level <= 1)
+		{
+			continue;
+		}
+
+		for (int32 Direction = 0; Direction < UE_ARRAY_COUNT(NeighbourOffsets); ++Direction)
+		{
+			const FIntVector Neighbour = Block + NeighbourOffsets[Direction];
+
+			FIntVector NeighbourLocal;
+			FVoxelChunk* NeighbourChunk = FindCell(Neighbour, NeighbourLocal);
+
+			if (NeighbourChunk == nullptr || Registry.IsOpaque(NeighbourChunk->GetBlock(NeighbourLocal.X, NeighbourLocal.Y, NeighbourLocal.Z)))
+			{
+				continue;
+			}
+
+			const bool bSunlightBelow = Channel == SkyChannel && Direction == DownIndex && Level == MaxLight;
+			const uint8 NewLevel = bSunlightBelow ? MaxLight : Level - 1;
+
+			if (ReadLevel(*NeighbourChunk, NeighbourLocal, Channel) < NewLevel)
+			{
+				WriteLevel(*NeighbourChunk, NeighbourLocal, Channel, NewLevel);
+				Queue.Add(Neighbour);
+			}
+		}
+	}
+
+	Queue.Reset();
+}
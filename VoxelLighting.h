@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelPool.h"
+
+class FBlockRegistry;
+struct FVoxelChunk;
+
+// Sky light and block light of the voxel world, 0 to MaxLight per cell and stored in the chunks
+// next to their blocks. Sky light falls undimmed straight down from the top of the world, block
+// light starts at emitting blocks, and both lose one level per step in every other direction and
+// stop at opaque blocks. Block edits don't relight their chunk: they are queued and a batch of them
+// is applied with flood fills that only visit the cells the edits can reach, across chunk borders.
+// Bulk edits relight each chunk they touched once instead. Touches no engine objects, so a batch
+// can run off the game thread as long as nothing else touches the chunks' light meanwhile.
+class MCUE_API FVoxelLighting
+{
+public:
+	static constexpr uint8 MaxLight = 15;
+
+	// loaded chunk at the coordinate, null if there is none. Light doesn't spread into missing chunks.
+	typedef TFunctionRef<FVoxelChunk*(const FIntPoint&)> FFindChunk;
+
+	explicit FVoxelLighting(const FBlockRegistry& InRegistry);
+
+	// lights a chunk from scratch on its own, without any light coming in from its neighbours.
+	// For chunks that were just generated or loaded, AddChunk then connects them to the world.
+	static void LightChunk(FVoxelChunk& Chunk, const FBlockRegistry& BlockRegistry);
+
+	// queues the light changes of a block that went from OldBlockType to NewBlockType. The chunk
+	// has to hold the new block by the time the batch runs.
+	void AddBlockChange(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType);
+
+	// queues light flowing between a chunk added to the world and the loaded chunks around it
+	void AddChunk(const FIntPoint& ChunkCoord);
+
+	// queues a chunk whose blocks changed wholesale, cheaper to light from scratch than block by
+	// block. The batch clears the light it passed into its neighbours, relights it with LightChunk
+	// and connects it to them like an added chunk.
+	void AddEditedChunk(const FIntPoint& ChunkCoord);
+
+	bool HasPendingUpdates() const { return BlockChanges.Num() > 0 || AddedChunks.Num() > 0 || EditedChunks.Num() > 0; }
+
+	int32 GetNumPendingUpdates() const { return BlockChanges.Num() + AddedChunks.Num() + EditedChunks.Num(); }
+
+	// applies every queued change as one batch and returns how many cells changed light
+	int32 Update(FFindChunk FindChunk);
+
+	// chunks whose meshes show light that changed since the last call, then forgets them
+	TSet<FIntPoint> ConsumeChangedChunks();
+
+private:
+	enum EChannel
+	{
+		SkyChannel,
+		BlockChannel,
+		NumChannels
+	};
+
+	struct FBlockChange
+	{
+		FIntVector Block;
+		uint16 OldBlockType;
+		uint16 NewBlockType;
+	};
+
+	// a cell that was cleared and the light it had, the light it passed on is cleared next
+	struct FRemovalNode
+	{
+		FIntVector Block;
+		uint8 Level;
+	};
+
+	// the chunk holding the block and the block's position in it, null outside the loaded world
+	FVoxelChunk* FindCell(const FIntVector& Block, FIntVector& OutLocal);
+
+	static uint8 ReadLevel(const FVoxelChunk& Chunk, const FIntVector& Local, int32 Channel);
+	void WriteLevel(FVoxelChunk& Chunk, const FIntVector& Local, int32 Channel, uint8 Level);
+
+	void SeedBlockChange(const FBlockChange& Change);
+	void SeedChunkBorders(const FIntPoint& ChunkCoord);
+
+	// queues the removal of light in the neighbours' border cells that came from the chunk, read
+	// before it is relit
+	void SeedChunkRemoval(const FIntPoint& ChunkCoord);
+
+	// clears light that lost its source, queueing the cells that border brighter light
+	void RunRemoval(int32 Channel);
+
+	// spreads light out from the queued cells
+	void RunAdd(int32 Channel);
+
+	const FBlockRegistry& Registry;
+
+	TArray<FBlockChange> BlockChanges;
+	TArray<FIntPoint> AddedChunks;
+	TArray<FIntPoint> EditedChunks;
+
+	// holds the queues, lives as long as the lighting does
+	FVoxelArena Scratch;
+
+	// kept between batches so their pages are reused
+	TVoxelArenaQueue<FRemovalNode> RemovalQueues[NumChannels];
+	TVoxelArenaQueue<FIntVector> AddQueues[NumChannels];
+
+	// only set while a batch runs
+	const FFindChunk* FindChunkFunc;
+
+	// last chunk FindCell looked up, cells next to each other are mostly in the same chunk
+	FIntPoint CachedCoord;
+	FVoxelChunk* CachedChunk;
+	bool bHasCachedChunk;
+
+	// last chunk WriteLevel added to ChangedChunks
+	const FVoxelChunk* LastChangedChunk;
+
+	// off while a lone chunk is lit, nothing is meshed from it yet
+	bool bTrackChangedChunks;
+
+	TSet<FIntPoint> ChangedChunks;
+
+	int32 NumChangedCells;
+};
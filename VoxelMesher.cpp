@@ -0,0 +1,344 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelMesher.h"
+#include "BlockRegistry.h"
+#include "VoxelChunk.h"
+#include "VoxelPool.h"
+#include "VoxelVisibility.h"
+
+namespace
+{
+	// true if the face of Block towards Neighbour can be seen. Fluid shows no faces towards other levels of the same fluid.
+	FORCEINLINE bool IsFaceVisible(const FBlockRegistry& Registry, uint16 Block, uint16 Neighbour)
+	{
+		return Block != FVoxelChunk::Air && Block != Neighbour && !Registry.IsOpaque(Neighbour)
+			&& (!Registry.IsFluid(Block) || Registry.GetFluidSource(Block) != Registry.GetFluidSource(Neighbour));
+	}
+
+	// the column holding a cell in chunk space, moving x and y into it when they leave the chunk
+	const FVoxelChunk* FindColumn(const FVoxelChunk& Chunk, const FVoxelChunkNeighbours& Neighbours, int32& X, int32& Y)
+	{
+		const FVoxelChunk* Source = &Chunk;
+
+		if (X < 0)
+		{
+			Source = Neighbours.NegX;
+			X += FVoxelChunk::SizeX;
+		}
+		else if (X >= FVoxelChunk::SizeX)
+		{
+			Source = Neighbours.PosX;
+			X -= FVoxelChunk::SizeX;
+		}
+		else if (Y < 0)
+		{
+			Source = Neighbours.NegY;
+			Y += FVoxelChunk::SizeY;
+		}
+		else if (Y >= FVoxelChunk::SizeY)
+		{
+			Source = Neighbours.PosY;
+			Y -= FVoxelChunk::SizeY;
+		}
+
+		return Source;
+	}
+
+	// reads a block in chunk space, stepping into the neighbouring column when x or y leave the chunk
+	uint16 SampleBlock(const FVoxelChunk& Chunk, const FVoxelChunkNeighbours& Neighbours, int32 X, int32 Y, int32 Z)
+	{
+		if ((uint32)Z >= (uint32)FVoxelChunk::SizeZ)
+		{
+			return FVoxelChunk::Air;
+		}
+
+		const FVoxelChunk* Source = FindColumn(Chunk, Neighbours, X, Y);
+
+		return Source != nullptr ? Source->GetBlock(X, Y, Z) : FVoxelChunk::Air;
+	}
+
+	// light of a cell in chunk space, open sky above the world and where a neighbour is missing
+	uint8 SampleLight(const FVoxelChunk& Chunk, const FVoxelChunkNeighbours& Neighbours, int32 X, int32 Y, int32 Z)
+	{
+		if (Z < 0)
+		{
+			return 0;
+		}
+
+		if (Z >= FVoxelChunk::SizeZ)
+		{
+			return FVoxelChunk::OpenSkyLight;
+		}
+
+		const FVoxelChunk* Source = FindColumn(Chunk, Neighbours, X, Y);
+
+		return Source != nullptr ? Source->GetLight(X, Y, Z) : FVoxelChunk::OpenSkyLight;
+	}
+
+	FColor LightToColor(uint8 Light)
+	{
+		return FColor((Light >> 4) * 17, (Light & 15) * 17, 0, 255);
+	}
+
+	FVoxelMeshSection& FindOrAddSection(FVoxelChunkMesh& Mesh, uint16 BlockType, int32 ChunkSection)
+	{
+		// a chunk only ever holds a handful of block types, a linear search beats hashing here
+		for (FVoxelMeshSection& Section : Mesh.Sections)
+		{
+			if (Section.BlockType == BlockType && Section.ChunkSection == ChunkSection)
+			{
+				return Section;
+			}
+		}
+
+		if (Mesh.SpareSections.Num() == 0)
+		{
+			return Mesh.Sections.Emplace_GetRef(BlockType, ChunkSection);
+		}
+
+		// an emptied section of an earlier build still has its buffers
+		FVoxelMeshSection& Section = Mesh.Sections.Emplace_GetRef(Mesh.SpareSections.Pop(false));
+		Section.BlockType = BlockType;
+		Section.ChunkSection = ChunkSection;
+		return Section;
+	}
+
+	FVector AxisVector(int32 Axis, float Length)
+	{
+		FVector Result(0.f);
+		Result[Axis] = Length;
+		return Result;
+	}
+
+	// adds a Width x Height quad spanned by DeltaU and DeltaV. The engine culls faces wound
+	// counter clockwise, so the order flips with the side the face is looking at.
+	void AddQuad(FVoxelMeshSection& Section, const FVector& Origin, const FVector& DeltaU, const FVector& DeltaV, const FVector& Normal, bool bFacesPositive, int32 Width, int32 Height, uint8 Light)
+	{
+		const int32 Base = Section.Vertices.Num();
+
+		Section.Vertices.Add(Origin);
+		Section.Vertices.Add(Origin + DeltaU);
+		Section.Vertices.Add(Origin + DeltaU + DeltaV);
+		Section.Vertices.Add(Origin + DeltaV);
+
+		Section.Normals.Add(Normal);
+		Section.Normals.Add(Normal);
+		Section.Normals.Add(Normal);
+		Section.Normals.Add(Normal);
+
+		// uvs count blocks so textures tile once per block across merged quads
+		Section.UVs.Add(FVector2D(0.f, 0.f));
+		Section.UVs.Add(FVector2D(Width, 0.f));
+		Section.UVs.Add(FVector2D(Width, Height));
+		Section.UVs.Add(FVector2D(0.f, Height));
+
+		const FColor Color = LightToColor(Light);
+		Section.Colors.Add(Color);
+		Section.Colors.Add(Color);
+		Section.Colors.Add(Color);
+		Section.Colors.Add(Color);
+
+		if (bFacesPositive)
+		{
+			Section.Triangles.Append({ Base, Base + 2, Base + 1, Base, Base + 3, Base + 2 });
+		}
+		else
+		{
+			Section.Triangles.Append({ Base, Base + 1, Base + 2, Base, Base + 2, Base + 3 });
+		}
+	}
+}
+
+int32 FVoxelChunkMesh::GetNumTriangles() const
+{
+	int32 NumTriangles = 0;
+
+	for (const FVoxelMeshSection& Section : Sections)
+	{
+		NumTriangles += Section.GetNumTriangles();
+	}
+
+	return NumTriangles;
+}
+
+void FVoxelChunkMesh::Reset()
+{
+	for (FVoxelMeshSection& Section : Sections)
+	{
+		Section.Reset();
+		SpareSections.Add(MoveTemp(Section));
+	}
+
+	Sections.Reset();
+}
+
+void FVoxelMesher::BuildChunkMesh(const FVoxelChunk& Chunk, const FVoxelChunkNeighbours& Neighbours, const FBlockRegistry& Registry, float BlockSize, FVoxelChunkMesh& OutMesh)
+{
+	OutMesh.Reset();
+
+	if (Chunk.IsEmpty())
+	{
+		for (uint16& Connections : OutMesh.SectionConnections)
+		{
+			Connections = FVoxelVisibility::AllConnected;
+		}
+
+		return;
+	}
+
+	for (int32 SectionIndex = 0; SectionIndex < FVoxelChunk::NumSections; ++SectionIndex)
+	{
+		OutMesh.SectionConnections[SectionIndex] = FVoxelVisibility::ComputeSectionConnections(Chunk, SectionIndex, Registry);
+	}
+
+	constexpr int32 SectionSize = FVoxelSection::Size;
+
+	const int32 Dims[3] = { FVoxelChunk::SizeX, FVoxelChunk::SizeY, FVoxelChunk::SizeZ };
+
+	// the tallest slices stand upright, one side of the chunk by its full height
+	constexpr int32 MaxSliceCells = FVoxelChunk::SizeX * FVoxelChunk::SizeZ;
+	static_assert(FVoxelChunk::SizeX == FVoxelChunk::SizeY, "slices along x and y are the same size");
+
+	// the masks only live while this chunk is meshed
+	FVoxelArena Arena;
+
+	// block type per face of the current slice, one mask for faces looking along +Axis and one
+	// for faces looking along -Axis. Both can be set where two see-through blocks meet.
+	uint16* Masks[2] = { Arena.AllocateArray<uint16>(MaxSliceCells), Arena.AllocateArray<uint16>(MaxSliceCells) };
+
+	// light of the cell each masked face looks into, faces only merge when it matches too
+	uint8* LightMasks[2] = { Arena.AllocateArray<uint8>(MaxSliceCells), Arena.AllocateArray<uint8>(MaxSliceCells) };
+
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		const int32 U = (Axis + 1) % 3;
+		const int32 V = (Axis + 2) % 3;
+
+		int32 Step[3] = { 0, 0, 0 };
+		Step[Axis] = 1;
+
+		// every slice is the plane between layer Slice - 1 and layer Slice along Axis
+		for (int32 Slice = 0; Slice <= Dims[Axis]; ++Slice)
+		{
+			// faces on the border that belong to a neighbouring column are meshed by that column
+			const bool bOwnsBack = Slice > 0;
+			const bool bOwnsFront = Slice < Dims[Axis];
+
+			int32 Cell[3];
+			Cell[Axis] = Slice;
+
+			int32 MaskIndex = 0;
+
+			for (Cell[V] = 0; Cell[V] < Dims[V]; ++Cell[V])
+			{
+				for (Cell[U] = 0; Cell[U] < Dims[U]; ++Cell[U])
+				{
+					const uint16 Back = SampleBlock(Chunk, Neighbours, Cell[0] - Step[0], Cell[1] - Step[1], Cell[2] - Step[2]);
+					const uint16 Front = SampleBlock(Chunk, Neighbours, Cell[0], Cell[1], Cell[2]);
+
+					Masks[0][MaskIndex] = bOwnsBack && IsFaceVisible(Registry, Back, Front) ? Back : FVoxelChunk::Air;
+					Masks[1][MaskIndex] = bOwnsFront && IsFaceVisible(Registry, Front, Back) ? Front : FVoxelChunk::Air;
+
+					// a face is lit by the see-through cell it looks into
+					if (Masks[0][MaskIndex] != FVoxelChunk::Air)
+					{
+						LightMasks[0][MaskIndex] = SampleLight(Chunk, Neighbours, Cell[0], Cell[1], Cell[2]);
+					}
+
+					if (Masks[1][MaskIndex] != FVoxelChunk::Air)
+					{
+						LightMasks[1][MaskIndex] = SampleLight(Chunk, Neighbours, Cell[0] - Step[0], Cell[1] - Step[1], Cell[2] - Step[2]);
+					}
+
+					++MaskIndex;
+				}
+			}
+
+			for (int32 Side = 0; Side < 2; ++Side)
+			{
+				uint16* Mask = Masks[Side];
+				const uint8* LightMask = LightMasks[Side];
+				const bool bFacesPositive = Side == 0;
+
+				// grow each face as wide and then as tall as the mask allows and emit one quad for it
+				MaskIndex = 0;
+
+				for (int32 J = 0; J < Dims[V]; ++J)
+				{
+					for (int32 I = 0; I < Dims[U];)
+					{
+						const uint16 BlockType = Mask[MaskIndex];
+
+						if (BlockType == FVoxelChunk::Air)
+						{
+							++I;
+							++MaskIndex;
+							continue;
+						}
+
+						const uint8 Light = LightMask[MaskIndex];
+
+						// quads stop at section borders so every one belongs to a single section
+						const int32 MaxWidth = U == 2 ? SectionSize - I % SectionSize : Dims[U] - I;
+						const int32 MaxHeight = V == 2 ? SectionSize - J % SectionSize : Dims[V] - J;
+
+						int32 Width = 1;
+						while (Width < MaxWidth && Mask[MaskIndex + Width] == BlockType && LightMask[MaskIndex + Width] == Light)
+						{
+							++Width;
+						}
+
+						int32 Height = 1;
+						for (; Height < MaxHeight; ++Height)
+						{
+							const int32 Row = MaskIndex + Height * Dims[U];
+
+							int32 K = 0;
+							while (K < Width && Mask[Row + K] == BlockType && LightMask[Row + K] == Light)
+							{
+								++K;
+							}
+
+							if (K < Width)
+							{
+								break;
+							}
+						}
+
+						FVector Origin(0.f);
+						Origin[Axis] = Slice * BlockSize;
+						Origin[U] = I * BlockSize;
+						Origin[V] = J * BlockSize;
+
+						// the section of the block the face is drawn on
+						const int32 Z = Axis == 2 ? (bFacesPositive ? Slice - 1 : Slice) : (U == 2 ? I : J);
+
+						AddQuad(FindOrAddSection(OutMesh, BlockType, Z / SectionSize), Origin, AxisVector(U, Width * BlockSize), AxisVector(V, Height * BlockSize),
+							AxisVector(Axis, bFacesPositive ? 1.f : -1.f), bFacesPositive, Width, Height, Light);
+
+						for (int32 H = 0; H < Height; ++H)
+						{
+							FMemory::Memzero(&Mask[MaskIndex + H * Dims[U]], Width * sizeof(uint16));
+						}
+
+						I += Width;
+						MaskIndex += Width;
+					}
+				}
+			}
+		}
+	}
+}
+
+bool FVoxelMesher::IsBlockExposed(const FVoxelChunk& Chunk, const FVoxelChunkNeighbours& Neighbours, const FBlockRegistry& Registry, int32 X, int32 Y, int32 Z)
+{
+	const uint16 Block = Chunk.GetBlock(X, Y, Z);
+
+	return IsFaceVisible(Registry, Block, SampleBlock(Chunk, Neighbours, X + 1, Y, Z))
+		|| IsFaceVisible(Registry, Block, SampleBlock(Chunk, Neighbours, X - 1, Y, Z))
+		|| IsFaceVisible(Registry, Block, SampleBlock(Chunk, Neighbours, X, Y + 1, Z))
+		|| IsFaceVisible(Registry, Block, SampleBlock(Chunk, Neighbours, X, Y - 1, Z))
+		|| IsFaceVisible(Registry, Block, SampleBlock(Chunk, Neighbours, X, Y, Z + 1))
+		|| IsFaceVisible(Registry, Block, SampleBlock(Chunk, Neighbours, X, Y, Z - 1));
+}
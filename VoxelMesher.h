@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelChunk.h"
+
+class FBlockRegistry;
+
+// geometry of every visible face of one block type in a chunk
+struct MCUE_API FVoxelMeshSection
+{
+	uint16 BlockType;
+
+	// the 16 block tall chunk section the faces belong to, so they can be hidden along with it
+	int32 ChunkSection;
+
+	TArray<FVector> Vertices;
+	TArray<int32> Triangles;
+	TArray<FVector> Normals;
+	TArray<FVector2D> UVs;
+
+	// light in front of each face, sky light in red and block light in green scaled to 0-255, so the
+	// material can dim the sky with the time of day
+	TArray<FColor> Colors;
+
+	FVoxelMeshSection(uint16 InBlockType, int32 InChunkSection) : BlockType(InBlockType), ChunkSection(InChunkSection) {}
+
+	int32 GetNumTriangles() const { return Triangles.Num() / 3; }
+
+	// empties the buffers but keeps their memory
+	void Reset()
+	{
+		Vertices.Reset();
+		Triangles.Reset();
+		Normals.Reset();
+		UVs.Reset();
+		Colors.Reset();
+	}
+};
+
+// the meshed chunk, one section per block type and chunk section so each keeps its own material
+// and can be culled on its own. Meshing into the same mesh again reuses the buffers of the last build.
+struct MCUE_API FVoxelChunkMesh
+{
+	TArray<FVoxelMeshSection> Sections;
+
+	// which faces of each chunk section see each other, see FVoxelVisibility
+	uint16 SectionConnections[FVoxelChunk::NumSections];
+
+	// emptied sections of earlier builds, handed out again before new ones are made
+	TArray<FVoxelMeshSection> SpareSections;
+
+	int32 GetNumTriangles() const;
+
+	// empties the mesh, its sections become spares
+	void Reset();
+};
+
+// the columns around a chunk, used to cull faces on its border. Missing neighbours count as air.
+struct FVoxelChunkNeighbours
+{
+	const FVoxelChunk* PosX = nullptr;
+	const FVoxelChunk* NegX = nullptr;
+	const FVoxelChunk* PosY = nullptr;
+	const FVoxelChunk* NegY = nullptr;
+};
+
+// Builds chunk geometry on the CPU. A block face is only emitted if the neighbour in front of
+// it is see-through and of a different type, and coplanar faces of the same block type and
+// light are merged into larger quads (greedy meshing), but never across the border of two chunk sections.
+// Touches no engine objects so it can run headless or off the game thread.
+class MCUE_API FVoxelMesher
+{
+public:
+	// vertices are in chunk space, the chunk's minimum corner is the origin
+	static void BuildChunkMesh(const FVoxelChunk& Chunk, const FVoxelChunkNeighbours& Neighbours, const FBlockRegistry& Registry, float BlockSize, FVoxelChunkMesh& OutMesh);
+
+	// true if BuildChunkMesh would emit at least one face of the block at the cell in chunk space
+	static bool IsBlockExposed(const FVoxelChunk& Chunk, const FVoxelChunkNeighbours& Neighbours, const FBlockRegistry& Registry, int32 X, int32 Y, int32 Z);
+};
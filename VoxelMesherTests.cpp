@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelMesher.h"
+#include "BlockRegistry.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// air and one opaque block type, id 1
+	FBlockRegistry MakeMesherTestRegistry()
+	{
+		TArray<FVoxelBlockType> Types;
+		Types.AddDefaulted(2);
+		Types[1].Name = TEXT("Stone");
+
+		FBlockRegistry Registry;
+		Registry.Build(Types);
+		return Registry;
+	}
+
+	// meshes the chunk on its own, every face on its border counts as exposed
+	int32 CountTriangles(const FVoxelChunk& Chunk)
+	{
+		const FBlockRegistry Registry = MakeMesherTestRegistry();
+
+		FVoxelChunkMesh Mesh;
+		FVoxelMesher::BuildChunkMesh(Chunk, FVoxelChunkNeighbours(), Registry, 100.f, Mesh);
+		return Mesh.GetNumTriangles();
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelMesherIsolatedBlockTest, "MCUE.Voxel.Mesher.IsolatedBlock", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelMesherIsolatedBlockTest::RunTest(const FString& Parameters)
+{
+	FVoxelChunk Chunk(FIntPoint::ZeroValue);
+	Chunk.SetBlock(3, 4, 5, 1);
+
+	TestEqual(TEXT("a block on its own shows all six faces"), CountTriangles(Chunk), 12);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelMesherSlabTest, "MCUE.Voxel.Mesher.Slab", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelMesherSlabTest::RunTest(const FString& Parameters)
+{
+	FVoxelChunk Chunk(FIntPoint::ZeroValue);
+
+	for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+	{
+		for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+		{
+			Chunk.SetBlock(X, Y, 0, 1);
+		}
+	}
+
+	TestEqual(TEXT("a full 16x16x1 slab merges into one quad per side"), CountTriangles(Chunk), 12);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelMesherCheckerboardTest, "MCUE.Voxel.Mesher.Checkerboard", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelMesherCheckerboardTest::RunTest(const FString& Parameters)
+{
+	FVoxelChunk Chunk(FIntPoint::ZeroValue);
+	int32 NumBlocks = 0;
+
+	// no two blocks share a face, so there is nothing to cull and nothing to merge
+	for (int32 Z = 0; Z < FVoxelSection::Size; ++Z)
+	{
+		for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+		{
+			for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+			{
+				if ((X + Y + Z) % 2 == 0)
+				{
+					Chunk.SetBlock(X, Y, Z, 1);
+					++NumBlocks;
+				}
+			}
+		}
+	}
+
+	TestEqual(TEXT("a 3D checkerboard keeps every face of every block"), CountTriangles(Chunk), NumBlocks * 12);
+	return true;
+}
+
+#endif
@@ -0,0 +1,465 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelNoise.h"
+
+// fast-math lets the compiler reorder the float math of either path on its own
+#if defined(__FAST_MATH__) || defined(_M_FP_FAST)
+	#error "VoxelNoise.cpp has to be built without fast-math, the scalar and vector noise paths would round differently"
+#endif
+
+// a product and a sum contracted into a fused multiply-add skip a rounding, wherever the compiler finds one
+#if defined(__clang__)
+	#pragma clang fp contract(off)
+#elif defined(_MSC_VER)
+	#pragma fp_contract(off)
+#elif defined(__GNUC__)
+	#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace
+{
+	// lanes per VectorRegister
+	constexpr int32 NumLanes = 4;
+
+	// moves every octave off the lattice of the one before so they don't all reach zero at the same points
+	constexpr float OctaveOffset = 17.31f;
+
+	const float Gradients2D[8][2] =
+	{
+		{ 1.f, 1.f }, { -1.f, 1.f }, { 1.f, -1.f }, { -1.f, -1.f },
+		{ 1.f, 0.f }, { -1.f, 0.f }, { 0.f, 1.f }, { 0.f, -1.f }
+	};
+
+	// the 12 cube edge directions, four of them repeated so the hash can be masked instead of divided
+	const float Gradients3D[16][3] =
+	{
+		{ 1.f, 1.f, 0.f }, { -1.f, 1.f, 0.f }, { 1.f, -1.f, 0.f }, { -1.f, -1.f, 0.f },
+		{ 1.f, 0.f, 1.f }, { -1.f, 0.f, 1.f }, { 1.f, 0.f, -1.f }, { -1.f, 0.f, -1.f },
+		{ 0.f, 1.f, 1.f }, { 0.f, -1.f, 1.f }, { 0.f, 1.f, -1.f }, { 0.f, -1.f, -1.f },
+		{ 1.f, 1.f, 0.f }, { -1.f, 1.f, 0.f }, { 0.f, -1.f, 1.f }, { 0.f, -1.f, -1.f }
+	};
+
+	// The helpers below come in a float and a VectorRegister flavour that must stay operation for
+	// operation the same. Every product and sum is its own statement, so nothing reorders them.
+
+	FORCEINLINE float GridCoord(float Origin, int32 Index, float Step)
+	{
+		const float Offset = Index * Step;
+		return Origin + Offset;
+	}
+
+	// integer cell and position inside it
+	FORCEINLINE void Lattice(float Coord, int32& OutCell, float& OutFraction)
+	{
+		const float Floor = FMath::FloorToFloat(Coord);
+		OutCell = (int32)Floor;
+		OutFraction = Coord - Floor;
+	}
+
+	// 6t^5 - 15t^4 + 10t^3
+	FORCEINLINE float Fade(float T)
+	{
+		const float A = T * 6.f;
+		const float B = A - 15.f;
+		const float C = T * B;
+		const float D = C + 10.f;
+		const float T2 = T * T;
+		const float T3 = T2 * T;
+		return T3 * D;
+	}
+
+	FORCEINLINE VectorRegister Fade(const VectorRegister& T)
+	{
+		const VectorRegister A = VectorMultiply(T, VectorSetFloat1(6.f));
+		const VectorRegister B = VectorSubtract(A, VectorSetFloat1(15.f));
+		const VectorRegister C = VectorMultiply(T, B);
+		const VectorRegister D = VectorAdd(C, VectorSetFloat1(10.f));
+		const VectorRegister T2 = VectorMultiply(T, T);
+		const VectorRegister T3 = VectorMultiply(T2, T);
+		return VectorMultiply(T3, D);
+	}
+
+	FORCEINLINE float Lerp(float A, float B, float Alpha)
+	{
+		const float Delta = B - A;
+		const float Scaled = Alpha * Delta;
+		return A + Scaled;
+	}
+
+	FORCEINLINE VectorRegister Lerp(const VectorRegister& A, const VectorRegister& B, const VectorRegister& Alpha)
+	{
+		const VectorRegister Delta = VectorSubtract(B, A);
+		const VectorRegister Scaled = VectorMultiply(Alpha, Delta);
+		return VectorAdd(A, Scaled);
+	}
+
+	FORCEINLINE float Dot(float Gx, float Gy, float X, float Y)
+	{
+		const float Px = Gx * X;
+		const float Py = Gy * Y;
+		return Px + Py;
+	}
+
+	FORCEINLINE VectorRegister Dot(const VectorRegister& Gx, const VectorRegister& Gy, const VectorRegister& X, const VectorRegister& Y)
+	{
+		const VectorRegister Px = VectorMultiply(Gx, X);
+		const VectorRegister Py = VectorMultiply(Gy, Y);
+		return VectorAdd(Px, Py);
+	}
+
+	FORCEINLINE float Dot(float Gx, float Gy, float Gz, float X, float Y, float Z)
+	{
+		const float Pxy = Dot(Gx, Gy, X, Y);
+		const float Pz = Gz * Z;
+		return Pxy + Pz;
+	}
+
+	FORCEINLINE VectorRegister Dot(const VectorRegister& Gx, const VectorRegister& Gy, const VectorRegister& Gz, const VectorRegister& X, const VectorRegister& Y, const VectorRegister& Z)
+	{
+		const VectorRegister Pxy = Dot(Gx, Gy, X, Y);
+		const VectorRegister Pz = VectorMultiply(Gz, Z);
+		return VectorAdd(Pxy, Pz);
+	}
+
+	// Out += Octave * Amplitude
+	void AccumulateOctave(float* Out, const float* Octave, float Amplitude, int32 NumSamples, EVoxelNoisePath Path)
+	{
+		int32 Index = 0;
+
+		if (Path == EVoxelNoisePath::Simd)
+		{
+			const VectorRegister VectorAmplitude = VectorSetFloat1(Amplitude);
+
+			for (; Index + NumLanes <= NumSamples; Index += NumLanes)
+			{
+				const VectorRegister Scaled = VectorMultiply(VectorLoad(Octave + Index), VectorAmplitude);
+				VectorStore(VectorAdd(VectorLoad(Out + Index), Scaled), Out + Index);
+			}
+		}
+
+		for (; Index < NumSamples; ++Index)
+		{
+			const float Scaled = Octave[Index] * Amplitude;
+			Out[Index] = Out[Index] + Scaled;
+		}
+	}
+}
+
+FVoxelNoise::FVoxelNoise(int32 Seed)
+{
+	for (int32 Index = 0; Index < 256; ++Index)
+	{
+		Perm[Index] = (uint8)Index;
+	}
+
+	// integer only shuffle (xorshift), so a seed gives the same table on every platform
+	uint32 State = ((uint32)Seed * 747796405u + 2891336453u) | 1u;
+
+	for (int32 Index = 255; Index > 0; --Index)
+	{
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+
+		Swap(Perm[Index], Perm[State % (uint32)(Index + 1)]);
+	}
+
+	FMemory::Memcpy(Perm + 256, Perm, 256);
+}
+
+bool FVoxelNoise::IsSimdSupported()
+{
+	// without vector intrinsics VectorRegister is emulated on the FPU, which still gives identical results
+	return PLATFORM_ENABLE_VECTORINTRINSICS != 0;
+}
+
+float FVoxelNoise::Sample2D(float X, float Y) const
+{
+	int32 X0, Y0;
+	float Tx, Ty;
+	Lattice(X, X0, Tx);
+	Lattice(Y, Y0, Ty);
+
+	const float Tx1 = Tx - 1.f;
+	const float Ty1 = Ty - 1.f;
+
+	const float* G00 = Gradients2D[Hash2D(X0, Y0) & 7];
+	const float* G10 = Gradients2D[Hash2D(X0 + 1, Y0) & 7];
+	const float* G01 = Gradients2D[Hash2D(X0, Y0 + 1) & 7];
+	const float* G11 = Gradients2D[Hash2D(X0 + 1, Y0 + 1) & 7];
+
+	const float N00 = Dot(G00[0], G00[1], Tx, Ty);
+	const float N10 = Dot(G10[0], G10[1], Tx1, Ty);
+	const float N01 = Dot(G01[0], G01[1], Tx, Ty1);
+	const float N11 = Dot(G11[0], G11[1], Tx1, Ty1);
+
+	const float U = Fade(Tx);
+	const float V = Fade(Ty);
+
+	return Lerp(Lerp(N00, N10, U), Lerp(N01, N11, U), V);
+}
+
+float FVoxelNoise::Sample3D(float X, float Y, float Z) const
+{
+	int32 Cell[3];
+	float T[3];
+	Lattice(X, Cell[0], T[0]);
+	Lattice(Y, Cell[1], T[1]);
+	Lattice(Z, Cell[2], T[2]);
+
+	const float T1[3] = { T[0] - 1.f, T[1] - 1.f, T[2] - 1.f };
+
+	// corner bit 0 steps along x, bit 1 along y and bit 2 along z
+	float N[8];
+
+	for (int32 Corner = 0; Corner < 8; ++Corner)
+	{
+		const int32 Dx = Corner & 1;
+		const int32 Dy = (Corner >> 1) & 1;
+		const int32 Dz = Corner >> 2;
+
+		const float* G = Gradients3D[Hash3D(Cell[0] + Dx, Cell[1] + Dy, Cell[2] + Dz) & 15];
+
+		N[Corner] = Dot(G[0], G[1], G[2], Dx ? T1[0] : T[0], Dy ? T1[1] : T[1], Dz ? T1[2] : T[2]);
+	}
+
+	const float U = Fade(T[0]);
+	const float V = Fade(T[1]);
+	const float W = Fade(T[2]);
+
+	const float Y0 = Lerp(Lerp(N[0], N[1], U), Lerp(N[2], N[3], U), V);
+	const float Y1 = Lerp(Lerp(N[4], N[5], U), Lerp(N[6], N[7], U), V);
+
+	return Lerp(Y0, Y1, W);
+}
+
+void FVoxelNoise::Grid2D(float OriginX, float OriginY, float Step, int32 SizeX, int32 SizeY, float* Out, EVoxelNoisePath Path) const
+{
+	for (int32 Y = 0; Y < SizeY; ++Y)
+	{
+		const float SampleY = GridCoord(OriginY, Y, Step);
+		float* Row = Out + Y * SizeX;
+
+		if (Path == EVoxelNoisePath::Simd)
+		{
+			GridRow2DSimd(OriginX, SampleY, Step, SizeX, Row);
+			continue;
+		}
+
+		for (int32 X = 0; X < SizeX; ++X)
+		{
+			Row[X] = Sample2D(GridCoord(OriginX, X, Step), SampleY);
+		}
+	}
+}
+
+void FVoxelNoise::Grid3D(const FVector& Origin, float Step, int32 SizeX, int32 SizeY, int32 SizeZ, float* Out, EVoxelNoisePath Path) const
+{
+	for (int32 Z = 0; Z < SizeZ; ++Z)
+	{
+		const float SampleZ = GridCoord(Origin.Z, Z, Step);
+
+		for (int32 Y = 0; Y < SizeY; ++Y)
+		{
+			const float SampleY = GridCoord(Origin.Y, Y, Step);
+			float* Row = Out + SizeX * (Y + SizeY * Z);
+
+			if (Path == EVoxelNoisePath::Simd)
+			{
+				GridRow3DSimd(Origin.X, SampleY, SampleZ, Step, SizeX, Row);
+				continue;
+			}
+
+			for (int32 X = 0; X < SizeX; ++X)
+			{
+				Row[X] = Sample3D(GridCoord(Origin.X, X, Step), SampleY, SampleZ);
+			}
+		}
+	}
+}
+
+void FVoxelNoise::GridRow2DSimd(float OriginX, float Y, float Step, int32 SizeX, float* Out) const
+{
+	// the row shares its y lattice, only x changes from lane to lane
+	int32 Y0;
+	float Ty;
+	Lattice(Y, Y0, Ty);
+
+	const VectorRegister VectorTy = VectorSetFloat1(Ty);
+	const VectorRegister VectorTy1 = VectorSubtract(VectorTy, VectorSetFloat1(1.f));
+	const VectorRegister V = Fade(VectorTy);
+
+	// neighbouring samples mostly share a cell, so corner gradients are only looked up when the cell changes
+	int32 CachedX0 = MIN_int32;
+	const float* Corners[4];
+
+	int32 X = 0;
+
+	for (; X + NumLanes <= SizeX; X += NumLanes)
+	{
+		// gather the lattice of each lane, then blend all four at once
+		MS_ALIGN(16) float Tx[NumLanes] GCC_ALIGN(16);
+		MS_ALIGN(16) float G[4][2][NumLanes] GCC_ALIGN(16);
+
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			int32 X0;
+			Lattice(GridCoord(OriginX, X + Lane, Step), X0, Tx[Lane]);
+
+			if (X0 != CachedX0)
+			{
+				CachedX0 = X0;
+
+				for (int32 Corner = 0; Corner < 4; ++Corner)
+				{
+					Corners[Corner] = Gradients2D[Hash2D(X0 + (Corner & 1), Y0 + (Corner >> 1)) & 7];
+				}
+			}
+
+			for (int32 Corner = 0; Corner < 4; ++Corner)
+			{
+				G[Corner][0][Lane] = Corners[Corner][0];
+				G[Corner][1][Lane] = Corners[Corner][1];
+			}
+		}
+
+		const VectorRegister VectorTx = VectorLoadAligned(Tx);
+		const VectorRegister VectorTx1 = VectorSubtract(VectorTx, VectorSetFloat1(1.f));
+
+		const VectorRegister N00 = Dot(VectorLoadAligned(G[0][0]), VectorLoadAligned(G[0][1]), VectorTx, VectorTy);
+		const VectorRegister N10 = Dot(VectorLoadAligned(G[1][0]), VectorLoadAligned(G[1][1]), VectorTx1, VectorTy);
+		const VectorRegister N01 = Dot(VectorLoadAligned(G[2][0]), VectorLoadAligned(G[2][1]), VectorTx, VectorTy1);
+		const VectorRegister N11 = Dot(VectorLoadAligned(G[3][0]), VectorLoadAligned(G[3][1]), VectorTx1, VectorTy1);
+
+		const VectorRegister U = Fade(VectorTx);
+
+		VectorStore(Lerp(Lerp(N00, N10, U), Lerp(N01, N11, U), V), Out + X);
+	}
+
+	// rows that aren't a multiple of the lane count finish one sample at a time
+	for (; X < SizeX; ++X)
+	{
+		Out[X] = Sample2D(GridCoord(OriginX, X, Step), Y);
+	}
+}
+
+void FVoxelNoise::GridRow3DSimd(float OriginX, float Y, float Z, float Step, int32 SizeX, float* Out) const
+{
+	int32 Y0, Z0;
+	float Ty, Tz;
+	Lattice(Y, Y0, Ty);
+	Lattice(Z, Z0, Tz);
+
+	const VectorRegister VectorTy = VectorSetFloat1(Ty);
+	const VectorRegister VectorTz = VectorSetFloat1(Tz);
+	const VectorRegister VectorTy1 = VectorSubtract(VectorTy, VectorSetFloat1(1.f));
+	const VectorRegister VectorTz1 = VectorSubtract(VectorTz, VectorSetFloat1(1.f));
+	const VectorRegister V = Fade(VectorTy);
+	const VectorRegister W = Fade(VectorTz);
+
+	int32 CachedX0 = MIN_int32;
+	const float* Corners[8];
+
+	int32 X = 0;
+
+	for (; X + NumLanes <= SizeX; X += NumLanes)
+	{
+		MS_ALIGN(16) float Tx[NumLanes] GCC_ALIGN(16);
+		MS_ALIGN(16) float G[8][3][NumLanes] GCC_ALIGN(16);
+
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			int32 X0;
+			Lattice(GridCoord(OriginX, X + Lane, Step), X0, Tx[Lane]);
+
+			if (X0 != CachedX0)
+			{
+				CachedX0 = X0;
+
+				for (int32 Corner = 0; Corner < 8; ++Corner)
+				{
+					Corners[Corner] = Gradients3D[Hash3D(X0 + (Corner & 1), Y0 + ((Corner >> 1) & 1), Z0 + (Corner >> 2)) & 15];
+				}
+			}
+
+			for (int32 Corner = 0; Corner < 8; ++Corner)
+			{
+				G[Corner][0][Lane] = Corners[Corner][0];
+				G[Corner][1][Lane] = Corners[Corner][1];
+				G[Corner][2][Lane] = Corners[Corner][2];
+			}
+		}
+
+		const VectorRegister VectorTx = VectorLoadAligned(Tx);
+		const VectorRegister VectorTx1 = VectorSubtract(VectorTx, VectorSetFloat1(1.f));
+
+		VectorRegister N[8];
+
+		for (int32 Corner = 0; Corner < 8; ++Corner)
+		{
+			N[Corner] = Dot(VectorLoadAligned(G[Corner][0]), VectorLoadAligned(G[Corner][1]), VectorLoadAligned(G[Corner][2]),
+				Corner & 1 ? VectorTx1 : VectorTx,
+				(Corner >> 1) & 1 ? VectorTy1 : VectorTy,
+				Corner >> 2 ? VectorTz1 : VectorTz);
+		}
+
+		const VectorRegister U = Fade(VectorTx);
+
+		const VectorRegister Y0Blend = Lerp(Lerp(N[0], N[1], U), Lerp(N[2], N[3], U), V);
+		const VectorRegister Y1Blend = Lerp(Lerp(N[4], N[5], U), Lerp(N[6], N[7], U), V);
+
+		VectorStore(Lerp(Y0Blend, Y1Blend, W), Out + X);
+	}
+
+	for (; X < SizeX; ++X)
+	{
+		Out[X] = Sample3D(GridCoord(OriginX, X, Step), Y, Z);
+	}
+}
+
+void FVoxelNoise::FractalGrid2D(float OriginX, float OriginY, float Step, int32 SizeX, int32 SizeY, int32 NumOctaves, float Lacunarity, float Gain, float* Out, EVoxelNoisePath Path) const
+{
+	const int32 NumSamples = SizeX * SizeY;
+	FMemory::Memzero(Out, NumSamples * sizeof(float));
+
+	TArray<float, TInlineAllocator<16 * 16>> Octave;
+	Octave.SetNumUninitialized(NumSamples);
+
+	float Frequency = 1.f;
+	float Amplitude = 1.f;
+
+	for (int32 OctaveIndex = 0; OctaveIndex < NumOctaves; ++OctaveIndex)
+	{
+		const float Offset = OctaveIndex * OctaveOffset;
+
+		Grid2D(OriginX * Frequency + Offset, OriginY * Frequency + Offset, Step * Frequency, SizeX, SizeY, Octave.GetData(), Path);
+		AccumulateOctave(Out, Octave.GetData(), Amplitude, NumSamples, Path);
+
+		Frequency *= Lacunarity;
+		Amplitude *= Gain;
+	}
+}
+
+void FVoxelNoise::FractalGrid3D(const FVector& Origin, float Step, int32 SizeX, int32 SizeY, int32 SizeZ, int32 NumOctaves, float Lacunarity, float Gain, float* Out, EVoxelNoisePath Path) const
+{
+	const int32 NumSamples = SizeX * SizeY * SizeZ;
+	FMemory::Memzero(Out, NumSamples * sizeof(float));
+
+	TArray<float, TInlineAllocator<16 * 16 * 16>> Octave;
+	Octave.SetNumUninitialized(NumSamples);
+
+	float Frequency = 1.f;
+	float Amplitude = 1.f;
+
+	for (int32 OctaveIndex = 0; OctaveIndex < NumOctaves; ++OctaveIndex)
+	{
+		const float Offset = OctaveIndex * OctaveOffset;
+
+		Grid3D(Origin * Frequency + FVector(Offset), Step * Frequency, SizeX, SizeY, SizeZ, Octave.GetData(), Path);
+		AccumulateOctave(Out, Octave.GetData(), Amplitude, NumSamples, Path);
+
+		Frequency *= Lacunarity;
+		Amplitude *= Gain;
+	}
+}
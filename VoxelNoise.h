@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// which implementation evaluates a noise grid
+enum class EVoxelNoisePath : uint8
+{
+	// one sample at a time on the FPU
+	Scalar,
+	// four samples at a time through VectorRegister (SSE or NEON), falls back to scalar where unavailable
+	Simd
+};
+
+// Seeded gradient (Perlin) noise for terrain. Grids are evaluated in bulk, and both paths run
+// the exact same float operations in the same order, so every path and every machine produce
+// bit for bit the same world for a seed. Lattice lookups are integer only. VoxelNoise.cpp turns
+// off fused multiply-add contraction and refuses to build with fast-math, either would change
+// the rounding of one path but not the other. MCUE.Voxel.Noise tests compare the paths.
+class MCUE_API FVoxelNoise
+{
+public:
+	explicit FVoxelNoise(int32 Seed);
+
+	// single samples in roughly [-1, 1], the reference the grid paths have to match
+	float Sample2D(float X, float Y) const;
+	float Sample3D(float X, float Y, float Z) const;
+
+	// Out[X + Y * SizeX] = Sample2D(OriginX + X * Step, OriginY + Y * Step)
+	void Grid2D(float OriginX, float OriginY, float Step, int32 SizeX, int32 SizeY, float* Out, EVoxelNoisePath Path = EVoxelNoisePath::Simd) const;
+
+	// Out[X + SizeX * (Y + SizeY * Z)] = Sample3D(Origin + (X, Y, Z) * Step)
+	void Grid3D(const FVector& Origin, float Step, int32 SizeX, int32 SizeY, int32 SizeZ, float* Out, EVoxelNoisePath Path = EVoxelNoisePath::Simd) const;
+
+	// sums NumOctaves grids, each octave at Lacunarity times the frequency and Gain times the amplitude of the one before
+	void FractalGrid2D(float OriginX, float OriginY, float Step, int32 SizeX, int32 SizeY, int32 NumOctaves, float Lacunarity, float Gain, float* Out, EVoxelNoisePath Path = EVoxelNoisePath::Simd) const;
+	void FractalGrid3D(const FVector& Origin, float Step, int32 SizeX, int32 SizeY, int32 SizeZ, int32 NumOctaves, float Lacunarity, float Gain, float* Out, EVoxelNoisePath Path = EVoxelNoisePath::Simd) const;
+
+	// true if the Simd path really runs vector instructions on this platform
+	static bool IsSimdSupported();
+
+private:
+	// gradient index of a lattice corner
+	FORCEINLINE uint8 Hash2D(int32 X, int32 Y) const
+	{
+		return Perm[Perm[X & 255] + (Y & 255)];
+	}
+
+	FORCEINLINE uint8 Hash3D(int32 X, int32 Y, int32 Z) const
+	{
+		return Perm[Perm[Perm[X & 255] + (Y & 255)] + (Z & 255)];
+	}
+
+	void GridRow2DSimd(float OriginX, float Y, float Step, int32 SizeX, float* Out) const;
+	void GridRow3DSimd(float OriginX, float Y, float Z, float Step, int32 SizeX, float* Out) const;
+
+	// seeded permutation of 0..255, repeated so lookups never need to wrap
+	uint8 Perm[512];
+};
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelNoise.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr int32 NoiseTestSeed = 1234;
+
+	// grids that end in a partial vector, so the scalar tail of the vector path is covered too
+	constexpr int32 GridSizeX = 19;
+	constexpr int32 GridSizeY = 7;
+	constexpr int32 GridSizeZ = 5;
+
+	bool IsBitExact(const TArray<float>& A, const TArray<float>& B)
+	{
+		return A.Num() == B.Num() && FMemory::Memcmp(A.GetData(), B.GetData(), A.Num() * sizeof(float)) == 0;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelNoiseGrid2DTest, "MCUE.Voxel.Noise.Grid2DPathsMatch", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelNoiseGrid2DTest::RunTest(const FString& Parameters)
+{
+	const FVoxelNoise Noise(NoiseTestSeed);
+
+	TArray<float> Scalar;
+	TArray<float> Simd;
+	Scalar.SetNumUninitialized(GridSizeX * GridSizeY);
+	Simd.SetNumUninitialized(GridSizeX * GridSizeY);
+
+	// negative origins and steps that aren't powers of two, the lattice and rounding cases terrain hits
+	Noise.Grid2D(-13.7f, 5.3f, 1.f / 24.f, GridSizeX, GridSizeY, Scalar.GetData(), EVoxelNoisePath::Scalar);
+	Noise.Grid2D(-13.7f, 5.3f, 1.f / 24.f, GridSizeX, GridSizeY, Simd.GetData(), EVoxelNoisePath::Simd);
+	TestTrue(TEXT("2D grids match bit for bit"), IsBitExact(Scalar, Simd));
+
+	Noise.FractalGrid2D(-13.7f, 5.3f, 1.f / 128.f, GridSizeX, GridSizeY, 4, 2.f, 0.5f, Scalar.GetData(), EVoxelNoisePath::Scalar);
+	Noise.FractalGrid2D(-13.7f, 5.3f, 1.f / 128.f, GridSizeX, GridSizeY, 4, 2.f, 0.5f, Simd.GetData(), EVoxelNoisePath::Simd);
+	TestTrue(TEXT("fractal 2D grids match bit for bit"), IsBitExact(Scalar, Simd));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelNoiseGrid3DTest, "MCUE.Voxel.Noise.Grid3DPathsMatch", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelNoiseGrid3DTest::RunTest(const FString& Parameters)
+{
+	const FVoxelNoise Noise(NoiseTestSeed);
+	const FVector Origin(-7.1f, 3.9f, -2.2f);
+
+	TArray<float> Scalar;
+	TArray<float> Simd;
+	Scalar.SetNumUninitialized(GridSizeX * GridSizeY * GridSizeZ);
+	Simd.SetNumUninitialized(GridSizeX * GridSizeY * GridSizeZ);
+
+	Noise.Grid3D(Origin, 1.f / 24.f, GridSizeX, GridSizeY, GridSizeZ, Scalar.GetData(), EVoxelNoisePath::Scalar);
+	Noise.Grid3D(Origin, 1.f / 24.f, GridSizeX, GridSizeY, GridSizeZ, Simd.GetData(), EVoxelNoisePath::Simd);
+	TestTrue(TEXT("3D grids match bit for bit"), IsBitExact(Scalar, Simd));
+
+	Noise.FractalGrid3D(Origin, 1.f / 64.f, GridSizeX, GridSizeY, GridSizeZ, 3, 2.f, 0.5f, Scalar.GetData(), EVoxelNoisePath::Scalar);
+	Noise.FractalGrid3D(Origin, 1.f / 64.f, GridSizeX, GridSizeY, GridSizeZ, 3, 2.f, 0.5f, Simd.GetData(), EVoxelNoisePath::Simd);
+	TestTrue(TEXT("fractal 3D grids match bit for bit"), IsBitExact(Scalar, Simd));
+	return true;
+}
+
+#endif
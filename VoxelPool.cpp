@@ -0,0 +1,260 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelPool.h"
+#include "Misc/ScopeLock.h"
+#include "VoxelChunk.h"
+#include "VoxelSection.h"
+#include "VoxelStats.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Arena Heap Allocations"), STAT_ArenaHeapAllocations, STATGROUP_Voxel);
+
+namespace
+{
+	// memory a pool grows by at a time, big buffers get a slab of their own
+	constexpr SIZE_T SlabSize = 256 * 1024;
+
+	constexpr SIZE_T Megabyte = 1024 * 1024;
+
+	// one pool per width a section can store its blocks at, 1 to 16 bits
+	constexpr int32 NumSectionPools = 5;
+
+	FVoxelBufferPool* GetSectionPools()
+	{
+		static FVoxelBufferPool* Pools = new FVoxelBufferPool[NumSectionPools]
+		{
+			{ TEXT("Section 1 Bit"), FVoxelSection::GetStorageSize(1), 64 * Megabyte },
+			{ TEXT("Section 2 Bit"), FVoxelSection::GetStorageSize(2), 64 * Megabyte },
+			{ TEXT("Section 4 Bit"), FVoxelSection::GetStorageSize(4), 64 * Megabyte },
+			{ TEXT("Section 8 Bit"), FVoxelSection::GetStorageSize(8), 64 * Megabyte },
+			{ TEXT("Section Raw"), FVoxelSection::GetStorageSize(16), 64 * Megabyte }
+		};
+
+		return Pools;
+	}
+}
+
+FVoxelBufferPool::FVoxelBufferPool(const TCHAR* InName, SIZE_T InBufferSize, SIZE_T InMaxBytes)
+	: Name(InName)
+	, BufferSize(Align(FMath::Max<SIZE_T>(InBufferSize, sizeof(FFreeBuffer)), 16))
+	, MaxBytes(InMaxBytes)
+	, FreeList(nullptr)
+{
+	BuffersPerSlab = FMath::Max<int32>(1, SlabSize / BufferSize);
+}
+
+FVoxelBufferPool::~FVoxelBufferPool()
+{
+	for (uint8* Slab : Slabs)
+	{
+		FMemory::Free(Slab);
+	}
+}
+
+void* FVoxelBufferPool::Allocate()
+{
+	FScopeLock ScopeLock(&Lock);
+
+	const SIZE_T BytesPerSlab = BuffersPerSlab * BufferSize;
+
+	if (FreeList == nullptr && (SIZE_T)Stats.SlabBytes + BytesPerSlab <= MaxBytes)
+	{
+		uint8* Slab = (uint8*)FMemory::Malloc(BytesPerSlab, 16);
+
+		int32 SlabIndex = 0;
+		while (SlabIndex < Slabs.Num() && Slabs[SlabIndex] < Slab)
+		{
+			++SlabIndex;
+		}
+
+		Slabs.Insert(Slab, SlabIndex);
+		Stats.SlabBytes += BytesPerSlab;
+
+		// linked back to front so buffers are handed out in address order
+		for (int32 BufferIndex = BuffersPerSlab - 1; BufferIndex >= 0; --BufferIndex)
+		{
+			FFreeBuffer* Buffer = (FFreeBuffer*)(Slab + BufferIndex * BufferSize);
+			Buffer->Next = FreeList;
+			FreeList = Buffer;
+		}
+	}
+
+	void* Buffer = FreeList;
+
+	if (Buffer != nullptr)
+	{
+		FreeList = FreeList->Next;
+	}
+	else
+	{
+		Buffer = FMemory::Malloc(BufferSize, 16);
+		++Stats.NumFallbacks;
+	}
+
+	Stats.HighWater = FMath::Max(Stats.HighWater, ++Stats.NumInUse);
+
+	return Buffer;
+}
+
+void FVoxelBufferPool::Free(void* Buffer)
+{
+	if (Buffer == nullptr)
+	{
+		return;
+	}
+
+	FScopeLock ScopeLock(&Lock);
+
+	--Stats.NumInUse;
+
+	if (!IsInSlab(Buffer))
+	{
+		FMemory::Free(Buffer);
+		return;
+	}
+
+	FFreeBuffer* FreeBuffer = (FFreeBuffer*)Buffer;
+	FreeBuffer->Next = FreeList;
+	FreeList = FreeBuffer;
+}
+
+FVoxelPoolStats FVoxelBufferPool::GetStats() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Stats;
+}
+
+bool FVoxelBufferPool::IsInSlab(const void* Buffer) const
+{
+	const UPTRINT Address = (UPTRINT)Buffer;
+
+	// last slab starting at or before the buffer
+	int32 Low = 0;
+	int32 High = Slabs.Num();
+
+	while (Low < High)
+	{
+		const int32 Middle = (Low + High) / 2;
+
+		if ((UPTRINT)Slabs[Middle] <= Address)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+
+	return Low > 0 && Address < (UPTRINT)Slabs[Low - 1] + BuffersPerSlab * BufferSize;
+}
+
+FVoxelBufferPool& FVoxelPools::GetSectionPool(int32 BitsPerBlock)
+{
+	checkSlow(FMath::IsPowerOfTwo(BitsPerBlock) && BitsPerBlock <= 16);
+	return GetSectionPools()[FMath::FloorLog2(BitsPerBlock)];
+}
+
+FVoxelBufferPool& FVoxelPools::GetLightPool()
+{
+	static FVoxelBufferPool* Pool = new FVoxelBufferPool(TEXT("Light"), FVoxelSection::NumBlocks, 128 * Megabyte);
+	return *Pool;
+}
+
+FVoxelBufferPool& FVoxelPools::GetChunkPool()
+{
+	static FVoxelBufferPool* Pool = new FVoxelBufferPool(TEXT("Chunk"), sizeof(FVoxelChunk), 16 * Megabyte);
+	return *Pool;
+}
+
+FVoxelBufferPool& FVoxelPools::GetArenaPool()
+{
+	static FVoxelBufferPool* Pool = new FVoxelBufferPool(TEXT("Arena"), FVoxelArena::BlockSize, 32 * Megabyte);
+	return *Pool;
+}
+
+void FVoxelPools::ForEachPool(TFunctionRef<void(const FVoxelBufferPool&)> Visitor)
+{
+	for (int32 PoolIndex = 0; PoolIndex < NumSectionPools; ++PoolIndex)
+	{
+		Visitor(GetSectionPools()[PoolIndex]);
+	}
+
+	Visitor(GetLightPool());
+	Visitor(GetChunkPool());
+	Visitor(GetArenaPool());
+}
+
+FVoxelArena::FVoxelArena()
+	: LastBlock(nullptr)
+	, LastHeapAllocation(nullptr)
+	, NumHeapAllocations(0)
+	, Cursor(nullptr)
+	, End(nullptr)
+	, NumBlocks(0)
+{
+}
+
+FVoxelArena::~FVoxelArena()
+{
+	Reset();
+}
+
+void* FVoxelArena::Allocate(SIZE_T Size, SIZE_T Alignment)
+{
+	const SIZE_T HeaderSize = Align(sizeof(FBlockHeader), Alignment);
+
+	if (HeaderSize + Size > (SIZE_T)BlockSize)
+	{
+		// too big for any block, kept until the reset like everything else
+		FBlockHeader* Allocation = (FBlockHeader*)FMemory::Malloc(HeaderSize + Size, FMath::Max<SIZE_T>(Alignment, 16));
+		Allocation->Previous = LastHeapAllocation;
+		LastHeapAllocation = Allocation;
+		++NumHeapAllocations;
+		INC_DWORD_STAT(STAT_ArenaHeapAllocations);
+
+		return (uint8*)Allocation + HeaderSize;
+	}
+
+	uint8* Result = Align(Cursor, Alignment);
+
+	if (LastBlock == nullptr || Result + Size > End)
+	{
+		FBlockHeader* Block = (FBlockHeader*)FVoxelPools::GetArenaPool().Allocate();
+		Block->Previous = LastBlock;
+		LastBlock = Block;
+		++NumBlocks;
+
+		Cursor = (uint8*)(Block + 1);
+		End = (uint8*)Block + BlockSize;
+		Result = Align(Cursor, Alignment);
+	}
+
+	Cursor = Result + Size;
+	return Result;
+}
+
+void FVoxelArena::Reset()
+{
+	FVoxelBufferPool& Pool = FVoxelPools::GetArenaPool();
+
+	while (LastBlock != nullptr)
+	{
+		FBlockHeader* Previous = LastBlock->Previous;
+		Pool.Free(LastBlock);
+		LastBlock = Previous;
+	}
+
+	while (LastHeapAllocation != nullptr)
+	{
+		FBlockHeader* Previous = LastHeapAllocation->Previous;
+		FMemory::Free(LastHeapAllocation);
+		LastHeapAllocation = Previous;
+	}
+
+	NumHeapAllocations = 0;
+
+	Cursor = nullptr;
+	End = nullptr;
+	NumBlocks = 0;
+}
@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// occupancy of one buffer pool
+struct FVoxelPoolStats
+{
+	// buffers handed out and not freed yet, heap fallbacks included
+	int32 NumInUse;
+
+	// most buffers in use at once since the pool was created
+	int32 HighWater;
+
+	// buffers that came from the general heap because the slabs were full, since the pool was created
+	int32 NumFallbacks;
+
+	// bytes held in slabs, free or not
+	int64 SlabBytes;
+
+	FVoxelPoolStats()
+		: NumInUse(0), HighWater(0), NumFallbacks(0), SlabBytes(0) {}
+};
+
+// Hands out buffers of one fixed size carved from large slabs and takes them back on a free list
+// threaded through the free buffers themselves, so chunks streaming in and out keep reusing the
+// same memory instead of going through the general heap. Slabs are only allocated while the pool
+// grows and are kept until it is destroyed. Past MaxBytes of slabs buffers fall back to the heap
+// and are counted, a steady state that still falls back needs a bigger budget. Thread safe.
+class MCUE_API FVoxelBufferPool
+{
+public:
+	FVoxelBufferPool(const TCHAR* InName, SIZE_T InBufferSize, SIZE_T InMaxBytes);
+	~FVoxelBufferPool();
+
+	FVoxelBufferPool(const FVoxelBufferPool&) = delete;
+	FVoxelBufferPool& operator=(const FVoxelBufferPool&) = delete;
+
+	// uninitialised buffer of GetBufferSize bytes, aligned to 16
+	void* Allocate();
+
+	// takes back a buffer Allocate handed out
+	void Free(void* Buffer);
+
+	const TCHAR* GetName() const { return Name; }
+
+	SIZE_T GetBufferSize() const { return BufferSize; }
+
+	FVoxelPoolStats GetStats() const;
+
+private:
+	// a free buffer's first bytes point at the next free buffer
+	struct FFreeBuffer
+	{
+		FFreeBuffer* Next;
+	};
+
+	// true if the buffer lies in one of the slabs, false for heap fallbacks
+	bool IsInSlab(const void* Buffer) const;
+
+	const TCHAR* Name;
+	SIZE_T BufferSize;
+	SIZE_T MaxBytes;
+	int32 BuffersPerSlab;
+
+	mutable FCriticalSection Lock;
+
+	// sorted by address so Free can tell slab buffers from fallbacks
+	TArray<uint8*> Slabs;
+
+	FFreeBuffer* FreeList;
+
+	FVoxelPoolStats Stats;
+};
+
+// The pools every chunk draws its storage from, created on first use and shared by all worlds.
+// They are never destroyed, so chunks that outlive the module at exit can still free into them.
+// Section storage gets one pool per index width since each width has a fixed size.
+class MCUE_API FVoxelPools
+{
+public:
+	// words and palette of a section storing BitsPerBlock bits per block
+	static FVoxelBufferPool& GetSectionPool(int32 BitsPerBlock);
+
+	// per cell light of one section
+	static FVoxelBufferPool& GetLightPool();
+
+	// FVoxelChunk structs themselves
+	static FVoxelBufferPool& GetChunkPool();
+
+	// blocks FVoxelArena bump allocates from
+	static FVoxelBufferPool& GetArenaPool();
+
+	static void ForEachPool(TFunctionRef<void(const FVoxelBufferPool&)> Visitor);
+};
+
+// Bump allocator for scratch data that lives as long as one job, like the masks of a mesh or the
+// queues of a light flood. Takes fixed size blocks from the arena pool and gives them all back
+// when it is reset or destroyed, nothing is freed on its own. Allocations too big for a block come
+// from the heap and are counted in the Arena Heap Allocations stat. Not thread safe, every job
+// keeps its own.
+class MCUE_API FVoxelArena
+{
+public:
+	static constexpr int32 BlockSize = 64 * 1024;
+
+	FVoxelArena();
+	~FVoxelArena();
+
+	FVoxelArena(const FVoxelArena&) = delete;
+	FVoxelArena& operator=(const FVoxelArena&) = delete;
+
+	// uninitialised memory, from the heap if Size doesn't fit in a block
+	void* Allocate(SIZE_T Size, SIZE_T Alignment);
+
+	template<typename T>
+	T* AllocateArray(int32 Num)
+	{
+		return (T*)Allocate(Num * sizeof(T), alignof(T));
+	}
+
+	// returns every block to the pool, everything allocated so far is gone
+	void Reset();
+
+	int32 GetNumBlocks() const { return NumBlocks; }
+
+	// allocations that were too big for a block since the last reset
+	int32 GetNumHeapAllocations() const { return NumHeapAllocations; }
+
+private:
+	// at the start of every block, linking it to the block filled before it
+	struct FBlockHeader
+	{
+		FBlockHeader* Previous;
+	};
+
+	FBlockHeader* LastBlock;
+
+	// heap allocations, linked the same way as the blocks
+	FBlockHeader* LastHeapAllocation;
+	int32 NumHeapAllocations;
+
+	uint8* Cursor;
+	uint8* End;
+	int32 NumBlocks;
+};
+
+// An append only queue of plain structs in arena memory, walked by index while it grows. Items live
+// in pages that never move, so growing copies nothing but the page table, and Reset keeps the pages
+// for the next run. The page table doubles whenever it is full, the old one stays in the arena.
+template<typename T>
+class TVoxelArenaQueue
+{
+public:
+	static constexpr int32 PageBytes = 4096;
+	static constexpr int32 ItemsPerPage = PageBytes / sizeof(T);
+	static constexpr int32 InitialMaxPages = 64;
+
+	explicit TVoxelArenaQueue(FVoxelArena& InArena)
+		: Arena(&InArena)
+		, Pages(nullptr)
+		, NumPages(0)
+		, MaxPages(0)
+		, NumItems(0)
+	{
+	}
+
+	int32 Add(const T& Item)
+	{
+		const int32 PageIndex = NumItems / ItemsPerPage;
+
+		if (PageIndex == NumPages)
+		{
+			if (NumPages == MaxPages)
+			{
+				GrowPageTable();
+			}
+
+			Pages[NumPages++] = Arena->AllocateArray<T>(ItemsPerPage);
+		}
+
+		new (&Pages[PageIndex][NumItems % ItemsPerPage]) T(Item);
+		return NumItems++;
+	}
+
+	FORCEINLINE T& operator[](int32 Index) { return Pages[Index / ItemsPerPage][Index % ItemsPerPage]; }
+	FORCEINLINE const T& operator[](int32 Index) const { return Pages[Index / ItemsPerPage][Index % ItemsPerPage]; }
+
+	int32 Num() const { return NumItems; }
+
+	void Reset() { NumItems = 0; }
+
+	int32 GetNumPages() const { return NumPages; }
+
+private:
+	void GrowPageTable()
+	{
+		const int32 NewMaxPages = MaxPages > 0 ? MaxPages * 2 : InitialMaxPages;
+		T** NewPages = Arena->AllocateArray<T*>(NewMaxPages);
+
+		if (NumPages > 0)
+		{
+			FMemory::Memcpy(NewPages, Pages, NumPages * sizeof(T*));
+		}
+
+		Pages = NewPages;
+		MaxPages = NewMaxPages;
+	}
+
+	FVoxelArena* Arena;
+
+	// MaxPages slots, taken from the arena with the first page and again every time it doubles
+	T** Pages;
+	int32 NumPages;
+	int32 MaxPages;
+	int32 NumItems;
+};
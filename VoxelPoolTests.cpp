@@ -0,0 +1,232 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelPool.h"
+#include "BlockRegistry.h"
+#include "TerrainGenerator.h"
+#include "VoxelChunk.h"
+#include "VoxelLighting.h"
+#include "VoxelMesher.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// every pool added together, to see whether any of them grew or fell back to the heap
+	FVoxelPoolStats GetPoolTotals()
+	{
+		FVoxelPoolStats Totals;
+
+		FVoxelPools::ForEachPool([&Totals](const FVoxelBufferPool& Pool)
+		{
+			const FVoxelPoolStats Stats = Pool.GetStats();
+
+			Totals.NumInUse += Stats.NumInUse;
+			Totals.NumFallbacks += Stats.NumFallbacks;
+			Totals.SlabBytes += Stats.SlabBytes;
+		});
+
+		return Totals;
+	}
+
+	// a Width x Width window of columns sliding along x, the way chunks stream in around a player walking in a straight line
+	struct FStreamingTestWindow
+	{
+		int32 Width;
+		TArray<TUniquePtr<FVoxelChunk>> Slots;
+
+		explicit FStreamingTestWindow(int32 InWidth)
+			: Width(InWidth)
+		{
+			Slots.SetNum(Width * Width);
+		}
+
+		TUniquePtr<FVoxelChunk>& GetSlot(const FIntPoint& ChunkCoord)
+		{
+			return Slots[(ChunkCoord.X % Width + Width) % Width + ChunkCoord.Y * Width];
+		}
+
+		const FVoxelChunk* FindChunk(const FIntPoint& ChunkCoord)
+		{
+			if (ChunkCoord.Y < 0 || ChunkCoord.Y >= Width)
+			{
+				return nullptr;
+			}
+
+			const TUniquePtr<FVoxelChunk>& Slot = GetSlot(ChunkCoord);
+			return Slot.IsValid() && Slot->Coord == ChunkCoord ? Slot.Get() : nullptr;
+		}
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelBufferPoolReuseTest, "MCUE.Voxel.Pool.BufferReuse", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelBufferPoolReuseTest::RunTest(const FString& Parameters)
+{
+	// room for a single slab of 1 KB buffers
+	FVoxelBufferPool Pool(TEXT("Test"), 1024, 256 * 1024);
+
+	void* First = Pool.Allocate();
+	const FVoxelPoolStats Grown = Pool.GetStats();
+	Pool.Free(First);
+
+	TestEqual(TEXT("a freed buffer is handed out again"), Pool.Allocate(), First);
+	TestEqual(TEXT("reusing a buffer doesn't grow the pool"), Pool.GetStats().SlabBytes, Grown.SlabBytes);
+	Pool.Free(First);
+
+	// one more than the slab holds has to come from the heap
+	TArray<void*> Buffers;
+	for (int32 Index = 0; Index <= 256; ++Index)
+	{
+		Buffers.Add(Pool.Allocate());
+	}
+
+	TestEqual(TEXT("buffers past the budget fall back to the heap"), Pool.GetStats().NumFallbacks, 1);
+	TestEqual(TEXT("the budget is never exceeded"), Pool.GetStats().SlabBytes, Grown.SlabBytes);
+
+	for (void* Buffer : Buffers)
+	{
+		Pool.Free(Buffer);
+	}
+
+	TestEqual(TEXT("slab buffers and fallbacks are all taken back"), Pool.GetStats().NumInUse, 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelArenaQueueGrowthTest, "MCUE.Voxel.Pool.ArenaQueueGrowth", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelArenaQueueGrowthTest::RunTest(const FString& Parameters)
+{
+	FVoxelArena Arena;
+	TVoxelArenaQueue<int32> Queue(Arena);
+
+	// more pages than the page table used to be capped at
+	const int32 NumItems = 4096 * TVoxelArenaQueue<int32>::ItemsPerPage + 1;
+
+	for (int32 Index = 0; Index < NumItems; ++Index)
+	{
+		Queue.Add(Index);
+	}
+
+	bool bItemsKept = Queue.Num() == NumItems;
+	for (int32 Index = 0; Index < NumItems && bItemsKept; ++Index)
+	{
+		bItemsKept = Queue[Index] == Index;
+	}
+
+	TestTrue(TEXT("items survive the page table growing"), bItemsKept);
+	TestEqual(TEXT("one page per ItemsPerPage items"), Queue.GetNumPages(), 4097);
+
+	// a reset queue fills the pages it already has
+	const int32 NumBlocks = Arena.GetNumBlocks();
+	Queue.Reset();
+
+	for (int32 Index = 0; Index < NumItems; ++Index)
+	{
+		Queue.Add(Index);
+	}
+
+	TestEqual(TEXT("refilling a reset queue takes no new arena blocks"), Arena.GetNumBlocks(), NumBlocks);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelArenaLargeAllocationTest, "MCUE.Voxel.Pool.ArenaLargeAllocation", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelArenaLargeAllocationTest::RunTest(const FString& Parameters)
+{
+	FVoxelArena Arena;
+
+	uint8* Large = (uint8*)Arena.Allocate(FVoxelArena::BlockSize * 2, 16);
+	FMemory::Memset(Large, 0xAB, FVoxelArena::BlockSize * 2);
+
+	TestEqual(TEXT("an allocation bigger than a block comes from the heap"), Arena.GetNumHeapAllocations(), 1);
+	TestEqual(TEXT("and takes no block"), Arena.GetNumBlocks(), 0);
+	TestTrue(TEXT("heap allocations are aligned"), IsAligned(Large, 16));
+
+	Arena.Allocate(64, 16);
+	TestEqual(TEXT("small allocations still go into blocks"), Arena.GetNumBlocks(), 1);
+
+	Arena.Reset();
+	TestEqual(TEXT("a reset frees heap allocations"), Arena.GetNumHeapAllocations(), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelPoolStreamingTest, "MCUE.Voxel.Pool.SteadyStateStreaming", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelPoolStreamingTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 Width = 4;
+
+	TArray<FVoxelBlockType> Types;
+	Types.AddDefaulted(4);
+	Types[1].Name = TEXT("Stone");
+	Types[2].Name = TEXT("Dirt");
+	Types[3].Name = TEXT("Grass");
+
+	FBlockRegistry Registry;
+	Registry.Build(Types);
+
+	const FTerrainGenerator Generator(FTerrainSettings(), Registry);
+
+	FStreamingTestWindow Window(Width);
+	FVoxelChunkMesh Mesh;
+
+	// drops the column Width steps behind, generates and lights column X in its place and
+	// meshes the column before it, whose neighbours are all in now
+	auto StreamColumn = [&](int32 X)
+	{
+		for (int32 Y = 0; Y < Width; ++Y)
+		{
+			TUniquePtr<FVoxelChunk>& Slot = Window.GetSlot(FIntPoint(X, Y));
+			Slot.Reset();
+			Slot = MakeUnique<FVoxelChunk>(FIntPoint(X, Y));
+
+			Generator.GenerateChunk(*Slot);
+			Slot->bPopulated = true;
+			FVoxelLighting::LightChunk(*Slot, Registry);
+		}
+
+		for (int32 Y = 0; Y < Width; ++Y)
+		{
+			const FIntPoint ChunkCoord(X - 1, Y);
+			const FVoxelChunk* Chunk = Window.FindChunk(ChunkCoord);
+
+			if (Chunk == nullptr)
+			{
+				continue;
+			}
+
+			FVoxelChunkNeighbours Neighbours;
+			Neighbours.PosX = Window.FindChunk(ChunkCoord + FIntPoint(1, 0));
+			Neighbours.NegX = Window.FindChunk(ChunkCoord + FIntPoint(-1, 0));
+			Neighbours.PosY = Window.FindChunk(ChunkCoord + FIntPoint(0, 1));
+			Neighbours.NegY = Window.FindChunk(ChunkCoord + FIntPoint(0, -1));
+
+			FVoxelMesher::BuildChunkMesh(*Chunk, Neighbours, Registry, 100.f, Mesh);
+		}
+	};
+
+	// fill the window, then turn it over twice so every pool reaches its working size
+	int32 X = 0;
+	for (; X < Width * 3; ++X)
+	{
+		StreamColumn(X);
+	}
+
+	const FVoxelPoolStats Before = GetPoolTotals();
+
+	for (int32 Step = 0; Step < Width * 4; ++Step, ++X)
+	{
+		StreamColumn(X);
+	}
+
+	const FVoxelPoolStats After = GetPoolTotals();
+
+	// once the pools stop growing every chunk, section, light and scratch buffer came from memory they already had
+	TestEqual(TEXT("pools don't grow once streaming is warm"), After.SlabBytes, Before.SlabBytes);
+	TestEqual(TEXT("nothing falls back to the heap once streaming is warm"), After.NumFallbacks, Before.NumFallbacks);
+	return true;
+}
+
+#endif
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelChunk.h"
+
+// one ray for a batched voxel raycast, Direction must be normalized
+struct FVoxelRay
+{
+	FVector Start;
+	FVector Direction;
+	float MaxDistance;
+
+	FVoxelRay() {}
+	FVoxelRay(const FVector& InStart, const FVector& InDirection, float InMaxDistance)
+		: Start(InStart), Direction(InDirection), MaxDistance(InMaxDistance) {}
+};
+
+struct FVoxelRayHit
+{
+	// block the ray stopped in
+	FIntVector Block;
+
+	// normal of the face the ray entered through, zero if the ray started inside the block
+	FIntVector Normal;
+
+	// distance from the ray start to the entry point, in world units
+	float Distance;
+
+	// type of the hit block, air if nothing was hit
+	uint16 BlockType;
+
+	FVoxelRayHit()
+		: Block(FIntVector::ZeroValue), Normal(FIntVector::ZeroValue), Distance(0.f), BlockType(FVoxelChunk::Air) {}
+
+	bool IsValid() const { return BlockType != FVoxelChunk::Air; }
+};
+
+// Exact grid walking raycast (Amanatides & Woo). Visits every cell the ray passes through in
+// order and stops at the first solid one, without going through the physics scene.
+class FVoxelRaycast
+{
+public:
+	// GetBlock(const FIntVector&) -> uint16 is called once per visited cell and must be safe to
+	// call on whatever thread runs the trace
+	template<typename GetBlockFunc>
+	static bool Trace(const FVector& Start, const FVector& Direction, float MaxDistance, float BlockSize, GetBlockFunc&& GetBlock, FVoxelRayHit& OutHit)
+	{
+		OutHit = FVoxelRayHit();
+
+		FIntVector Block(
+			FMath::FloorToInt(Start.X / BlockSize),
+			FMath::FloorToInt(Start.Y / BlockSize),
+			FMath::FloorToInt(Start.Z / BlockSize));
+
+		uint16 BlockType = GetBlock(Block);
+
+		if (BlockType != FVoxelChunk::Air)
+		{
+			OutHit.Block = Block;
+			OutHit.BlockType = BlockType;
+			return true;
+		}
+
+		int32 Step[3];
+		float NextBoundary[3];
+		float BoundaryDelta[3];
+
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			const float Dir = Direction[Axis];
+
+			if (Dir > 0.f)
+			{
+				Step[Axis] = 1;
+				NextBoundary[Axis] = ((Block[Axis] + 1) * BlockSize - Start[Axis]) / Dir;
+				BoundaryDelta[Axis] = BlockSize / Dir;
+			}
+			else if (Dir < 0.f)
+			{
+				Step[Axis] = -1;
+				NextBoundary[Axis] = (Block[Axis] * BlockSize - Start[Axis]) / Dir;
+				BoundaryDelta[Axis] = -BlockSize / Dir;
+			}
+			else
+			{
+				// never crosses a boundary on this axis
+				Step[Axis] = 0;
+				NextBoundary[Axis] = MAX_flt;
+				BoundaryDelta[Axis] = MAX_flt;
+			}
+		}
+
+		for (;;)
+		{
+			// step into the neighbour across whichever boundary comes first
+			int32 Axis = NextBoundary[0] < NextBoundary[1] ? 0 : 1;
+			Axis = NextBoundary[2] < NextBoundary[Axis] ? 2 : Axis;
+
+			const float Distance = NextBoundary[Axis];
+
+			if (Distance > MaxDistance)
+			{
+				return false;
+			}
+
+			Block[Axis] += Step[Axis];
+			NextBoundary[Axis] += BoundaryDelta[Axis];
+
+			BlockType = GetBlock(Block);
+
+			if (BlockType != FVoxelChunk::Air)
+			{
+				OutHit.Block = Block;
+				OutHit.Normal = FIntVector::ZeroValue;
+				OutHit.Normal[Axis] = -Step[Axis];
+				OutHit.Distance = Distance;
+				OutHit.BlockType = BlockType;
+				return true;
+			}
+		}
+	}
+};
@@ -0,0 +1,566 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelRegion.h"
+#include "BlockRegistry.h"
+#include "VoxelChunk.h"
+#include "TerrainGenerator.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogVoxelRegion, Log, All);
+
+namespace
+{
+	// "MCRG"
+	constexpr uint32 RegionMagic = 0x4752434D;
+	constexpr uint32 RegionVersion = 1;
+
+	// magic, version, number of entries, reserved
+	constexpr int32 HeaderSize = 4 * sizeof(uint32);
+
+	// compression of a single chunk, stored in its table entry
+	enum ERegionFormat : uint32
+	{
+		Format_None = 0,
+		Format_Zlib = 1,
+		Format_LZ4 = 2,
+
+		Format_CompressionMask = 0xFF,
+
+		// set on chunks stored as their changes against the generated column
+		Format_Changes = 0x100
+	};
+
+	uint32 ToFormatId(FName CompressionFormat)
+	{
+		if (CompressionFormat == NAME_Zlib)
+		{
+			return Format_Zlib;
+		}
+
+		return CompressionFormat == NAME_LZ4 ? Format_LZ4 : Format_None;
+	}
+
+	FName ToFormatName(uint32 Format)
+	{
+		if (Format == Format_Zlib)
+		{
+			return NAME_Zlib;
+		}
+
+		return Format == Format_LZ4 ? NAME_LZ4 : NAME_None;
+	}
+
+	// a whole chunk before compression, stored as changes once those come out smaller
+	constexpr int32 WholeChunkSize = FVoxelChunk::NumBlocks * sizeof(uint16);
+
+	// the most an entry holds before compression: a whole chunk and its flags, changes are only
+	// stored when they come out smaller
+	constexpr int32 MaxEncodedChunkSize = WholeChunkSize + 4 * sizeof(uint32);
+
+	FString GetTempFilename(const FString& Filename)
+	{
+		return Filename + TEXT(".tmp");
+	}
+}
+
+FVoxelRegionFile::FVoxelRegionFile(const FString& InFilename)
+	: Filename(InFilename)
+	, Data(nullptr)
+	, DataSize(0)
+{
+	OpenView();
+}
+
+FVoxelRegionFile::~FVoxelRegionFile()
+{
+	CloseView();
+}
+
+void FVoxelRegionFile::OpenView()
+{
+	FMemory::Memzero(Entries, sizeof(Entries));
+
+	IFileManager& FileManager = IFileManager::Get();
+	const FString TempFilename = GetTempFilename(Filename);
+
+	if (FileManager.FileExists(*TempFilename))
+	{
+		// the old file is only deleted once the new one is complete, so a lone temp file is a finished save
+		if (FileManager.FileExists(*Filename))
+		{
+			FileManager.Delete(*TempFilename);
+		}
+		else
+		{
+			FileManager.Move(*Filename, *TempFilename);
+		}
+	}
+
+	if (!FileManager.FileExists(*Filename))
+	{
+		return;
+	}
+
+	MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+	MappedRegion.Reset(MappedFile.IsValid() ? MappedFile->MapRegion() : nullptr);
+
+	if (MappedRegion.IsValid())
+	{
+		Data = MappedRegion->GetMappedPtr();
+		DataSize = MappedRegion->GetMappedSize();
+	}
+	else if (FFileHelper::LoadFileToArray(FileData, *Filename))
+	{
+		Data = FileData.GetData();
+		DataSize = FileData.Num();
+	}
+
+	const int64 TableEnd = HeaderSize + sizeof(Entries);
+
+	uint32 Header[4] = { 0, 0, 0, 0 };
+
+	if (DataSize >= TableEnd)
+	{
+		FMemory::Memcpy(Header, Data, HeaderSize);
+	}
+
+	if (Header[0] != RegionMagic || Header[1] != RegionVersion || Header[2] != NumChunks)
+	{
+		UE_LOG(LogVoxelRegion, Warning, TEXT("Ignoring unreadable region file %s"), *Filename);
+		CloseView();
+		return;
+	}
+
+	FMemory::Memcpy(Entries, Data + HeaderSize, sizeof(Entries));
+
+	// anything pointing outside the file is treated as missing rather than read out of bounds
+	for (FEntry& Entry : Entries)
+	{
+		if (Entry.Offset < TableEnd || (int64)Entry.Offset + Entry.CompressedSize > DataSize)
+		{
+			FMemory::Memzero(&Entry, sizeof(FEntry));
+		}
+	}
+}
+
+void FVoxelRegionFile::CloseView()
+{
+	// the region has to go before the file it maps
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	FileData.Empty();
+
+	Data = nullptr;
+	DataSize = 0;
+}
+
+bool FVoxelRegionFile::HasChunk(const FIntPoint& ChunkCoord) const
+{
+	FRWScopeLock ScopeLock(Lock, SLT_ReadOnly);
+
+	return Entries[GetEntryIndex(ChunkCoord)].Offset != 0;
+}
+
+int64 FVoxelRegionFile::GetFileSize() const
+{
+	FRWScopeLock ScopeLock(Lock, SLT_ReadOnly);
+
+	return DataSize;
+}
+
+bool FVoxelRegionFile::EncodeChunk(const FVoxelChunk& Chunk, const FTerrainGenerator* Generator, TArray<uint8>& OutData)
+{
+	OutData.Reset();
+
+	if (Generator != nullptr)
+	{
+		FVoxelChunk Generated(Chunk.Coord);
+		Generator->GenerateChunk(Generated);
+
+		FMemoryWriter Writer(OutData);
+
+		// changes only make sense against the terrain they were taken from
+		uint32 VersionStamp = Generator->GetVersionStamp();
+		Writer << VersionStamp;
+
+		Chunk.SaveChanges(Writer, Generated);
+
+		if (OutData.Num() < WholeChunkSize)
+		{
+			return true;
+		}
+
+		// rebuilt from the ground up, storing it whole is smaller
+		OutData.Reset();
+	}
+
+	FMemoryWriter Writer(OutData);
+	Chunk.Save(Writer);
+
+	return false;
+}
+
+bool FVoxelRegionFile::DecodeChunk(const TArray<uint8>& Data, bool bChanges, const FBlockRegistry& Registry, const FTerrainGenerator* Generator, FVoxelChunk& Chunk)
+{
+	FMemoryReader Reader(Data);
+	int32 NumUnknownBlocks = 0;
+	bool bLoaded;
+
+	if (!bChanges)
+	{
+		bLoaded = Chunk.Load(Reader, Registry, NumUnknownBlocks);
+	}
+	else
+	{
+		if (Generator == nullptr)
+		{
+			UE_LOG(LogVoxelRegion, Warning, TEXT("Chunk %d,%d is stored as changes to generated terrain, but there is no terrain generator"), Chunk.Coord.X, Chunk.Coord.Y);
+			return false;
+		}
+
+		uint32 VersionStamp = 0;
+		Reader << VersionStamp;
+
+		// the player's edits still win, but the terrain around them is the new terrain
+		if (VersionStamp != Generator->GetVersionStamp())
+		{
+			UE_LOG(LogVoxelRegion, Warning, TEXT("Chunk %d,%d was saved with other terrain settings or generator version, applying its changes to the current terrain"), Chunk.Coord.X, Chunk.Coord.Y);
+		}
+
+		Generator->GenerateChunk(Chunk);
+
+		bLoaded = Chunk.LoadChanges(Reader, Registry, NumUnknownBlocks);
+	}
+
+	// saved with a bigger registry, or damaged in a way the decompressor didn't notice
+	if (NumUnknownBlocks > 0)
+	{
+		UE_LOG(LogVoxelRegion, Warning, TEXT("Chunk %d,%d holds %d blocks of unknown types, loading them as air"), Chunk.Coord.X, Chunk.Coord.Y, NumUnknownBlocks);
+	}
+
+	return bLoaded;
+}
+
+bool FVoxelRegionFile::LoadChunk(FVoxelChunk& Chunk, const FBlockRegistry& Registry, const FTerrainGenerator* Generator) const
+{
+	TArray<uint8> Uncompressed;
+	bool bChanges;
+
+	{
+		FRWScopeLock ScopeLock(Lock, SLT_ReadOnly);
+
+		const FEntry& Entry = Entries[GetEntryIndex(Chunk.Coord)];
+
+		if (Entry.Offset == 0)
+		{
+			return false;
+		}
+
+		// a damaged table could ask for any size, no chunk ever needs more than this
+		if (Entry.UncompressedSize > (uint32)MaxEncodedChunkSize)
+		{
+			UE_LOG(LogVoxelRegion, Warning, TEXT("Damaged chunk %d,%d in %s"), Chunk.Coord.X, Chunk.Coord.Y, *Filename);
+			return false;
+		}
+
+		const uint8* Compressed = Data + Entry.Offset;
+		const uint32 Format = Entry.Format & Format_CompressionMask;
+
+		Uncompressed.SetNumUninitialized(Entry.UncompressedSize);
+
+		if (Format == Format_None)
+		{
+			if (Entry.CompressedSize != Entry.UncompressedSize)
+			{
+				return false;
+			}
+
+			FMemory::Memcpy(Uncompressed.GetData(), Compressed, Entry.UncompressedSize);
+		}
+		else if (!FCompression::UncompressMemory(ToFormatName(Format), Uncompressed.GetData(), Entry.UncompressedSize, Compressed, Entry.CompressedSize))
+		{
+			UE_LOG(LogVoxelRegion, Warning, TEXT("Damaged chunk %d,%d in %s"), Chunk.Coord.X, Chunk.Coord.Y, *Filename);
+			return false;
+		}
+
+		bChanges = (Entry.Format & Format_Changes) != 0;
+	}
+
+	// regenerating takes longer than the rest of the load, it doesn't hold up saves
+	return DecodeChunk(Uncompressed, bChanges, Registry, Generator, Chunk);
+}
+
+bool FVoxelRegionFile::SaveChunks(TArrayView<const FVoxelChunk* const> Chunks, FName CompressionFormat, const FTerrainGenerator* Generator)
+{
+	const FVoxelChunk* NewChunks[NumChunks] = {};
+	TArray<uint8> Encoded[NumChunks];
+	bool bChanges[NumChunks] = {};
+
+	// regenerating for the changes is the slow part, done before loads get locked out
+	for (const FVoxelChunk* Chunk : Chunks)
+	{
+		const int32 Index = GetEntryIndex(Chunk->Coord);
+
+		check(ToRegionCoord(Chunk->Coord) == ToRegionCoord(Chunks[0]->Coord));
+		NewChunks[Index] = Chunk;
+		bChanges[Index] = EncodeChunk(*Chunk, Generator, Encoded[Index]);
+	}
+
+	FRWScopeLock ScopeLock(Lock, SLT_Write);
+
+	FEntry NewEntries[NumChunks];
+	FMemory::Memzero(NewEntries, sizeof(NewEntries));
+
+	TArray<uint8> Output;
+	Output.AddZeroed(HeaderSize + sizeof(NewEntries));
+
+	const uint32 FormatId = ToFormatId(CompressionFormat);
+
+	for (int32 Index = 0; Index < NumChunks; ++Index)
+	{
+		FEntry& Entry = NewEntries[Index];
+
+		if (NewChunks[Index] == nullptr)
+		{
+			// untouched chunks are copied over still compressed
+			const FEntry& OldEntry = Entries[Index];
+
+			if (OldEntry.Offset != 0)
+			{
+				Entry = OldEntry;
+				Entry.Offset = Output.Num();
+				Output.Append(Data + OldEntry.Offset, OldEntry.CompressedSize);
+			}
+			continue;
+		}
+
+		const TArray<uint8>& Uncompressed = Encoded[Index];
+		const uint32 ChangesFlag = bChanges[Index] ? (uint32)Format_Changes : 0u;
+
+		Entry.Offset = Output.Num();
+		Entry.UncompressedSize = Uncompressed.Num();
+		Entry.Format = Format_None | ChangesFlag;
+
+		if (FormatId != Format_None)
+		{
+			int32 CompressedSize = FCompression::CompressMemoryBound(CompressionFormat, Uncompressed.Num());
+			Output.AddUninitialized(CompressedSize);
+
+			if (FCompression::CompressMemory(CompressionFormat, Output.GetData() + Entry.Offset, CompressedSize, Uncompressed.GetData(), Uncompressed.Num())
+				&& CompressedSize < Uncompressed.Num())
+			{
+				Output.SetNum(Entry.Offset + CompressedSize, false);
+				Entry.CompressedSize = CompressedSize;
+				Entry.Format = FormatId | ChangesFlag;
+				continue;
+			}
+
+			// stored as is when the data doesn't compress
+			Output.SetNum(Entry.Offset, false);
+		}
+
+		Entry.CompressedSize = Uncompressed.Num();
+		Output.Append(Uncompressed);
+	}
+
+	const uint32 Header[4] = { RegionMagic, RegionVersion, (uint32)NumChunks, 0 };
+	FMemory::Memcpy(Output.GetData(), Header, HeaderSize);
+	FMemory::Memcpy(Output.GetData() + HeaderSize, NewEntries, sizeof(NewEntries));
+
+	const FString TempFilename = GetTempFilename(Filename);
+
+	if (!FFileHelper::SaveArrayToFile(Output, *TempFilename))
+	{
+		UE_LOG(LogVoxelRegion, Error, TEXT("Failed to write region file %s"), *TempFilename);
+		IFileManager::Get().Delete(*TempFilename);
+		return false;
+	}
+
+	// the mapping keeps the old file open, let go of it before replacing the file
+	CloseView();
+
+	const bool bMoved = IFileManager::Get().Move(*Filename, *TempFilename);
+
+	if (!bMoved)
+	{
+		UE_LOG(LogVoxelRegion, Error, TEXT("Failed to replace region file %s"), *Filename);
+	}
+
+	OpenView();
+
+	return bMoved;
+}
+
+FVoxelRegionStore::FVoxelRegionStore(const FString& InDirectory, FName InCompressionFormat, TSharedRef<const FBlockRegistry, ESPMode::ThreadSafe> InRegistry, TSharedPtr<const FTerrainGenerator, ESPMode::ThreadSafe> InGenerator)
+	: Directory(InDirectory)
+	, CompressionFormat(InCompressionFormat)
+	, Registry(InRegistry)
+	, Generator(InGenerator)
+{
+	IFileManager::Get().MakeDirectory(*Directory, true);
+}
+
+FVoxelRegionStore::~FVoxelRegionStore()
+{
+}
+
+FVoxelRegionFile& FVoxelRegionStore::FindOrOpenRegion(const FIntPoint& RegionCoord)
+{
+	FScopeLock ScopeLock(&RegionsLock);
+
+	TUniquePtr<FVoxelRegionFile>& Region = Regions.FindOrAdd(RegionCoord);
+
+	if (!Region.IsValid())
+	{
+		Region = MakeUnique<FVoxelRegionFile>(Directory / FString::Printf(TEXT("r.%d.%d.mcr"), RegionCoord.X, RegionCoord.Y));
+	}
+
+	return *Region;
+}
+
+bool FVoxelRegionStore::LoadChunk(FVoxelChunk& Chunk)
+{
+	TSharedPtr<const FVoxelChunk, ESPMode::ThreadSafe> Snapshot;
+
+	{
+		FScopeLock ScopeLock(&PendingLock);
+
+		if (const FChunkSnapshot* Pending = PendingChunks.Find(Chunk.Coord))
+		{
+			Snapshot = *Pending;
+		}
+	}
+
+	// newer than what is on disk, and never changes, so it is copied outside the lock
+	if (Snapshot.IsValid())
+	{
+		Chunk.CopyBlocksFrom(*Snapshot);
+		return true;
+	}
+
+	return FindOrOpenRegion(FVoxelRegionFile::ToRegionCoord(Chunk.Coord)).LoadChunk(Chunk, *Registry, Generator.Get());
+}
+
+bool FVoxelRegionStore::SaveRegion(const FIntPoint& RegionCoord, TArrayView<const FVoxelChunk* const> Chunks)
+{
+	FVoxelRegionFile& Region = FindOrOpenRegion(RegionCoord);
+
+	const double StartTime = FPlatformTime::Seconds();
+	const bool bSaved = Region.SaveChunks(Chunks, CompressionFormat, Generator.Get());
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	FScopeLock ScopeLock(&PendingLock);
+
+	WriteStats.Seconds += Seconds;
+
+	if (bSaved)
+	{
+		WriteStats.NumChunks += Chunks.Num();
+		WriteStats.NumRegions += 1;
+		WriteStats.NumBytes += Region.GetFileSize();
+	}
+
+	return bSaved;
+}
+
+int32 FVoxelRegionStore::SaveChunks(TArrayView<const FVoxelChunk* const> Chunks)
+{
+	TMap<FIntPoint, TArray<const FVoxelChunk*>> ChunksByRegion;
+
+	for (const FVoxelChunk* Chunk : Chunks)
+	{
+		ChunksByRegion.FindOrAdd(FVoxelRegionFile::ToRegionCoord(Chunk->Coord)).Add(Chunk);
+	}
+
+	int32 NumSaved = 0;
+
+	for (const TPair<FIntPoint, TArray<const FVoxelChunk*>>& Pair : ChunksByRegion)
+	{
+		if (SaveRegion(Pair.Key, Pair.Value))
+		{
+			NumSaved += Pair.Value.Num();
+		}
+	}
+
+	return NumSaved;
+}
+
+void FVoxelRegionStore::AddPendingChunk(FChunkSnapshot Snapshot)
+{
+	FScopeLock ScopeLock(&PendingLock);
+
+	PendingChunks.Add(Snapshot->Coord, Snapshot);
+}
+
+int32 FVoxelRegionStore::WritePendingChunks()
+{
+	TMap<FIntPoint, TArray<FChunkSnapshot>> SnapshotsByRegion;
+
+	{
+		FScopeLock ScopeLock(&PendingLock);
+
+		for (const TPair<FIntPoint, FChunkSnapshot>& Pair : PendingChunks)
+		{
+			SnapshotsByRegion.FindOrAdd(FVoxelRegionFile::ToRegionCoord(Pair.Key)).Add(Pair.Value);
+		}
+	}
+
+	int32 NumSaved = 0;
+
+	TArray<const FVoxelChunk*> Chunks;
+
+	for (const TPair<FIntPoint, TArray<FChunkSnapshot>>& Pair : SnapshotsByRegion)
+	{
+		Chunks.Reset();
+
+		for (const FChunkSnapshot& Snapshot : Pair.Value)
+		{
+			Chunks.Add(&Snapshot.Get());
+		}
+
+		if (!SaveRegion(Pair.Key, Chunks))
+		{
+			continue;
+		}
+
+		NumSaved += Chunks.Num();
+
+		FScopeLock ScopeLock(&PendingLock);
+
+		// a chunk queued again while its region was written keeps its newer snapshot
+		for (const FChunkSnapshot& Snapshot : Pair.Value)
+		{
+			const FChunkSnapshot* Pending = PendingChunks.Find(Snapshot->Coord);
+
+			if (Pending != nullptr && *Pending == Snapshot)
+			{
+				PendingChunks.Remove(Snapshot->Coord);
+			}
+		}
+	}
+
+	return NumSaved;
+}
+
+int32 FVoxelRegionStore::GetNumPendingChunks() const
+{
+	FScopeLock ScopeLock(&PendingLock);
+
+	return PendingChunks.Num();
+}
+
+FVoxelRegionWriteStats FVoxelRegionStore::GetWriteStats() const
+{
+	FScopeLock ScopeLock(&PendingLock);
+
+	return WriteStats;
+}
@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeRWLock.h"
+
+class FBlockRegistry;
+class FTerrainGenerator;
+class IMappedFileHandle;
+class IMappedFileRegion;
+struct FVoxelChunk;
+
+// One file holding a Size x Size square of chunks: a fixed header, an offset table with one entry
+// per chunk, then every stored chunk compressed on its own. The file is memory mapped, so
+// loading a chunk is a table lookup and a decompress. Saving writes a complete new file next to
+// the old one and swaps it in, a crash mid save leaves the previous version intact. Given the
+// terrain generator, chunks are stored as their changes against the generated column and
+// loading them regenerates the column and patches it.
+class MCUE_API FVoxelRegionFile
+{
+public:
+	static constexpr int32 SizeShift = 5;
+	static constexpr int32 Size = 1 << SizeShift;
+	static constexpr int32 NumChunks = Size * Size;
+
+	explicit FVoxelRegionFile(const FString& InFilename);
+	~FVoxelRegionFile();
+
+	// region that holds the given chunk
+	FORCEINLINE static FIntPoint ToRegionCoord(const FIntPoint& ChunkCoord)
+	{
+		return FIntPoint(ChunkCoord.X >> SizeShift, ChunkCoord.Y >> SizeShift);
+	}
+
+	bool HasChunk(const FIntPoint& ChunkCoord) const;
+
+	// reads the chunk at Chunk.Coord, false if the region never stored it or its data is damaged.
+	// Blocks the registry doesn't know become air. Chunks stored as changes need the generator.
+	// Safe to call from several threads at once.
+	bool LoadChunk(FVoxelChunk& Chunk, const FBlockRegistry& Registry, const FTerrainGenerator* Generator) const;
+
+	// rewrites the file with these chunks added or replaced, every other stored chunk is kept.
+	// Blocks loads while the file is swapped. CompressionFormat is NAME_Zlib, NAME_LZ4 or NAME_None.
+	// Without a generator chunks are stored whole.
+	bool SaveChunks(TArrayView<const FVoxelChunk* const> Chunks, FName CompressionFormat, const FTerrainGenerator* Generator);
+
+	// serializes a chunk the way an entry holds it before compression: as its changes against the
+	// generated column when there is a generator and that comes out smaller, whole otherwise.
+	// Returns true if it was stored as changes.
+	static bool EncodeChunk(const FVoxelChunk& Chunk, const FTerrainGenerator* Generator, TArray<uint8>& OutData);
+
+	// reads what EncodeChunk wrote, regenerating the column first for changes
+	static bool DecodeChunk(const TArray<uint8>& Data, bool bChanges, const FBlockRegistry& Registry, const FTerrainGenerator* Generator, FVoxelChunk& Chunk);
+
+	// bytes the region takes on disk, 0 if it was never saved
+	int64 GetFileSize() const;
+
+	const FString& GetFilename() const { return Filename; }
+
+private:
+	struct FEntry
+	{
+		// byte offset of the compressed chunk from the start of the file, 0 if the chunk isn't stored
+		uint32 Offset;
+		uint32 CompressedSize;
+		uint32 UncompressedSize;
+		// one of the format ids in VoxelRegion.cpp, plus a flag for chunks stored as changes
+		uint32 Format;
+	};
+
+	FORCEINLINE static int32 GetEntryIndex(const FIntPoint& ChunkCoord)
+	{
+		return (ChunkCoord.X & (Size - 1)) + (ChunkCoord.Y & (Size - 1)) * Size;
+	}
+
+	// maps the file and reads its offset table, finishing or discarding a swap a crash interrupted
+	void OpenView();
+	void CloseView();
+
+	FString Filename;
+
+	// read by loads, written while a save swaps the file underneath them
+	mutable FRWLock Lock;
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	// the whole file, only used on platforms that can't map files
+	TArray<uint8> FileData;
+
+	const uint8* Data;
+	int64 DataSize;
+
+	FEntry Entries[NumChunks];
+};
+
+// totals over every region a store wrote since it was opened
+struct FVoxelRegionWriteStats
+{
+	int32 NumChunks;
+	int32 NumRegions;
+
+	// whole region files, untouched chunks copied over included
+	int64 NumBytes;
+
+	double Seconds;
+
+	FVoxelRegionWriteStats()
+		: NumChunks(0), NumRegions(0), NumBytes(0), Seconds(0.0) {}
+};
+
+// Every region file of one saved world, opened the first time one of their chunks is touched.
+// Worlds with a terrain generator only store what the player changed. Chunks can also be queued
+// as snapshots and written later by a background thread, loads see a queued snapshot until it is
+// on disk. Loads and queueing may run on any thread, saves and writes have to come from one
+// thread at a time.
+class MCUE_API FVoxelRegionStore
+{
+public:
+	typedef TSharedRef<const FVoxelChunk, ESPMode::ThreadSafe> FChunkSnapshot;
+
+	// without a generator chunks are stored whole. Loaded blocks the registry doesn't know become air.
+	FVoxelRegionStore(const FString& InDirectory, FName InCompressionFormat, TSharedRef<const FBlockRegistry, ESPMode::ThreadSafe> InRegistry, TSharedPtr<const FTerrainGenerator, ESPMode::ThreadSafe> InGenerator = nullptr);
+	~FVoxelRegionStore();
+
+	// fills Chunk from its queued snapshot or its saved copy, false if it was never saved
+	bool LoadChunk(FVoxelChunk& Chunk);
+
+	// groups the chunks by region and rewrites each region once, returns how many chunks were stored
+	int32 SaveChunks(TArrayView<const FVoxelChunk* const> Chunks);
+
+	// queues a chunk for the next WritePendingChunks, replacing an older snapshot of the same chunk.
+	// The snapshot must not change anymore once queued.
+	void AddPendingChunk(FChunkSnapshot Snapshot);
+
+	// writes every queued snapshot, one rewrite per region, and returns how many were stored.
+	// Snapshots in a region that failed to write stay queued for the next call.
+	int32 WritePendingChunks();
+
+	int32 GetNumPendingChunks() const;
+
+	FVoxelRegionWriteStats GetWriteStats() const;
+
+	const FString& GetDirectory() const { return Directory; }
+
+private:
+	FVoxelRegionFile& FindOrOpenRegion(const FIntPoint& RegionCoord);
+
+	// rewrites one region with the chunks and adds it to the write stats
+	bool SaveRegion(const FIntPoint& RegionCoord, TArrayView<const FVoxelChunk* const> Chunks);
+
+	FString Directory;
+	FName CompressionFormat;
+
+	// the block ids loaded chunks may hold
+	TSharedRef<const FBlockRegistry, ESPMode::ThreadSafe> Registry;
+
+	// the terrain saved chunks are stored as changes against
+	TSharedPtr<const FTerrainGenerator, ESPMode::ThreadSafe> Generator;
+
+	FCriticalSection RegionsLock;
+
+	// never shrinks while the store is alive, so references handed out stay valid
+	TMap<FIntPoint, TUniquePtr<FVoxelRegionFile>> Regions;
+
+	// guards PendingChunks and WriteStats
+	mutable FCriticalSection PendingLock;
+
+	// snapshots waiting for WritePendingChunks, a snapshot being written stays in here until it is on disk
+	TMap<FIntPoint, FChunkSnapshot> PendingChunks;
+
+	FVoxelRegionWriteStats WriteStats;
+};
@@ -0,0 +1,422 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelSection.h"
+#include "VoxelPool.h"
+
+namespace
+{
+	FORCEINLINE uint32 ReadPacked(const uint64* Words, int32 Bits, int32 Index)
+	{
+		const uint32 Bit = Index * Bits;
+		return (uint32)(Words[Bit >> 6] >> (Bit & 63)) & ((1u << Bits) - 1);
+	}
+}
+
+FVoxelSection::FVoxelSection(uint16 InUniformValue)
+	: UniformValue(InUniformValue)
+	, BitsPerBlock(0)
+	, NumUsedEntries(1)
+	, PaletteSize(0)
+	, NumDirectWrites(0)
+	, Words(nullptr)
+	, Palette(nullptr)
+	, PaletteCounts(nullptr)
+{
+}
+
+FVoxelSection::FVoxelSection(const FVoxelSection& Other)
+	: FVoxelSection()
+{
+	*this = Other;
+}
+
+FVoxelSection::FVoxelSection(FVoxelSection&& Other)
+	: FVoxelSection()
+{
+	*this = MoveTemp(Other);
+}
+
+FVoxelSection::~FVoxelSection()
+{
+	FreeStorage();
+}
+
+FVoxelSection& FVoxelSection::operator=(const FVoxelSection& Other)
+{
+	if (this == &Other)
+	{
+		return *this;
+	}
+
+	// a buffer of the same width can be overwritten in place
+	if (BitsPerBlock != Other.BitsPerBlock)
+	{
+		FreeStorage();
+
+		if (Other.BitsPerBlock != 0)
+		{
+			AllocateStorage(Other.BitsPerBlock);
+		}
+	}
+
+	UniformValue = Other.UniformValue;
+	BitsPerBlock = Other.BitsPerBlock;
+	NumUsedEntries = Other.NumUsedEntries;
+	PaletteSize = Other.PaletteSize;
+	NumDirectWrites = Other.NumDirectWrites;
+
+	if (BitsPerBlock != 0)
+	{
+		FMemory::Memcpy(Words, Other.Words, GetStorageSize(BitsPerBlock));
+	}
+
+	return *this;
+}
+
+FVoxelSection& FVoxelSection::operator=(FVoxelSection&& Other)
+{
+	if (this == &Other)
+	{
+		return *this;
+	}
+
+	FreeStorage();
+
+	UniformValue = Other.UniformValue;
+	BitsPerBlock = Other.BitsPerBlock;
+	NumUsedEntries = Other.NumUsedEntries;
+	PaletteSize = Other.PaletteSize;
+	NumDirectWrites = Other.NumDirectWrites;
+	Words = Other.Words;
+	Palette = Other.Palette;
+	PaletteCounts = Other.PaletteCounts;
+
+	// the other section is left uniform with its old id and no storage
+	Other.BitsPerBlock = 0;
+	Other.NumUsedEntries = 1;
+	Other.PaletteSize = 0;
+	Other.NumDirectWrites = 0;
+	Other.Words = nullptr;
+	Other.Palette = nullptr;
+	Other.PaletteCounts = nullptr;
+
+	return *this;
+}
+
+void FVoxelSection::AllocateStorage(int32 Bits)
+{
+	BitsPerBlock = Bits;
+	Words = (uint64*)FVoxelPools::GetSectionPool(Bits).Allocate();
+	Palette = Bits < DirectBits ? (uint16*)(Words + GetNumWords(Bits)) : nullptr;
+	PaletteCounts = Bits < DirectBits ? Palette + (1 << Bits) : nullptr;
+}
+
+void FVoxelSection::FreeStorage()
+{
+	if (Words != nullptr)
+	{
+		FVoxelPools::GetSectionPool(BitsPerBlock).Free(Words);
+	}
+
+	Words = nullptr;
+	Palette = nullptr;
+	PaletteCounts = nullptr;
+}
+
+void FVoxelSection::Set(int32 Index, uint16 Value)
+{
+	if (BitsPerBlock == 0)
+	{
+		if (Value == UniformValue)
+		{
+			return;
+		}
+
+		// the first different block turns the section into a one bit palette around the old id
+		AllocateStorage(1);
+		FMemory::Memzero(Words, GetNumWords(BitsPerBlock) * sizeof(uint64));
+		Palette[0] = UniformValue;
+		PaletteCounts[0] = NumBlocks;
+		PaletteSize = 1;
+		NumUsedEntries = 1;
+	}
+
+	if (BitsPerBlock == DirectBits)
+	{
+		WriteIndex(Index, Value);
+
+		if (++NumDirectWrites == NumBlocks)
+		{
+			Compact();
+		}
+		return;
+	}
+
+	const uint32 OldIndex = ReadIndex(Index);
+
+	if (Palette[OldIndex] == Value)
+	{
+		return;
+	}
+
+	// may widen the indices, but never moves existing palette slots
+	const int32 NewIndex = FindOrAddPaletteIndex(Value);
+
+	if (NewIndex == INDEX_NONE)
+	{
+		WriteIndex(Index, Value);
+		return;
+	}
+
+	WriteIndex(Index, NewIndex);
+	++PaletteCounts[NewIndex];
+
+	if (--PaletteCounts[OldIndex] > 0)
+	{
+		return;
+	}
+
+	--NumUsedEntries;
+
+	if (NumUsedEntries == 1)
+	{
+		// the id just written is the only one left
+		Fill(Value);
+	}
+	else if (NumUsedEntries <= 1 << (BitsPerBlock / 2))
+	{
+		// narrows only once half the width would do, so a type coming and going doesn't repack every time
+		Compact();
+	}
+}
+
+int32 FVoxelSection::FindOrAddPaletteIndex(uint16 Value)
+{
+	int32 FreeIndex = INDEX_NONE;
+
+	for (int32 PaletteIndex = 0; PaletteIndex < PaletteSize; ++PaletteIndex)
+	{
+		if (PaletteCounts[PaletteIndex] == 0)
+		{
+			FreeIndex = FreeIndex == INDEX_NONE ? PaletteIndex : FreeIndex;
+		}
+		else if (Palette[PaletteIndex] == Value)
+		{
+			return PaletteIndex;
+		}
+	}
+
+	if (FreeIndex != INDEX_NONE)
+	{
+		++NumUsedEntries;
+		Palette[FreeIndex] = Value;
+		return FreeIndex;
+	}
+
+	if (PaletteSize == 1 << BitsPerBlock)
+	{
+		if (BitsPerBlock == MaxPaletteBits)
+		{
+			Repack(DirectBits);
+			return INDEX_NONE;
+		}
+
+		Repack(BitsPerBlock * 2);
+	}
+
+	++NumUsedEntries;
+	Palette[PaletteSize] = Value;
+	PaletteCounts[PaletteSize] = 0;
+	return PaletteSize++;
+}
+
+void FVoxelSection::Repack(int32 NewBitsPerBlock)
+{
+	uint64* OldWords = Words;
+	const uint16* OldPalette = Palette;
+	const uint16* OldCounts = PaletteCounts;
+	const int32 OldBitsPerBlock = BitsPerBlock;
+
+	AllocateStorage(NewBitsPerBlock);
+	FMemory::Memzero(Words, GetNumWords(BitsPerBlock) * sizeof(uint64));
+
+	if (BitsPerBlock != DirectBits)
+	{
+		FMemory::Memcpy(Palette, OldPalette, PaletteSize * sizeof(uint16));
+		FMemory::Memcpy(PaletteCounts, OldCounts, PaletteSize * sizeof(uint16));
+	}
+
+	for (int32 Index = 0; Index < NumBlocks; ++Index)
+	{
+		const uint32 PaletteIndex = ReadPacked(OldWords, OldBitsPerBlock, Index);
+
+		WriteIndex(Index, BitsPerBlock == DirectBits ? OldPalette[PaletteIndex] : PaletteIndex);
+	}
+
+	FVoxelPools::GetSectionPool(OldBitsPerBlock).Free(OldWords);
+
+	if (BitsPerBlock == DirectBits)
+	{
+		PaletteSize = 0;
+		NumUsedEntries = 0;
+		NumDirectWrites = 0;
+	}
+}
+
+void FVoxelSection::Fill(uint16 Value)
+{
+	FreeStorage();
+
+	UniformValue = Value;
+	BitsPerBlock = 0;
+	NumUsedEntries = 1;
+	PaletteSize = 0;
+	NumDirectWrites = 0;
+}
+
+void FVoxelSection::Assign(const uint16* Values)
+{
+	// one more than a palette holds, the id that doesn't fit anymore switches to raw ids
+	uint16 NewPalette[(1 << MaxPaletteBits) + 1];
+	uint16 NewCounts[(1 << MaxPaletteBits) + 1];
+	int32 NewPaletteSize = 0;
+	uint8 Indices[NumBlocks];
+
+	// blocks come in runs, so remember the last match before searching the palette
+	int32 LastIndex = 0;
+	bool bDirect = false;
+
+	for (int32 Index = 0; Index < NumBlocks && !bDirect; ++Index)
+	{
+		const uint16 Value = Values[Index];
+
+		if (NewPaletteSize == 0 || NewPalette[LastIndex] != Value)
+		{
+			LastIndex = 0;
+			while (LastIndex < NewPaletteSize && NewPalette[LastIndex] != Value)
+			{
+				++LastIndex;
+			}
+
+			if (LastIndex == NewPaletteSize)
+			{
+				bDirect = NewPaletteSize == 1 << MaxPaletteBits;
+				NewPalette[NewPaletteSize] = Value;
+				NewCounts[NewPaletteSize] = 0;
+				++NewPaletteSize;
+			}
+		}
+
+		Indices[Index] = (uint8)LastIndex;
+		++NewCounts[LastIndex];
+	}
+
+	if (NewPaletteSize == 1)
+	{
+		Fill(NewPalette[0]);
+		return;
+	}
+
+	int32 NewBitsPerBlock = DirectBits;
+
+	if (!bDirect)
+	{
+		NewBitsPerBlock = 1;
+		while (1 << NewBitsPerBlock < NewPaletteSize)
+		{
+			NewBitsPerBlock *= 2;
+		}
+	}
+
+	// storage of the same width is simply overwritten
+	if (BitsPerBlock != NewBitsPerBlock)
+	{
+		FreeStorage();
+		AllocateStorage(NewBitsPerBlock);
+	}
+
+	NumDirectWrites = 0;
+	FMemory::Memzero(Words, GetNumWords(BitsPerBlock) * sizeof(uint64));
+
+	if (bDirect)
+	{
+		NumUsedEntries = 0;
+		PaletteSize = 0;
+
+		for (int32 Index = 0; Index < NumBlocks; ++Index)
+		{
+			WriteIndex(Index, Values[Index]);
+		}
+		return;
+	}
+
+	NumUsedEntries = NewPaletteSize;
+	PaletteSize = NewPaletteSize;
+	FMemory::Memcpy(Palette, NewPalette, NewPaletteSize * sizeof(uint16));
+	FMemory::Memcpy(PaletteCounts, NewCounts, NewPaletteSize * sizeof(uint16));
+
+	for (int32 Index = 0; Index < NumBlocks; ++Index)
+	{
+		WriteIndex(Index, Indices[Index]);
+	}
+}
+
+void FVoxelSection::CopyTo(uint16* OutValues) const
+{
+	if (BitsPerBlock == 0)
+	{
+		for (int32 Index = 0; Index < NumBlocks; ++Index)
+		{
+			OutValues[Index] = UniformValue;
+		}
+		return;
+	}
+
+	for (int32 Index = 0; Index < NumBlocks; ++Index)
+	{
+		OutValues[Index] = Get(Index);
+	}
+}
+
+bool FVoxelSection::ContainsAny(TFunctionRef<bool(uint16)> Predicate) const
+{
+	if (BitsPerBlock == 0)
+	{
+		return Predicate(UniformValue);
+	}
+
+	if (BitsPerBlock == DirectBits)
+	{
+		for (int32 Index = 0; Index < NumBlocks; ++Index)
+		{
+			if (Predicate(Get(Index)))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	for (int32 PaletteIndex = 0; PaletteIndex < PaletteSize; ++PaletteIndex)
+	{
+		if (PaletteCounts[PaletteIndex] > 0 && Predicate(Palette[PaletteIndex]))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FVoxelSection::Compact()
+{
+	if (BitsPerBlock == 0)
+	{
+		return;
+	}
+
+	uint16 Values[NumBlocks];
+	CopyTo(Values);
+	Assign(Values);
+}
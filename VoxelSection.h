@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// A 16x16x16 cube of block ids stored as a small palette of the ids it uses plus one bit packed
+// palette index per block. Indices are as wide as the palette needs (1, 2, 4 or 8 bits) and
+// widen on demand. A section holding a single id keeps no per block data at all, and one with
+// more than 256 different ids stores the raw 16 bit ids instead. Per block data lives in one
+// buffer from the section pool of its width, so sections changing width just swap pooled buffers.
+class MCUE_API FVoxelSection
+{
+public:
+	static constexpr int32 SizeShift = 4;
+	static constexpr int32 Size = 1 << SizeShift;
+	static constexpr int32 NumBlocks = Size * Size * Size;
+
+	// starts out uniformly filled with the given id
+	explicit FVoxelSection(uint16 InUniformValue = 0);
+
+	FVoxelSection(const FVoxelSection& Other);
+	FVoxelSection(FVoxelSection&& Other);
+	~FVoxelSection();
+
+	FVoxelSection& operator=(const FVoxelSection& Other);
+	FVoxelSection& operator=(FVoxelSection&& Other);
+
+	// Index is x + 16 * (y + 16 * z) inside the section
+	FORCEINLINE uint16 Get(int32 Index) const
+	{
+		if (BitsPerBlock == 0)
+		{
+			return UniformValue;
+		}
+
+		const uint32 Value = ReadIndex(Index);
+
+		return BitsPerBlock == DirectBits ? (uint16)Value : Palette[Value];
+	}
+
+	void Set(int32 Index, uint16 Value);
+
+	// overwrites every block, the section becomes uniform
+	void Fill(uint16 Value);
+
+	// replaces the whole section with NumBlocks ids and picks the narrowest storage for them
+	void Assign(const uint16* Values);
+
+	// writes all NumBlocks ids in index order
+	void CopyTo(uint16* OutValues) const;
+
+	// rebuilds the palette from the blocks actually in use and narrows the indices as far as possible
+	void Compact();
+
+	FORCEINLINE bool IsUniform() const { return BitsPerBlock == 0; }
+
+	// bits per block, 0 for a uniform section and 16 once ids are stored raw
+	int32 GetBitsPerBlock() const { return BitsPerBlock; }
+
+	// true if a block in the section has an id the predicate accepts. Looks at the palette only,
+	// raw sections test block by block.
+	bool ContainsAny(TFunctionRef<bool(uint16)> Predicate) const;
+
+	// distinct ids in the section, only counted while there is a palette
+	int32 GetNumPaletteEntries() const { return BitsPerBlock == 0 ? 1 : NumUsedEntries; }
+
+	SIZE_T GetAllocatedSize() const { return BitsPerBlock == 0 ? 0 : GetStorageSize(BitsPerBlock); }
+
+	// bytes of pooled storage at the given width: the packed words, followed by the palette and
+	// its counts unless ids are stored raw
+	static SIZE_T GetStorageSize(int32 Bits)
+	{
+		return GetNumWords(Bits) * sizeof(uint64) + (Bits < DirectBits ? (2 << Bits) * sizeof(uint16) : 0);
+	}
+
+private:
+	static constexpr int32 DirectBits = 16;
+	static constexpr int32 MaxPaletteBits = 8;
+
+	FORCEINLINE uint32 ReadIndex(int32 Index) const
+	{
+		const uint32 Bit = Index * BitsPerBlock;
+		return (uint32)(Words[Bit >> 6] >> (Bit & 63)) & ((1u << BitsPerBlock) - 1);
+	}
+
+	FORCEINLINE void WriteIndex(int32 Index, uint32 Value)
+	{
+		const uint32 Bit = Index * BitsPerBlock;
+		const uint64 Mask = (uint64)((1u << BitsPerBlock) - 1) << (Bit & 63);
+		uint64& Word = Words[Bit >> 6];
+		Word = (Word & ~Mask) | ((uint64)Value << (Bit & 63));
+	}
+
+	// palette slot holding Value, reusing a freed slot or widening the indices when there is none.
+	// Returns INDEX_NONE if the section had to switch to raw ids.
+	int32 FindOrAddPaletteIndex(uint16 Value);
+
+	// rewrites the packed indices at a new width, switching to raw ids at DirectBits
+	void Repack(int32 NewBitsPerBlock);
+
+	// uint64 words needed for NumBlocks entries of the given width
+	static int32 GetNumWords(int32 Bits) { return NumBlocks * Bits / 64; }
+
+	// takes a pooled buffer for the given width and points Words, Palette and PaletteCounts into it.
+	// The buffer is uninitialised and whatever storage the section had is left alone.
+	void AllocateStorage(int32 Bits);
+
+	// hands the storage back to its pool, the section is left with none
+	void FreeStorage();
+
+	// id of every block while the section is uniform
+	uint16 UniformValue;
+
+	uint8 BitsPerBlock;
+
+	// palette slots with at least one block
+	uint16 NumUsedEntries;
+
+	// palette slots handed out so far, used or freed again
+	uint16 PaletteSize;
+
+	// raw ids keep no counts, so a raw section compacts itself after every NumBlocks writes instead
+	uint16 NumDirectWrites;
+
+	// packed palette indices, or raw ids at DirectBits. Null while uniform.
+	uint64* Words;
+
+	// id per palette slot, room for every index the width allows. Null while uniform or raw.
+	uint16* Palette;
+
+	// blocks per palette slot, a slot at 0 is free for the next new id
+	uint16* PaletteCounts;
+};
@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelSection.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// random writes drawn from NumTypes ids, mirrored into a plain array. Returns false as soon as
+	// the section reads back something else after a pass over its blocks.
+	bool WriteAndCompare(FVoxelSection& Section, TArray<uint16>& Reference, FRandomStream& Random, int32 NumTypes, int32 NumWrites)
+	{
+		for (int32 Write = 0; Write < NumWrites; ++Write)
+		{
+			const int32 Index = Random.RandHelper(FVoxelSection::NumBlocks);
+			const uint16 Value = (uint16)Random.RandHelper(NumTypes);
+
+			Section.Set(Index, Value);
+			Reference[Index] = Value;
+
+			if ((Write + 1) % FVoxelSection::NumBlocks == 0 || Write + 1 == NumWrites)
+			{
+				for (int32 Check = 0; Check < FVoxelSection::NumBlocks; ++Check)
+				{
+					if (Section.Get(Check) != Reference[Check])
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// each type count pushes the indices to a different width: 1, 2, 4, 8 bits and raw ids
+	const int32 PaletteTypeCounts[] = { 2, 4, 16, 256, 1000 };
+	const int32 PaletteExpectedBits[] = { 1, 2, 4, 8, 16 };
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelSectionPaletteGrowthTest, "MCUE.Voxel.Section.PaletteGrowth", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelSectionPaletteGrowthTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(1);
+
+	for (int32 Case = 0; Case < UE_ARRAY_COUNT(PaletteTypeCounts); ++Case)
+	{
+		FVoxelSection Section;
+		TArray<uint16> Reference;
+		Reference.SetNumZeroed(FVoxelSection::NumBlocks);
+
+		TestTrue(FString::Printf(TEXT("%d types read back what was written"), PaletteTypeCounts[Case]),
+			WriteAndCompare(Section, Reference, Random, PaletteTypeCounts[Case], FVoxelSection::NumBlocks * 8));
+		TestEqual(FString::Printf(TEXT("%d types widen the indices"), PaletteTypeCounts[Case]), Section.GetBitsPerBlock(), PaletteExpectedBits[Case]);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelSectionPaletteShrinkTest, "MCUE.Voxel.Section.PaletteShrink", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelSectionPaletteShrinkTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(2);
+
+	for (int32 Case = 0; Case < UE_ARRAY_COUNT(PaletteTypeCounts); ++Case)
+	{
+		FVoxelSection Section;
+		TArray<uint16> Reference;
+		Reference.SetNumZeroed(FVoxelSection::NumBlocks);
+
+		WriteAndCompare(Section, Reference, Random, PaletteTypeCounts[Case], FVoxelSection::NumBlocks * 8);
+
+		// back down to two ids, the section has to narrow to a single bit on its own
+		TestTrue(FString::Printf(TEXT("%d types narrowed to 2 read back what was written"), PaletteTypeCounts[Case]),
+			WriteAndCompare(Section, Reference, Random, 2, FVoxelSection::NumBlocks * 16));
+		TestEqual(FString::Printf(TEXT("%d types narrowed to 2 use one bit"), PaletteTypeCounts[Case]), Section.GetBitsPerBlock(), 1);
+
+		for (int32 Index = 0; Index < FVoxelSection::NumBlocks; ++Index)
+		{
+			Section.Set(Index, 7);
+		}
+
+		TestTrue(TEXT("a section set to one id block by block becomes uniform"), Section.IsUniform());
+		TestEqual(TEXT("the uniform section keeps its id"), Section.Get(0), (uint16)7);
+		TestEqual(TEXT("the uniform section gives its storage back"), Section.GetAllocatedSize(), (SIZE_T)0);
+	}
+
+	return true;
+}
+
+#endif
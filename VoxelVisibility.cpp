@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelVisibility.h"
+#include "BlockRegistry.h"
+#include "VoxelChunk.h"
+
+namespace
+{
+	constexpr int32 NumCells = FVoxelSection::NumBlocks;
+	constexpr int32 NumOpenWords = NumCells / 64;
+
+	// a section being walked through and the face it was entered by
+	struct FVisibilityNode
+	{
+		FIntVector Section;
+		uint16 Connections;
+		int8 EntryFace;
+
+		// faces the walk left sections by on its way here, one bit per face
+		uint8 Directions;
+	};
+
+	// every pair among the faces set in FaceMask
+	uint16 ConnectFaces(uint8 FaceMask)
+	{
+		uint16 Connections = 0;
+
+		for (int32 FaceA = 0; FaceA < FVoxelVisibility::NumFaces; ++FaceA)
+		{
+			for (int32 FaceB = FaceA + 1; FaceB < FVoxelVisibility::NumFaces; ++FaceB)
+			{
+				if ((FaceMask >> FaceA & 1) && (FaceMask >> FaceB & 1))
+				{
+					Connections |= FVoxelVisibility::GetPairBit(FaceA, FaceB);
+				}
+			}
+		}
+
+		return Connections;
+	}
+}
+
+FIntVector FVoxelVisibility::GetFaceOffset(int32 Face)
+{
+	static const FIntVector Offsets[NumFaces] =
+	{
+		FIntVector(1, 0, 0),
+		FIntVector(-1, 0, 0),
+		FIntVector(0, 1, 0),
+		FIntVector(0, -1, 0),
+		FIntVector(0, 0, 1),
+		FIntVector(0, 0, -1)
+	};
+
+	return Offsets[Face];
+}
+
+uint16 FVoxelVisibility::ComputeSectionConnections(const FVoxelChunk& Chunk, int32 SectionIndex, const FBlockRegistry& Registry)
+{
+	const FVoxelSection& Section = Chunk.GetSection(SectionIndex);
+
+	if (Section.IsUniform())
+	{
+		return Registry.IsOpaque(Section.Get(0)) ? 0 : AllConnected;
+	}
+
+	// the palette tells whole sections of see-through blocks apart without looking at every cell
+	if (!Section.ContainsAny([&Registry](uint16 BlockType) { return Registry.IsOpaque(BlockType); }))
+	{
+		return AllConnected;
+	}
+
+	// one bit per see-through cell that no flood has reached yet
+	uint64 Open[NumOpenWords];
+	FMemory::Memzero(Open, sizeof(Open));
+
+	for (int32 Index = 0; Index < NumCells; ++Index)
+	{
+		if (!Registry.IsOpaque(Section.Get(Index)))
+		{
+			Open[Index >> 6] |= 1ull << (Index & 63);
+		}
+	}
+
+	constexpr int32 Size = FVoxelSection::Size;
+	constexpr int32 Mask = Size - 1;
+
+	uint16 Stack[NumCells];
+	uint16 Connections = 0;
+
+	for (int32 Word = 0; Word < NumOpenWords; ++Word)
+	{
+		while (Open[Word] != 0)
+		{
+			const int32 Seed = Word * 64 + (int32)FMath::CountTrailingZeros64(Open[Word]);
+			Open[Word] &= Open[Word] - 1;
+
+			int32 StackSize = 0;
+			Stack[StackSize++] = (uint16)Seed;
+			uint8 FaceMask = 0;
+
+			while (StackSize > 0)
+			{
+				const int32 Index = Stack[--StackSize];
+				const int32 X = Index & Mask;
+				const int32 Y = (Index >> FVoxelSection::SizeShift) & Mask;
+				const int32 Z = Index >> (2 * FVoxelSection::SizeShift);
+
+				FaceMask |= (uint8)((X == Mask) << PosX | (X == 0) << NegX | (Y == Mask) << PosY | (Y == 0) << NegY | (Z == Mask) << PosZ | (Z == 0) << NegZ);
+
+				const int32 Neighbours[NumFaces] =
+				{
+					X < Mask ? Index + 1 : INDEX_NONE,
+					X > 0 ? Index - 1 : INDEX_NONE,
+					Y < Mask ? Index + Size : INDEX_NONE,
+					Y > 0 ? Index - Size : INDEX_NONE,
+					Z < Mask ? Index + Size * Size : INDEX_NONE,
+					Z > 0 ? Index - Size * Size : INDEX_NONE
+				};
+
+				for (int32 Neighbour : Neighbours)
+				{
+					if (Neighbour != INDEX_NONE && (Open[Neighbour >> 6] >> (Neighbour & 63) & 1))
+					{
+						Open[Neighbour >> 6] &= ~(1ull << (Neighbour & 63));
+						Stack[StackSize++] = (uint16)Neighbour;
+					}
+				}
+			}
+
+			Connections |= ConnectFaces(FaceMask);
+
+			if (Connections == AllConnected)
+			{
+				return Connections;
+			}
+		}
+	}
+
+	return Connections;
+}
+
+int32 FVoxelVisibility::FindVisibleSections(const FIntVector& StartSection, int32 Radius, FFindSection FindSection, TFunctionRef<void(const FIntVector&)> OnVisible)
+{
+	uint16 StartConnections = AllConnected;
+
+	if (!FindSection(StartSection, StartConnections))
+	{
+		return 0;
+	}
+
+	const int32 Side = 2 * Radius + 1;
+
+	// sections are only entered once, by the shortest walk that reaches them
+	TBitArray<> Visited(false, Side * Side * FVoxelChunk::NumSections);
+
+	auto GetVisitedIndex = [&StartSection, Radius, Side](const FIntVector& Section)
+	{
+		const int32 X = Section.X - StartSection.X + Radius;
+		const int32 Y = Section.Y - StartSection.Y + Radius;
+
+		if ((uint32)X >= (uint32)Side || (uint32)Y >= (uint32)Side || (uint32)Section.Z >= (uint32)FVoxelChunk::NumSections)
+		{
+			return (int32)INDEX_NONE;
+		}
+
+		return X + Side * (Y + Side * Section.Z);
+	};
+
+	TArray<FVisibilityNode> Queue;
+	Queue.Add({ StartSection, StartConnections, INDEX_NONE, 0 });
+
+	if (GetVisitedIndex(StartSection) != INDEX_NONE)
+	{
+		Visited[GetVisitedIndex(StartSection)] = true;
+	}
+
+	OnVisible(StartSection);
+
+	for (int32 Head = 0; Head < Queue.Num(); ++Head)
+	{
+		// copied, adding to the queue may move it
+		const FVisibilityNode Node = Queue[Head];
+
+		for (int32 Face = 0; Face < NumFaces; ++Face)
+		{
+			// never back towards the camera, and only on through faces the way in connects to
+			if ((Node.Directions >> GetOppositeFace(Face) & 1) || (Node.EntryFace != INDEX_NONE && !AreConnected(Node.Connections, Node.EntryFace, Face)))
+			{
+				continue;
+			}
+
+			const FIntVector Next = Node.Section + GetFaceOffset(Face);
+			const int32 VisitedIndex = GetVisitedIndex(Next);
+
+			if (VisitedIndex == INDEX_NONE || Visited[VisitedIndex])
+			{
+				continue;
+			}
+
+			Visited[VisitedIndex] = true;
+
+			uint16 Connections = AllConnected;
+
+			if (!FindSection(Next, Connections))
+			{
+				continue;
+			}
+
+			OnVisible(Next);
+			Queue.Add({ Next, Connections, (int8)GetOppositeFace(Face), (uint8)(Node.Directions | 1 << Face) });
+		}
+	}
+
+	return Queue.Num();
+}
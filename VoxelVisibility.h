@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FBlockRegistry;
+struct FVoxelChunk;
+
+// Cave culling for the voxel world. Every 16x16x16 section of a chunk records which of its six
+// faces reach each other through cells that aren't opaque, one bit per pair of faces. Walking
+// outwards from the camera's section, a neighbour is only entered through a face the walk can get
+// to from the face it came in by, and never back towards the camera, so sections that no air path
+// leads to stay hidden. Section coordinates are the chunk coordinate in x and y and the section
+// index in z. Touches no engine objects, everything runs on plain chunks.
+class MCUE_API FVoxelVisibility
+{
+public:
+	// faces in the order of their directions, opposite faces next to each other
+	enum EFace
+	{
+		PosX,
+		NegX,
+		PosY,
+		NegY,
+		PosZ,
+		NegZ,
+		NumFaces
+	};
+
+	// every pair of faces connected, like a section of air
+	static constexpr uint16 AllConnected = (1 << 15) - 1;
+
+	// bit of the pair of two different faces
+	FORCEINLINE static uint16 GetPairBit(int32 FaceA, int32 FaceB)
+	{
+		const int32 Low = FMath::Min(FaceA, FaceB);
+		const int32 High = FMath::Max(FaceA, FaceB);
+
+		return (uint16)(1 << (Low * (2 * NumFaces - Low - 1) / 2 + High - Low - 1));
+	}
+
+	FORCEINLINE static bool AreConnected(uint16 Connections, int32 FaceA, int32 FaceB)
+	{
+		return FaceA != FaceB && (Connections & GetPairBit(FaceA, FaceB)) != 0;
+	}
+
+	FORCEINLINE static int32 GetOppositeFace(int32 Face) { return Face ^ 1; }
+
+	// the step in section coordinates across a face
+	static FIntVector GetFaceOffset(int32 Face);
+
+	// flood fills the cells of one section that aren't opaque and connects the faces each
+	// connected pocket of them touches
+	static uint16 ComputeSectionConnections(const FVoxelChunk& Chunk, int32 SectionIndex, const FBlockRegistry& Registry);
+
+	// connections of the section, false if it lies outside the area being walked. Sections that
+	// were never worked out should count as AllConnected, culling them could hide what's behind.
+	typedef TFunctionRef<bool(const FIntVector& Section, uint16& OutConnections)> FFindSection;
+
+	// walks outwards from StartSection over at most Radius chunks in x and y and calls OnVisible once
+	// for every section the camera may see into, the start included. Returns how many there were.
+	static int32 FindVisibleSections(const FIntVector& StartSection, int32 Radius, FFindSection FindSection, TFunctionRef<void(const FIntVector&)> OnVisible);
+};
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelVisibility.h"
+#include "BlockRegistry.h"
+#include "VoxelChunk.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// fills one section of the chunk with Block wherever the predicate accepts the local cell
+	template<typename PredicateType>
+	void FillSection(FVoxelChunk& Chunk, int32 SectionIndex, uint16 Block, PredicateType Predicate)
+	{
+		constexpr int32 Size = FVoxelSection::Size;
+
+		for (int32 Z = 0; Z < Size; ++Z)
+		{
+			for (int32 Y = 0; Y < Size; ++Y)
+			{
+				for (int32 X = 0; X < Size; ++X)
+				{
+					if (Predicate(X, Y, Z))
+					{
+						Chunk.SetBlock(X, Y, SectionIndex * Size + Z, Block);
+					}
+				}
+			}
+		}
+	}
+
+	// sections of a 3x3 area of chunks around the origin seen from the middle one at CameraSection,
+	// with every section at RockSection solid and all others air
+	TArray<FIntVector> FindVisibleAboveRock(int32 CameraSection, int32 RockSection)
+	{
+		TArray<FIntVector> Visible;
+
+		FVoxelVisibility::FindVisibleSections(FIntVector(0, 0, CameraSection), 1,
+			[RockSection](const FIntVector& Section, uint16& OutConnections)
+			{
+				OutConnections = Section.Z == RockSection ? 0 : FVoxelVisibility::AllConnected;
+				return true;
+			},
+			[&Visible](const FIntVector& Section)
+			{
+				Visible.Add(Section);
+			});
+
+		return Visible;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelVisibilityPairBitsTest, "MCUE.Voxel.Visibility.PairBits", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelVisibilityPairBitsTest::RunTest(const FString& Parameters)
+{
+	uint16 AllBits = 0;
+	int32 NumPairs = 0;
+
+	for (int32 FaceA = 0; FaceA < FVoxelVisibility::NumFaces; ++FaceA)
+	{
+		for (int32 FaceB = FaceA + 1; FaceB < FVoxelVisibility::NumFaces; ++FaceB)
+		{
+			const uint16 Bit = FVoxelVisibility::GetPairBit(FaceA, FaceB);
+
+			TestTrue(TEXT("every pair has a bit of its own"), FMath::IsPowerOfTwo(Bit) && (AllBits & Bit) == 0);
+			TestEqual(TEXT("a pair's bit doesn't depend on the order of its faces"), FVoxelVisibility::GetPairBit(FaceB, FaceA), Bit);
+
+			AllBits |= Bit;
+			++NumPairs;
+		}
+	}
+
+	TestEqual(TEXT("six faces make fifteen pairs"), NumPairs, 15);
+	TestEqual(TEXT("the pairs together are AllConnected"), AllBits, FVoxelVisibility::AllConnected);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelVisibilityConnectionsTest, "MCUE.Voxel.Visibility.SectionConnections", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelVisibilityConnectionsTest::RunTest(const FString& Parameters)
+{
+	TArray<FVoxelBlockType> Types;
+	Types.AddDefaulted(2);
+	Types[1].Name = TEXT("Stone");
+
+	FBlockRegistry Registry;
+	Registry.Build(Types);
+
+	// sections with a known answer: solid, air, a wall across x and a one block tunnel along x
+	FVoxelChunk Chunk(FIntPoint::ZeroValue);
+	FillSection(Chunk, 0, 1, [](int32, int32, int32) { return true; });
+	FillSection(Chunk, 2, 1, [](int32 X, int32, int32) { return X == 8; });
+	FillSection(Chunk, 3, 1, [](int32, int32 Y, int32 Z) { return Y != 8 || Z != 8; });
+
+	const uint16 PosXNegX = FVoxelVisibility::GetPairBit(FVoxelVisibility::PosX, FVoxelVisibility::NegX);
+
+	TestEqual(TEXT("a solid section connects nothing"), FVoxelVisibility::ComputeSectionConnections(Chunk, 0, Registry), (uint16)0);
+	TestEqual(TEXT("an air section connects everything"), FVoxelVisibility::ComputeSectionConnections(Chunk, 1, Registry), FVoxelVisibility::AllConnected);
+	TestEqual(TEXT("a wall across x only cuts x off from -x"), FVoxelVisibility::ComputeSectionConnections(Chunk, 2, Registry), (uint16)(FVoxelVisibility::AllConnected & ~PosXNegX));
+	TestEqual(TEXT("a tunnel along x only connects x and -x"), FVoxelVisibility::ComputeSectionConnections(Chunk, 3, Registry), PosXNegX);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelVisibilityWalkTest, "MCUE.Voxel.Visibility.HiddenBehindRock", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVoxelVisibilityWalkTest::RunTest(const FString& Parameters)
+{
+	TestEqual(TEXT("in open air every section of the area is visible"), FindVisibleAboveRock(8, INDEX_NONE).Num(), 9 * FVoxelChunk::NumSections);
+
+	const TArray<FIntVector> Visible = FindVisibleAboveRock(8, 4);
+	bool bSeesBelowRock = false;
+
+	for (const FIntVector& Section : Visible)
+	{
+		bSeesBelowRock |= Section.Z < 4;
+	}
+
+	// the layer of rock itself is seen, nothing under it
+	TestEqual(TEXT("every section down to the rock is visible"), Visible.Num(), 9 * (FVoxelChunk::NumSections - 4));
+	TestFalse(TEXT("no section under a layer of solid rock is visible"), bSeesBelowRock);
+	return true;
+}
+
+#endif
@@ -0,0 +1,1874 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelWorld.h"
+#include "Block.h"
+#include "BlockInstancesComponent.h"
+#include "MCUEGameMode.h"
+#include "ProceduralMeshComponent.h"
+#include "VoxelPool.h"
+#include "VoxelRegion.h"
+#include "VoxelStats.h"
+#include "VoxelVisibility.h"
+#include "Async/Async.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Misc/Paths.h"
+#include "UObject/ConstructorHelpers.h"
+#include "Kismet/GameplayStatics.h"
+
+DEFINE_LOG_CATEGORY(LogVoxel);
+
+DECLARE_CYCLE_STAT(TEXT("Chunk Streaming"), STAT_ChunkStreaming, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks Loaded"), STAT_ChunksLoaded, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks Queued"), STAT_ChunksQueued, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks Generating"), STAT_ChunksGenerating, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks Awaiting Remesh"), STAT_ChunksDirty, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Streaming Budget Overruns"), STAT_StreamingBudgetOverruns, STATGROUP_Voxel);
+DECLARE_CYCLE_STAT(TEXT("Lighting"), STAT_VoxelLighting, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Light Updates Queued"), STAT_LightUpdatesQueued, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Light Cells Changed"), STAT_LightCellsChanged, STATGROUP_Voxel);
+DECLARE_CYCLE_STAT(TEXT("Light Batch Wait"), STAT_LightBatchWait, STATGROUP_Voxel);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Light Batch Waits"), STAT_LightBatchWaits, STATGROUP_Voxel);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Block Edits Queued Behind Light"), STAT_QueuedBlockEdits, STATGROUP_Voxel);
+DECLARE_CYCLE_STAT(TEXT("Block Ticks"), STAT_BlockTicks, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Scheduled Block Ticks"), STAT_ScheduledBlockTicks, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks With Scheduled Ticks"), STAT_ScheduledTickChunks, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks With Random Ticks"), STAT_RandomTickChunks, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Scheduled Ticks Run"), STAT_ScheduledTicksRun, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Random Ticks Run"), STAT_RandomTicksRun, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Block Tick Budget Overruns"), STAT_BlockTickBudgetOverruns, STATGROUP_Voxel);
+DECLARE_CYCLE_STAT(TEXT("Save Snapshot"), STAT_SaveSnapshot, STATGROUP_Voxel);
+DECLARE_CYCLE_STAT(TEXT("Save Write"), STAT_SaveWrite, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks Unsaved"), STAT_ChunksUnsaved, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks Awaiting Write"), STAT_ChunksAwaitingWrite, STATGROUP_Voxel);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Save Write MB/s"), STAT_SaveWriteThroughput, STATGROUP_Voxel);
+DECLARE_MEMORY_STAT(TEXT("Pooled Memory In Use"), STAT_PoolBytesInUse, STATGROUP_Voxel);
+DECLARE_MEMORY_STAT(TEXT("Pooled Memory High Water"), STAT_PoolHighWaterBytes, STATGROUP_Voxel);
+DECLARE_MEMORY_STAT(TEXT("Pool Slabs"), STAT_PoolSlabBytes, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pool Fallback Allocations"), STAT_PoolFallbacks, STATGROUP_Voxel);
+DECLARE_CYCLE_STAT(TEXT("Cave Culling"), STAT_CaveCulling, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Visible Sections"), STAT_VisibleSections, STATGROUP_Voxel);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Hidden Mesh Sections"), STAT_HiddenMeshSections, STATGROUP_Voxel);
+
+namespace
+{
+	// the queue is sorted again once the view turned further than this (cos 30 degrees)
+	constexpr float RequeueViewDot = 0.866f;
+
+	// game ticks a frame catches up on at most, after a hitch the rest is dropped instead of run in a burst
+	constexpr int32 MaxGameTicksPerFrame = 2;
+
+	// game ticks between a falling block losing its support and moving down one block
+	constexpr int32 FallTickDelay = 2;
+}
+
+// Sets default values
+AVoxelWorld::AVoxelWorld()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	BlockSize = 100.f;
+	RenderMode = EVoxelRenderMode::ChunkMesh;
+
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> CubeMeshObj(TEXT("/Engine/BasicShapes/Cube"));
+
+	// drawn around the block being mined, a hair bigger so it sits on top of the block's faces
+	CrackOverlay = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("CrackOverlay"));
+	CrackOverlay->SetupAttachment(RootComponent);
+	CrackOverlay->SetMobility(EComponentMobility::Movable);
+	CrackOverlay->SetStaticMesh(CubeMeshObj.Object);
+	CrackOverlay->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	CrackOverlay->SetGenerateOverlapEvents(false);
+	CrackOverlay->CastShadow = false;
+	CrackOverlay->SetHiddenInGame(true);
+	CrackOverlayMaterial = nullptr;
+	CrackOverlayMaterialInstance = nullptr;
+	CrackOverlayBlock = FIntVector::ZeroValue;
+	bCrackOverlayVisible = false;
+	bCaveCulling = true;
+
+	bGenerateTerrain = false;
+	GenerationRadius = 8;
+	UnloadHysteresis = 2;
+	BehindViewPenalty = 1.f;
+	MaxPendingChunks = 8;
+	StreamingBudgetMs = 4.f;
+	StreamingCenter = FIntPoint::ZeroValue;
+	StreamingView = FVector2D(1.f, 0.f);
+	bStreamingStarted = false;
+	ViewBlock = FIntVector::ZeroValue;
+	VisibilityCenter = FIntVector::ZeroValue;
+	bVisibilityDirty = true;
+	NumBudgetOverruns = 0;
+	bSaveWorld = true;
+	SaveName = TEXT("World");
+	SaveCompressionFormat = NAME_LZ4;
+	AutosaveInterval = 30.f;
+	AutosaveTime = 0.f;
+	LastSnapshotSeconds = 0.0;
+	bLighting = true;
+	BlockTickRate = 20.f;
+	RandomTicksPerSection = 3;
+	BlockTickBudget = 4096;
+	BlockTickBudgetMs = 2.f;
+	BlockTickTime = 0.f;
+	MaxUndoEdits = 16;
+	EditDepth = 0;
+	EditMin = FIntVector::ZeroValue;
+	EditMax = FIntVector::ZeroValue;
+	GeneratedChunks = MakeShared<FGeneratedChunkQueue, ESPMode::ThreadSafe>();
+
+	// air plus one default block so hand placed blocks work out of the box
+	BlockTable = nullptr;
+	BlockTypes.SetNum(2);
+	BlockTypes[FVoxelChunk::Air].Name = TEXT("Air");
+	BlockTypes[FVoxelChunk::Air].Resistance = 0.f;
+	BlockTypes[1].Name = TEXT("Default");
+}
+
+AVoxelWorld* AVoxelWorld::Get(const UObject* WorldContextObject)
+{
+	AMCUEGameMode* GameMode = Cast<AMCUEGameMode>(UGameplayStatics::GetGameMode(WorldContextObject));
+
+	return GameMode != nullptr ? GameMode->GetVoxelWorld() : nullptr;
+}
+
+void AVoxelWorld::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	if (BlockTable != nullptr)
+	{
+		BlockRegistry.Build(*BlockTable);
+	}
+	else if (BlockTypes.Num() > 0)
+	{
+		BlockRegistry.Build(BlockTypes);
+	}
+
+	BlockTicks = MakeUnique<FVoxelBlockTicks>(BlockRegistry, TerrainSettings.Seed);
+	Fluids = MakeUnique<FVoxelFluids>(BlockRegistry);
+}
+
+// Called when the game starts or when spawned
+void AVoxelWorld::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// the engine cube is 100 units wide
+	CrackOverlay->SetWorldScale3D(FVector(BlockSize * 1.002f / 100.f));
+
+	// without a crack material the overlay would be the cube's own opaque material hiding the block
+	if (CrackOverlayMaterial != nullptr)
+	{
+		CrackOverlayMaterialInstance = CrackOverlay->CreateDynamicMaterialInstance(0, CrackOverlayMaterial);
+	}
+
+	if (bLighting)
+	{
+		Lighting = MakeUnique<FVoxelLighting>(BlockRegistry);
+		LightingRegistry = MakeShared<FBlockRegistry, ESPMode::ThreadSafe>(BlockRegistry);
+	}
+
+	// chunks are requested around the player from the first tick on
+	if (bGenerateTerrain)
+	{
+		TerrainGenerator = MakeShared<FTerrainGenerator, ESPMode::ThreadSafe>(TerrainSettings, BlockRegistry);
+
+		// only generated worlds are saved, hand built levels come back from the level itself
+		if (bSaveWorld)
+		{
+			// chunks are stored as what the player changed, loads regenerate them and patch the changes in
+			RegionStore = MakeShared<FVoxelRegionStore, ESPMode::ThreadSafe>(FPaths::ProjectSavedDir() / TEXT("Voxel") / SaveName, SaveCompressionFormat,
+				MakeShared<FBlockRegistry, ESPMode::ThreadSafe>(BlockRegistry), TerrainGenerator);
+		}
+	}
+}
+
+void AVoxelWorld::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// the batch reads the chunks that are about to go away, and blocks set while it ran still get saved
+	FinishLighting();
+
+	if (RegionStore.IsValid())
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		const int32 NumUnsaved = UnsavedChunks.Num();
+
+		SaveWorld(true);
+
+		UE_LOG(LogVoxel, Log, TEXT("Saved %d unsaved chunks to %s in %.1f ms"),
+			NumUnsaved, *RegionStore->GetDirectory(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void AVoxelWorld::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SCOPE_CYCLE_COUNTER(STAT_ChunkStreaming);
+
+	// chunks are only edited, added, dropped and meshed while no light batch is reading them
+	FinishLighting();
+
+	// block ticks have their own budget, the edits they make are meshed with the streaming budget below
+	TickBlocks(DeltaTime);
+
+	const double Deadline = FPlatformTime::Seconds() + StreamingBudgetMs / 1000.0;
+
+	UpdateStreaming();
+
+	const int32 UnloadRadius = GenerationRadius + UnloadHysteresis;
+
+	TUniquePtr<FVoxelChunk> GeneratedChunk;
+	while (FPlatformTime::Seconds() < Deadline && GeneratedChunks->Dequeue(GeneratedChunk))
+	{
+		// the player may have walked away while the chunk was being built
+		if (!IsInStreamingRange(GeneratedChunk->Coord, UnloadRadius))
+		{
+			PendingChunks.Remove(GeneratedChunk->Coord);
+			continue;
+		}
+
+		AddGeneratedChunk(MoveTemp(GeneratedChunk));
+	}
+
+	while (FPlatformTime::Seconds() < Deadline && ChunksToUnload.Num() > 0)
+	{
+		UnloadChunk(ChunksToUnload.Pop(false));
+	}
+
+	// loads see queued chunks, so unloaded edits can be written whenever the worker gets to them
+	UpdateSaving(DeltaTime);
+
+	// edits only mark chunks dirty, so a burst of changes to one chunk costs a single remesh.
+	// Closest chunks go first so the player's own edits show up even when the budget runs out.
+	if (DirtyChunks.Num() > 0)
+	{
+		TArray<FIntPoint> ChunksToRebuild = DirtyChunks.Array();
+		ChunksToRebuild.Sort([this](const FIntPoint& A, const FIntPoint& B)
+		{
+			return (A - StreamingCenter).SizeSquared() < (B - StreamingCenter).SizeSquared();
+		});
+
+		int32 NumRebuilt = 0;
+
+		for (const FIntPoint& ChunkCoord : ChunksToRebuild)
+		{
+			// always make some progress, however small the budget
+			if (NumRebuilt > 0 && FPlatformTime::Seconds() >= Deadline)
+			{
+				break;
+			}
+
+			RebuildChunkMesh(ChunkCoord);
+			DirtyChunks.Remove(ChunkCoord);
+			++NumRebuilt;
+		}
+	}
+
+	if (FPlatformTime::Seconds() > Deadline)
+	{
+		++NumBudgetOverruns;
+		INC_DWORD_STAT(STAT_StreamingBudgetOverruns);
+	}
+
+	UpdateVisibility();
+
+	// runs while the rest of the frame goes on, its light shows up in next frame's meshes
+	StartLighting();
+
+	SET_DWORD_STAT(STAT_ChunksLoaded, Chunks.Num());
+	SET_DWORD_STAT(STAT_ChunksQueued, ChunkQueue.Num());
+	SET_DWORD_STAT(STAT_ChunksGenerating, PendingChunks.Num());
+	SET_DWORD_STAT(STAT_ChunksDirty, DirtyChunks.Num());
+
+	UpdatePoolStats();
+}
+
+void AVoxelWorld::UpdatePoolStats() const
+{
+	int64 BytesInUse = 0;
+	int64 HighWaterBytes = 0;
+	int64 SlabBytes = 0;
+	int32 NumFallbacks = 0;
+
+	// high water marks of pools that peaked at different times, so the sum is an upper bound
+	FVoxelPools::ForEachPool([&](const FVoxelBufferPool& Pool)
+	{
+		const FVoxelPoolStats Stats = Pool.GetStats();
+
+		BytesInUse += (int64)Stats.NumInUse * Pool.GetBufferSize();
+		HighWaterBytes += (int64)Stats.HighWater * Pool.GetBufferSize();
+		SlabBytes += Stats.SlabBytes;
+		NumFallbacks += Stats.NumFallbacks;
+	});
+
+	SET_MEMORY_STAT(STAT_PoolBytesInUse, BytesInUse);
+	SET_MEMORY_STAT(STAT_PoolHighWaterBytes, HighWaterBytes);
+	SET_MEMORY_STAT(STAT_PoolSlabBytes, SlabBytes);
+	SET_DWORD_STAT(STAT_PoolFallbacks, NumFallbacks);
+}
+
+void AVoxelWorld::TickBlocks(float DeltaTime)
+{
+	if (!BlockTicks.IsValid() || BlockTickRate <= 0.f)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_BlockTicks);
+
+	const float TickInterval = 1.f / BlockTickRate;
+	const double Deadline = FPlatformTime::Seconds() + BlockTickBudgetMs / 1000.0;
+	BlockTickTime += DeltaTime;
+
+	int32 NumScheduledRun = 0;
+	int32 NumRandomRun = 0;
+
+	for (int32 GameTick = 0; GameTick < MaxGameTicksPerFrame && BlockTickTime >= TickInterval; ++GameTick)
+	{
+		BlockTickTime -= TickInterval;
+
+		BlockTicks->Tick(RandomTicksPerSection, BlockTickBudget, Deadline,
+			[this](const FIntPoint& ChunkCoord) { return FindChunk(ChunkCoord); },
+			[this](const FIntVector& Block, uint16 BlockType, bool bRandom) { RunBlockTick(Block, BlockType, bRandom); });
+
+		NumScheduledRun += BlockTicks->GetNumScheduledTicksRun();
+		NumRandomRun += BlockTicks->GetNumRandomTicksRun();
+	}
+
+	BlockTickTime = FMath::Min(BlockTickTime, TickInterval);
+
+	SET_DWORD_STAT(STAT_ScheduledBlockTicks, BlockTicks->GetNumScheduledTicks());
+	SET_DWORD_STAT(STAT_ScheduledTickChunks, BlockTicks->GetNumScheduledChunks());
+	SET_DWORD_STAT(STAT_RandomTickChunks, BlockTicks->GetNumRandomTickChunks());
+	SET_DWORD_STAT(STAT_ScheduledTicksRun, NumScheduledRun);
+	SET_DWORD_STAT(STAT_RandomTicksRun, NumRandomRun);
+	SET_DWORD_STAT(STAT_BlockTickBudgetOverruns, BlockTicks->GetNumBudgetOverruns());
+}
+
+void AVoxelWorld::RunBlockTick(const FIntVector& Block, uint16 BlockType, bool bRandom)
+{
+	// scheduled ticks on air and fluid come from FVoxelFluids reacting to a change nearby
+	if (!bRandom && (BlockType == FVoxelChunk::Air || BlockRegistry.IsFluid(BlockType)))
+	{
+		Fluids->UpdateCell(Block,
+			[this](const FIntVector& Cell) { return GetBlock(Cell); },
+			[this](const FIntVector& Cell, uint16 CellType) { SetBlock(Cell, CellType); });
+	}
+
+	// falling blocks move on the ticks scheduled when they lost their support, never on random ones
+	if (!bRandom && GetBlockType(BlockType).bFalls)
+	{
+		const FIntVector Below = Block - FIntVector(0, 0, 1);
+
+		if (Below.Z >= 0 && GetBlock(Below) == FVoxelChunk::Air)
+		{
+			// both edits schedule the next step, for the block that fell and for whatever sat on top of it
+			SetBlock(Block, FVoxelChunk::Air);
+			SetBlock(Below, BlockType);
+
+			OnBlockTick.Broadcast(Below, BlockType, bRandom);
+			return;
+		}
+	}
+
+	OnBlockTick.Broadcast(Block, BlockType, bRandom);
+}
+
+void AVoxelWorld::ScheduleBlockTick(const FIntVector& Block, int32 Delay)
+{
+	if (BlockTicks.IsValid())
+	{
+		BlockTicks->ScheduleTick(Block, GetBlock(Block), Delay);
+	}
+}
+
+void AVoxelWorld::FinishLighting()
+{
+	if (LightingTask.IsValid())
+	{
+		// what the game thread loses to the batch, it should have finished during the last frame
+		if (!LightingTask.IsReady())
+		{
+			SCOPE_CYCLE_COUNTER(STAT_LightBatchWait);
+			INC_DWORD_STAT(STAT_LightBatchWaits);
+
+			LightingTask.Wait();
+		}
+
+		LightingTask = TFuture<void>();
+	}
+
+	// nothing reads the chunks anymore, the blocks set while the batch ran go in now in their order
+	if (QueuedBlockEdits.Num() > 0)
+	{
+		const TArray<TPair<FIntVector, uint16>> Edits = MoveTemp(QueuedBlockEdits);
+		QueuedBlockEdits.Reset();
+
+		for (const TPair<FIntVector, uint16>& Edit : Edits)
+		{
+			SetBlock(Edit.Key, Edit.Value);
+		}
+	}
+
+	if (!Lighting.IsValid())
+	{
+		return;
+	}
+
+	DirtyChunks.Append(ChunksInLightBatch);
+	ChunksInLightBatch.Reset();
+
+	for (const FIntPoint& ChunkCoord : Lighting->ConsumeChangedChunks())
+	{
+		if (FindChunk(ChunkCoord) != nullptr)
+		{
+			MarkChunkDirty(ChunkCoord, false);
+		}
+	}
+}
+
+void AVoxelWorld::StartLighting()
+{
+	if (!Lighting.IsValid())
+	{
+		return;
+	}
+
+	SET_DWORD_STAT(STAT_LightUpdatesQueued, Lighting->GetNumPendingUpdates());
+
+	ChunksInLightBatch.Append(ChunksAwaitingLight);
+	ChunksAwaitingLight.Reset();
+
+	if (!Lighting->HasPendingUpdates())
+	{
+		return;
+	}
+
+	// joined in FinishLighting or EndPlay, so the world outlives the task
+	LightingTask = Async(EAsyncExecution::ThreadPool, [this]()
+	{
+		SCOPE_CYCLE_COUNTER(STAT_VoxelLighting);
+
+		// SetBlock queues its blocks while this runs and bulk edits finish the batch before they write,
+		// the lock only keeps out writers that don't go through either
+		FRWScopeLock Lock(ChunksLock, SLT_ReadOnly);
+
+		const int32 NumChangedCells = Lighting->Update([this](const FIntPoint& ChunkCoord) { return FindChunk(ChunkCoord); });
+
+		SET_DWORD_STAT(STAT_LightCellsChanged, NumChangedCells);
+	});
+}
+
+void AVoxelWorld::UpdateStreaming()
+{
+	FVector ViewLocation = GetActorLocation();
+	FVector ViewDirection = GetActorForwardVector();
+
+	if (APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this, 0))
+	{
+		ViewLocation = CameraManager->GetCameraLocation();
+		ViewDirection = CameraManager->GetCameraRotation().Vector();
+	}
+
+	// cave culling follows the camera in hand built worlds too
+	ViewBlock = WorldToBlock(ViewLocation);
+
+	if (!TerrainGenerator.IsValid())
+	{
+		return;
+	}
+
+	const FIntPoint Center = FVoxelChunk::ToChunkCoord(ViewBlock);
+
+	FVector2D View(ViewDirection.X, ViewDirection.Y);
+	View = View.IsNearlyZero() ? StreamingView : View.GetSafeNormal();
+
+	// sorting again is only worth it once the player crossed into another chunk or turned around noticeably
+	if (!bStreamingStarted || Center != StreamingCenter || FVector2D::DotProduct(View, StreamingView) < RequeueViewDot)
+	{
+		bStreamingStarted = true;
+		StreamingCenter = Center;
+		StreamingView = View;
+
+		ChunkQueue.Reset();
+
+		for (int32 Y = -GenerationRadius; Y <= GenerationRadius; ++Y)
+		{
+			for (int32 X = -GenerationRadius; X <= GenerationRadius; ++X)
+			{
+				const FIntPoint ChunkCoord = Center + FIntPoint(X, Y);
+
+				if (IsInStreamingRange(ChunkCoord, GenerationRadius) && !IsChunkLoaded(ChunkCoord) && !PendingChunks.Contains(ChunkCoord))
+				{
+					ChunkQueue.Emplace(ChunkCoord, GetChunkPriority(ChunkCoord));
+				}
+			}
+		}
+
+		ChunkQueue.Heapify();
+
+		const int32 UnloadRadius = GenerationRadius + UnloadHysteresis;
+
+		ChunksToUnload.Reset();
+
+		// without a save, edited chunks stay, dropping them would lose the player's changes
+		for (const TPair<FIntPoint, TUniquePtr<FVoxelChunk>>& Pair : Chunks)
+		{
+			if (Pair.Value->bPopulated && (!Pair.Value->bModified || RegionStore.IsValid()) && !IsInStreamingRange(Pair.Key, UnloadRadius))
+			{
+				ChunksToUnload.Add(Pair.Key);
+			}
+		}
+	}
+
+	while (PendingChunks.Num() < MaxPendingChunks && ChunkQueue.Num() > 0)
+	{
+		FChunkRequest Request = ChunkQueue[0];
+		ChunkQueue.HeapPopDiscard();
+
+		RequestChunk(Request.Coord);
+	}
+}
+
+float AVoxelWorld::GetChunkPriority(const FIntPoint& ChunkCoord) const
+{
+	const FVector2D Offset(ChunkCoord - StreamingCenter);
+	const float Distance = Offset.Size();
+
+	if (Distance <= 0.f)
+	{
+		return 0.f;
+	}
+
+	// 0 straight ahead, 1 straight behind
+	const float Behind = (1.f - FVector2D::DotProduct(Offset / Distance, StreamingView)) * 0.5f;
+
+	return Distance * (1.f + BehindViewPenalty * Behind);
+}
+
+bool AVoxelWorld::IsInStreamingRange(const FIntPoint& ChunkCoord, int32 Radius) const
+{
+	return (ChunkCoord - StreamingCenter).SizeSquared() <= Radius * Radius;
+}
+
+void AVoxelWorld::UnloadChunk(const FIntPoint& ChunkCoord)
+{
+	TUniquePtr<FVoxelChunk> Chunk;
+
+	{
+		FRWScopeLock Lock(ChunksLock, SLT_Write);
+
+		TUniquePtr<FVoxelChunk>* Slot = Chunks.Find(ChunkCoord);
+
+		if (Slot == nullptr)
+		{
+			return;
+		}
+
+		Chunk = MoveTemp(*Slot);
+		Chunks.Remove(ChunkCoord);
+	}
+
+	// neighbours keep their mesh, the faces they hid towards us are at the edge of the loaded area anyway
+	UProceduralMeshComponent* ChunkMesh = nullptr;
+	if (ChunkMeshes.RemoveAndCopyValue(ChunkCoord, ChunkMesh) && ChunkMesh != nullptr)
+	{
+		ChunkMesh->DestroyComponent();
+	}
+
+	DirtyChunks.Remove(ChunkCoord);
+
+	// the walk no longer gets through this chunk
+	ChunkVisibility.Remove(ChunkCoord);
+	bVisibilityDirty = true;
+
+	// scheduled ticks aren't saved, blocks waiting to fall stay put until a neighbour changes again
+	if (BlockTicks.IsValid())
+	{
+		BlockTicks->RemoveChunk(ChunkCoord);
+	}
+
+	if (RenderMode == EVoxelRenderMode::InstancedMesh)
+	{
+		for (int32 Z = 0; Z < FVoxelChunk::SizeZ; ++Z)
+		{
+			for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+			{
+				for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+				{
+					const uint16 BlockType = Chunk->GetBlock(X, Y, Z);
+
+					if (BlockType != FVoxelChunk::Air && BlockInstances.IsValidIndex(BlockType) && BlockInstances[BlockType] != nullptr)
+					{
+						const FIntVector Block(ChunkCoord.X * FVoxelChunk::SizeX + X, ChunkCoord.Y * FVoxelChunk::SizeY + Y, Z);
+						BlockInstances[BlockType]->RemoveBlock(BlockInstances[BlockType]->FindBlockInstance(Block));
+					}
+				}
+			}
+		}
+
+		// the neighbours' border blocks face the edge of the loaded area now
+		RefreshBorderInstances(ChunkCoord);
+	}
+
+	// nothing else refers to the chunk anymore, so it becomes the snapshot without a copy
+	if (UnsavedChunks.Remove(ChunkCoord) > 0)
+	{
+		RegionStore->AddPendingChunk(FVoxelRegionStore::FChunkSnapshot(Chunk.Release()));
+	}
+}
+
+void AVoxelWorld::UpdateSaving(float DeltaTime)
+{
+	if (!RegionStore.IsValid())
+	{
+		return;
+	}
+
+	AutosaveTime += DeltaTime;
+
+	if (AutosaveInterval > 0.f && AutosaveTime >= AutosaveInterval && UnsavedChunks.Num() > 0)
+	{
+		SnapshotUnsavedChunks();
+		AutosaveTime = 0.f;
+	}
+
+	StartSaveTask();
+
+	SET_DWORD_STAT(STAT_ChunksUnsaved, UnsavedChunks.Num());
+	SET_DWORD_STAT(STAT_ChunksAwaitingWrite, RegionStore->GetNumPendingChunks());
+}
+
+void AVoxelWorld::SnapshotUnsavedChunks()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SaveSnapshot);
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	// the copies only cover blocks, the worker never touches the live chunks. Not MakeShared, that
+	// would put the chunk in the reference counter's allocation instead of the chunk pool.
+	for (const FIntPoint& ChunkCoord : UnsavedChunks)
+	{
+		if (const FVoxelChunk* Chunk = FindChunk(ChunkCoord))
+		{
+			TSharedRef<FVoxelChunk, ESPMode::ThreadSafe> Snapshot(new FVoxelChunk(ChunkCoord));
+			Snapshot->CopyBlocksFrom(*Chunk);
+
+			RegionStore->AddPendingChunk(Snapshot);
+		}
+	}
+
+	UnsavedChunks.Reset();
+
+	LastSnapshotSeconds = FPlatformTime::Seconds() - StartTime;
+}
+
+void AVoxelWorld::StartSaveTask()
+{
+	if (SaveTask.IsValid())
+	{
+		if (!SaveTask.IsReady())
+		{
+			return;
+		}
+
+		SaveTask = TFuture<void>();
+	}
+
+	if (RegionStore->GetNumPendingChunks() == 0)
+	{
+		return;
+	}
+
+	// the store is shared, so a write still running when the world goes away finishes on its own
+	TSharedPtr<FVoxelRegionStore, ESPMode::ThreadSafe> Store = RegionStore;
+
+	SaveTask = Async(EAsyncExecution::ThreadPool, [Store]()
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SaveWrite);
+
+		const FVoxelRegionWriteStats Before = Store->GetWriteStats();
+		const int32 NumWritten = Store->WritePendingChunks();
+		const FVoxelRegionWriteStats After = Store->GetWriteStats();
+
+		const double Seconds = After.Seconds - Before.Seconds;
+		const double Megabytes = (After.NumBytes - Before.NumBytes) / (1024.0 * 1024.0);
+
+		SET_FLOAT_STAT(STAT_SaveWriteThroughput, Seconds > 0.0 ? Megabytes / Seconds : 0.0);
+
+		UE_LOG(LogVoxel, Verbose, TEXT("Wrote %d chunks to %d regions in %.1f ms, %.1f MB/s"),
+			NumWritten, After.NumRegions - Before.NumRegions, Seconds * 1000.0, Seconds > 0.0 ? Megabytes / Seconds : 0.0);
+	});
+}
+
+void AVoxelWorld::SaveWorld(bool bWaitForWrite)
+{
+	if (!RegionStore.IsValid())
+	{
+		return;
+	}
+
+	SnapshotUnsavedChunks();
+	AutosaveTime = 0.f;
+
+	if (!bWaitForWrite)
+	{
+		StartSaveTask();
+		return;
+	}
+
+	// a running write may have picked up only part of the queue, whatever it left is written here
+	if (SaveTask.IsValid())
+	{
+		SaveTask.Wait();
+		SaveTask = TFuture<void>();
+	}
+
+	RegionStore->WritePendingChunks();
+}
+
+FVoxelRegionWriteStats AVoxelWorld::GetSaveWriteStats() const
+{
+	return RegionStore.IsValid() ? RegionStore->GetWriteStats() : FVoxelRegionWriteStats();
+}
+
+int32 AVoxelWorld::VerifySave(int32& OutNumChecked) const
+{
+	OutNumChecked = 0;
+
+	if (!RegionStore.IsValid())
+	{
+		return 0;
+	}
+
+	int32 NumFailed = 0;
+	TArray<uint8> Encoded;
+
+	for (const TPair<FIntPoint, TUniquePtr<FVoxelChunk>>& Pair : Chunks)
+	{
+		const FVoxelChunk& Live = *Pair.Value;
+
+		if (!Live.bPopulated || !Live.bModified)
+		{
+			continue;
+		}
+
+		++OutNumChecked;
+
+		const uint32 LiveCrc = Live.GetBlocksCrc();
+
+		// what the next save of the chunk would write
+		FVoxelChunk Decoded(Pair.Key);
+		const bool bChanges = FVoxelRegionFile::EncodeChunk(Live, TerrainGenerator.Get(), Encoded);
+		bool bFailed = !FVoxelRegionFile::DecodeChunk(Encoded, bChanges, BlockRegistry, TerrainGenerator.Get(), Decoded) || Decoded.GetBlocksCrc() != LiveCrc;
+
+		// what the save holds, chunks edited since their last snapshot differ from it on purpose
+		if (!bFailed && !UnsavedChunks.Contains(Pair.Key))
+		{
+			FVoxelChunk Saved(Pair.Key);
+			bFailed = !RegionStore->LoadChunk(Saved) || Saved.GetBlocksCrc() != LiveCrc;
+		}
+
+		if (bFailed)
+		{
+			UE_LOG(LogVoxel, Warning, TEXT("Chunk %d,%d doesn't survive a save round trip"), Pair.Key.X, Pair.Key.Y);
+			++NumFailed;
+		}
+	}
+
+	return NumFailed;
+}
+
+FVoxelChunk* AVoxelWorld::FindChunk(const FIntPoint& ChunkCoord) const
+{
+	const TUniquePtr<FVoxelChunk>* Chunk = Chunks.Find(ChunkCoord);
+
+	return Chunk != nullptr ? Chunk->Get() : nullptr;
+}
+
+FVoxelChunk& AVoxelWorld::FindOrAddChunk(const FIntPoint& ChunkCoord)
+{
+	TUniquePtr<FVoxelChunk>& Chunk = Chunks.FindOrAdd(ChunkCoord);
+
+	if (!Chunk.IsValid())
+	{
+		Chunk = MakeUnique<FVoxelChunk>(ChunkCoord);
+	}
+
+	return *Chunk;
+}
+
+uint16 AVoxelWorld::GetBlock(const FIntVector& Block) const
+{
+	if ((uint32)Block.Z >= (uint32)FVoxelChunk::SizeZ)
+	{
+		return FVoxelChunk::Air;
+	}
+
+	const FVoxelChunk* Chunk = FindChunk(FVoxelChunk::ToChunkCoord(Block));
+
+	if (Chunk == nullptr)
+	{
+		return FVoxelChunk::Air;
+	}
+
+	const FIntVector Local = FVoxelChunk::ToLocal(Block);
+	return Chunk->GetBlock(Local.X, Local.Y, Local.Z);
+}
+
+void AVoxelWorld::SetBlock(const FIntVector& Block, uint16 BlockType)
+{
+	if ((uint32)Block.Z >= (uint32)FVoxelChunk::SizeZ || !BlockRegistry.IsValidId(BlockType))
+	{
+		return;
+	}
+
+	// the light batch is reading the chunks, waiting for it would stall the frame. Once something
+	// is queued everything after it queues too, so edits to the same block keep their order.
+	if (QueuedBlockEdits.Num() > 0 || (LightingTask.IsValid() && !LightingTask.IsReady()))
+	{
+		QueuedBlockEdits.Emplace(Block, BlockType);
+		INC_DWORD_STAT(STAT_QueuedBlockEdits);
+		return;
+	}
+
+	const uint16 OldBlockType = GetBlock(Block);
+
+	if (OldBlockType == BlockType)
+	{
+		return;
+	}
+
+	const FIntPoint ChunkCoord = FVoxelChunk::ToChunkCoord(Block);
+	const FIntVector Local = FVoxelChunk::ToLocal(Block);
+
+	{
+		FRWScopeLock Lock(ChunksLock, SLT_Write);
+
+		if (BlockType == FVoxelChunk::Air)
+		{
+			// clearing a cell never needs to create the chunk it lives in
+			if (FVoxelChunk* Chunk = FindChunk(ChunkCoord))
+			{
+				Chunk->SetBlock(Local.X, Local.Y, Local.Z, BlockType);
+				Chunk->bModified = true;
+			}
+		}
+		else
+		{
+			FVoxelChunk& Chunk = FindOrAddChunk(ChunkCoord);
+			Chunk.SetBlock(Local.X, Local.Y, Local.Z, BlockType);
+			Chunk.bModified = true;
+		}
+
+		// columns that only hold hand placed blocks come back with the level, they are saved once the terrain joins them
+		const FVoxelChunk* EditedChunk = FindChunk(ChunkCoord);
+
+		if (RegionStore.IsValid() && EditedChunk != nullptr && EditedChunk->bPopulated)
+		{
+			UnsavedChunks.Add(ChunkCoord);
+		}
+
+		// only the light around this block is redone, with the next batch
+		if (Lighting.IsValid())
+		{
+			Lighting->AddBlockChange(Block, OldBlockType, BlockType);
+		}
+	}
+
+	if (BlockType == FVoxelChunk::Air)
+	{
+		ABlock* BlockActor = nullptr;
+		if (BlockActors.RemoveAndCopyValue(Block, BlockActor) && BlockActor != nullptr)
+		{
+			BlockActor->Destroy();
+		}
+	}
+
+	if (BreakingStages.Remove(Block) > 0)
+	{
+		ApplyCrackingValue(Block, 1.0f);
+	}
+
+	MarkBlockDirty(Block);
+	UpdateBlockInstance(Block, OldBlockType, BlockType);
+	WakeBlockTicks(Block, OldBlockType, BlockType);
+
+	OnBlockChanged.Broadcast(Block);
+}
+
+void AVoxelWorld::WakeBlockTicks(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType)
+{
+	if (!BlockTicks.IsValid())
+	{
+		return;
+	}
+
+	BlockTicks->OnBlockChanged(Block, NewBlockType);
+	Fluids->OnBlockChanged(Block, OldBlockType, NewBlockType, [this](const FIntVector& Cell) { return GetBlock(Cell); }, *BlockTicks);
+
+	// falling blocks check for air below once placed, and once the block they stand on is gone
+	if (GetBlockType(NewBlockType).bFalls)
+	{
+		BlockTicks->ScheduleTick(Block, NewBlockType, FallTickDelay);
+	}
+
+	const FIntVector Above = Block + FIntVector(0, 0, 1);
+	const uint16 AboveBlockType = GetBlock(Above);
+
+	if (NewBlockType == FVoxelChunk::Air && GetBlockType(AboveBlockType).bFalls)
+	{
+		BlockTicks->ScheduleTick(Above, AboveBlockType, FallTickDelay);
+	}
+}
+
+int32 AVoxelWorld::FillBox(const FIntVector& Min, const FIntVector& Max, uint16 BlockType)
+{
+	if (!BlockRegistry.IsValidId(BlockType))
+	{
+		return 0;
+	}
+
+	return EditBox(Min, Max, [BlockType](const FIntVector& Block, uint16 OldBlockType) { return BlockType; });
+}
+
+int32 AVoxelWorld::ReplaceBlocks(const FIntVector& Min, const FIntVector& Max, uint16 FromBlockType, uint16 ToBlockType)
+{
+	if (!BlockRegistry.IsValidId(ToBlockType))
+	{
+		return 0;
+	}
+
+	return EditBox(Min, Max, [FromBlockType, ToBlockType](const FIntVector& Block, uint16 OldBlockType)
+	{
+		return OldBlockType == FromBlockType ? ToBlockType : OldBlockType;
+	});
+}
+
+int32 AVoxelWorld::FillSphere(const FIntVector& Center, int32 Radius, uint16 BlockType)
+{
+	if (!BlockRegistry.IsValidId(BlockType) || Radius < 0)
+	{
+		return 0;
+	}
+
+	const FIntVector Extent(Radius);
+
+	return EditBox(Center - Extent, Center + Extent, [&Center, Radius, BlockType](const FIntVector& Block, uint16 OldBlockType)
+	{
+		const FIntVector Offset = Block - Center;
+		return Offset.X * Offset.X + Offset.Y * Offset.Y + Offset.Z * Offset.Z <= Radius * Radius ? BlockType : OldBlockType;
+	});
+}
+
+int32 AVoxelWorld::Explode(const FIntVector& Center, int32 Radius, float Power)
+{
+	if (Radius < 0)
+	{
+		return 0;
+	}
+
+	const FIntVector Extent(Radius);
+
+	return EditBox(Center - Extent, Center + Extent, [this, &Center, Radius, Power](const FIntVector& Block, uint16 OldBlockType)
+	{
+		if (OldBlockType == FVoxelChunk::Air || BlockRegistry.IsFluid(OldBlockType))
+		{
+			return OldBlockType;
+		}
+
+		const FIntVector Offset = Block - Center;
+		const float Distance = FMath::Sqrt((float)(Offset.X * Offset.X + Offset.Y * Offset.Y + Offset.Z * Offset.Z));
+
+		// one block past the radius so blocks on the edge still feel some of it
+		const float Blast = Power * (1.f - Distance / (Radius + 1));
+
+		return GetBlockType(OldBlockType).Resistance < Blast ? FVoxelChunk::Air : OldBlockType;
+	});
+}
+
+void AVoxelWorld::CopyBlocks(const FIntVector& Min, const FIntVector& Max, FVoxelClipboard& OutClipboard) const
+{
+	FVoxelEdit::Copy(Min, Max, [this](const FIntPoint& ChunkCoord) { return FindChunk(ChunkCoord); }, OutClipboard);
+}
+
+int32 AVoxelWorld::PasteBlocks(const FVoxelClipboard& Clipboard, const FIntVector& Origin, bool bSkipAir)
+{
+	if (Clipboard.IsEmpty())
+	{
+		return 0;
+	}
+
+	return EditBox(Origin, Origin + Clipboard.Size - FIntVector(1), [this, &Clipboard, &Origin, bSkipAir](const FIntVector& Block, uint16 OldBlockType)
+	{
+		const uint16 BlockType = Clipboard.Blocks[Clipboard.GetIndex(Block - Origin)];
+
+		// clipboards may come from a world with more block types
+		return (bSkipAir && BlockType == FVoxelChunk::Air) || !BlockRegistry.IsValidId(BlockType) ? OldBlockType : BlockType;
+	});
+}
+
+void AVoxelWorld::BeginEdit()
+{
+	if (EditDepth++ == 0)
+	{
+		EditJournal.Reset();
+		ResetEditedChunks();
+	}
+}
+
+void AVoxelWorld::EndEdit()
+{
+	checkf(EditDepth > 0, TEXT("EndEdit without a BeginEdit"));
+
+	if (--EditDepth > 0)
+	{
+		return;
+	}
+
+	FinishEditedChunks();
+
+	if (EditJournal.IsEmpty())
+	{
+		return;
+	}
+
+	// what was taken back can't be applied on top of a new edit anymore
+	RedoJournals.Reset();
+
+	AddUndoJournal(MoveTemp(EditJournal));
+	EditJournal.Reset();
+}
+
+bool AVoxelWorld::UndoEdit()
+{
+	if (EditDepth > 0 || UndoJournals.Num() == 0)
+	{
+		return false;
+	}
+
+	const FVoxelEditJournal Journal = UndoJournals.Pop(false);
+	FVoxelEditJournal Redo;
+
+	ResetEditedChunks();
+
+	// waits for the light batch here like EditBox does, rather than inside the write lock
+	FinishLighting();
+
+	{
+		FRWScopeLock Lock(ChunksLock, SLT_Write);
+
+		FVoxelEdit::Undo(Journal, [this](const FIntPoint& ChunkCoord) { return FindChunk(ChunkCoord); },
+			[this](const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType) { OnBulkBlockChanged(Block, OldBlockType, NewBlockType); }, Redo);
+	}
+
+	FinishEditedChunks();
+
+	RedoJournals.Add(MoveTemp(Redo));
+	return true;
+}
+
+bool AVoxelWorld::RedoEdit()
+{
+	if (EditDepth > 0 || RedoJournals.Num() == 0)
+	{
+		return false;
+	}
+
+	const FVoxelEditJournal Journal = RedoJournals.Pop(false);
+	FVoxelEditJournal Undo;
+
+	ResetEditedChunks();
+
+	// waits for the light batch here like EditBox does, rather than inside the write lock
+	FinishLighting();
+
+	{
+		FRWScopeLock Lock(ChunksLock, SLT_Write);
+
+		FVoxelEdit::Undo(Journal, [this](const FIntPoint& ChunkCoord) { return FindChunk(ChunkCoord); },
+			[this](const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType) { OnBulkBlockChanged(Block, OldBlockType, NewBlockType); }, Undo);
+	}
+
+	FinishEditedChunks();
+
+	AddUndoJournal(MoveTemp(Undo));
+	return true;
+}
+
+SIZE_T AVoxelWorld::GetUndoAllocatedSize() const
+{
+	SIZE_T Size = UndoJournals.GetAllocatedSize() + RedoJournals.GetAllocatedSize();
+
+	for (const FVoxelEditJournal& Journal : UndoJournals)
+	{
+		Size += Journal.GetAllocatedSize();
+	}
+
+	for (const FVoxelEditJournal& Journal : RedoJournals)
+	{
+		Size += Journal.GetAllocatedSize();
+	}
+
+	return Size;
+}
+
+void AVoxelWorld::FlushEdits()
+{
+	// the batch in flight, then one with everything queued while it ran
+	FinishLighting();
+	StartLighting();
+	FinishLighting();
+
+	for (const FIntPoint& ChunkCoord : DirtyChunks)
+	{
+		RebuildChunkMesh(ChunkCoord);
+	}
+
+	DirtyChunks.Reset();
+}
+
+int32 AVoxelWorld::EditBox(const FIntVector& Min, const FIntVector& Max, FVoxelEdit::FEditBlock Edit)
+{
+	BeginEdit();
+
+	int32 NumChanged = 0;
+
+	// a bulk edit can't be queued like SetBlock, so it waits for the light batch here where the wait is counted
+	FinishLighting();
+
+	{
+		// held through the callbacks as well, they queue light changes like SetBlock does under the lock
+		FRWScopeLock Lock(ChunksLock, SLT_Write);
+
+		NumChanged = FVoxelEdit::EditBox(Min, Max, [this](const FIntPoint& ChunkCoord) { return FindChunk(ChunkCoord); }, Edit,
+			[this](const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType) { OnBulkBlockChanged(Block, OldBlockType, NewBlockType); }, EditJournal);
+	}
+
+	EndEdit();
+
+	return NumChanged;
+}
+
+void AVoxelWorld::OnBulkBlockChanged(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType)
+{
+	EditMin = FIntVector(FMath::Min(EditMin.X, Block.X), FMath::Min(EditMin.Y, Block.Y), FMath::Min(EditMin.Z, Block.Z));
+	EditMax = FIntVector(FMath::Max(EditMax.X, Block.X), FMath::Max(EditMax.Y, Block.Y), FMath::Max(EditMax.Z, Block.Z));
+	EditedChunks.Add(FVoxelChunk::ToChunkCoord(Block));
+
+	if (NewBlockType == FVoxelChunk::Air && BlockActors.Num() > 0)
+	{
+		ABlock* BlockActor = nullptr;
+		if (BlockActors.RemoveAndCopyValue(Block, BlockActor) && BlockActor != nullptr)
+		{
+			BlockActor->Destroy();
+		}
+	}
+
+	if (BreakingStages.Num() > 0 && BreakingStages.Remove(Block) > 0)
+	{
+		ApplyCrackingValue(Block, 1.0f);
+	}
+
+	UpdateBlockInstance(Block, OldBlockType, NewBlockType);
+	WakeBlockTicks(Block, OldBlockType, NewBlockType);
+}
+
+void AVoxelWorld::ResetEditedChunks()
+{
+	EditMin = FIntVector(MAX_int32);
+	EditMax = FIntVector(MIN_int32);
+	EditedChunks.Reset();
+}
+
+void AVoxelWorld::FinishEditedChunks()
+{
+	if (EditedChunks.Num() == 0)
+	{
+		return;
+	}
+
+	for (const FIntPoint& ChunkCoord : EditedChunks)
+	{
+		FVoxelChunk* Chunk = FindChunk(ChunkCoord);
+
+		if (Chunk == nullptr)
+		{
+			continue;
+		}
+
+		Chunk->bModified = true;
+
+		if (RegionStore.IsValid() && Chunk->bPopulated)
+		{
+			UnsavedChunks.Add(ChunkCoord);
+		}
+
+		// relit from scratch once in the next batch instead of following every block that changed
+		if (Lighting.IsValid())
+		{
+			Lighting->AddEditedChunk(ChunkCoord);
+		}
+
+		// one remesh per chunk once the batch with the edit's light is done. Neighbours are remeshed
+		// too, finding out which of them show a changed border costs more than meshing them.
+		if (RenderMode == EVoxelRenderMode::ChunkMesh)
+		{
+			TSet<FIntPoint>& ChunksToMark = Lighting.IsValid() ? ChunksAwaitingLight : DirtyChunks;
+
+			ChunksToMark.Add(ChunkCoord);
+			ChunksToMark.Add(ChunkCoord + FIntPoint(1, 0));
+			ChunksToMark.Add(ChunkCoord + FIntPoint(-1, 0));
+			ChunksToMark.Add(ChunkCoord + FIntPoint(0, 1));
+			ChunksToMark.Add(ChunkCoord + FIntPoint(0, -1));
+		}
+	}
+
+	OnBlocksChanged.Broadcast(EditMin, EditMax);
+	ResetEditedChunks();
+}
+
+void AVoxelWorld::AddUndoJournal(FVoxelEditJournal&& Journal)
+{
+	if (MaxUndoEdits <= 0)
+	{
+		return;
+	}
+
+	UndoJournals.Add(MoveTemp(Journal));
+
+	if (UndoJournals.Num() > MaxUndoEdits)
+	{
+		UndoJournals.RemoveAt(0, UndoJournals.Num() - MaxUndoEdits);
+	}
+}
+
+void AVoxelWorld::MarkBlockDirty(const FIntVector& Block)
+{
+	if (RenderMode != EVoxelRenderMode::ChunkMesh)
+	{
+		return;
+	}
+
+	const FIntPoint ChunkCoord = FVoxelChunk::ToChunkCoord(Block);
+	const FIntVector Local = FVoxelChunk::ToLocal(Block);
+
+	// meshing before the edit's light is in would only have to be done again
+	TSet<FIntPoint>& ChunksToMark = Lighting.IsValid() ? ChunksAwaitingLight : DirtyChunks;
+
+	ChunksToMark.Add(ChunkCoord);
+
+	// blocks on the border decide whether the neighbour shows its face towards us
+	if (Local.X == 0)
+	{
+		ChunksToMark.Add(ChunkCoord + FIntPoint(-1, 0));
+	}
+	else if (Local.X == FVoxelChunk::SizeX - 1)
+	{
+		ChunksToMark.Add(ChunkCoord + FIntPoint(1, 0));
+	}
+
+	if (Local.Y == 0)
+	{
+		ChunksToMark.Add(ChunkCoord + FIntPoint(0, -1));
+	}
+	else if (Local.Y == FVoxelChunk::SizeY - 1)
+	{
+		ChunksToMark.Add(ChunkCoord + FIntPoint(0, 1));
+	}
+}
+
+void AVoxelWorld::MarkChunkDirty(const FIntPoint& ChunkCoord, bool bIncludeNeighbours)
+{
+	if (RenderMode != EVoxelRenderMode::ChunkMesh)
+	{
+		return;
+	}
+
+	DirtyChunks.Add(ChunkCoord);
+
+	if (bIncludeNeighbours)
+	{
+		DirtyChunks.Add(ChunkCoord + FIntPoint(1, 0));
+		DirtyChunks.Add(ChunkCoord + FIntPoint(-1, 0));
+		DirtyChunks.Add(ChunkCoord + FIntPoint(0, 1));
+		DirtyChunks.Add(ChunkCoord + FIntPoint(0, -1));
+	}
+}
+
+bool AVoxelWorld::IsChunkLoaded(const FIntPoint& ChunkCoord) const
+{
+	const FVoxelChunk* Chunk = FindChunk(ChunkCoord);
+
+	return Chunk != nullptr && Chunk->bPopulated;
+}
+
+void AVoxelWorld::RequestChunk(const FIntPoint& ChunkCoord)
+{
+	if (!TerrainGenerator.IsValid() || IsChunkLoaded(ChunkCoord) || PendingChunks.Contains(ChunkCoord))
+	{
+		return;
+	}
+
+	PendingChunks.Add(ChunkCoord);
+
+	TSharedPtr<const FTerrainGenerator, ESPMode::ThreadSafe> Generator = TerrainGenerator;
+	TSharedPtr<FVoxelRegionStore, ESPMode::ThreadSafe> Store = RegionStore;
+	TSharedPtr<FGeneratedChunkQueue, ESPMode::ThreadSafe> Queue = GeneratedChunks;
+	TSharedPtr<const FBlockRegistry, ESPMode::ThreadSafe> Registry = LightingRegistry;
+
+	Async(EAsyncExecution::ThreadPool, [Generator, Store, Queue, Registry, ChunkCoord]()
+	{
+		TUniquePtr<FVoxelChunk> Chunk = MakeUnique<FVoxelChunk>(ChunkCoord);
+
+		// a saved copy holds the player's edits, only chunks that were never saved are generated
+		if (!Store.IsValid() || !Store->LoadChunk(*Chunk) || !Chunk->bPopulated)
+		{
+			Generator->GenerateChunk(*Chunk);
+			Chunk->bPopulated = true;
+			Chunk->bModified = false;
+		}
+
+		// light isn't saved, it only depends on the blocks. Light from the neighbours is added once the chunk is in the world.
+		if (Registry.IsValid())
+		{
+			FVoxelLighting::LightChunk(*Chunk, *Registry);
+		}
+
+		Queue->Enqueue(MoveTemp(Chunk));
+	});
+}
+
+void AVoxelWorld::AddGeneratedChunk(TUniquePtr<FVoxelChunk> Chunk)
+{
+	const FIntPoint ChunkCoord = Chunk->Coord;
+
+	PendingChunks.Remove(ChunkCoord);
+
+	{
+		FRWScopeLock Lock(ChunksLock, SLT_Write);
+
+		TUniquePtr<FVoxelChunk>& Slot = Chunks.FindOrAdd(ChunkCoord);
+
+		bool bMergedPlacedBlocks = false;
+
+		// blocks placed by hand before the terrain arrived win over the generated ones. A chunk
+		// loaded from the save already has them, along with every block broken since.
+		if (Slot.IsValid() && !Slot->IsEmpty() && !Chunk->bModified)
+		{
+			for (int32 Z = 0; Z < FVoxelChunk::SizeZ; ++Z)
+			{
+				for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+				{
+					for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+					{
+						const uint16 PlacedBlock = Slot->GetBlock(X, Y, Z);
+
+						if (PlacedBlock != FVoxelChunk::Air)
+						{
+							const uint16 GeneratedBlock = Chunk->GetBlock(X, Y, Z);
+
+							Chunk->SetBlock(X, Y, Z, PlacedBlock);
+							Chunk->bModified = true;
+							bMergedPlacedBlocks = true;
+
+							// the chunk was lit with the generated block
+							if (Lighting.IsValid() && GeneratedBlock != PlacedBlock)
+							{
+								Lighting->AddBlockChange(FIntVector(ChunkCoord.X * FVoxelChunk::SizeX + X, ChunkCoord.Y * FVoxelChunk::SizeY + Y, Z), GeneratedBlock, PlacedBlock);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		// a saved chunk comes with every block broken or replaced since it was saved, instances of
+		// blocks placed into the column before it arrived would stay on screen as ghosts
+		if (Slot.IsValid() && RenderMode == EVoxelRenderMode::InstancedMesh)
+		{
+			Slot->ForEachReplacedBlock(*Chunk, [this, &ChunkCoord](int32 X, int32 Y, int32 Z, uint16 BlockType)
+			{
+				if (BlockInstances.IsValidIndex(BlockType) && BlockInstances[BlockType] != nullptr)
+				{
+					const FIntVector Block(ChunkCoord.X * FVoxelChunk::SizeX + X, ChunkCoord.Y * FVoxelChunk::SizeY + Y, Z);
+					BlockInstances[BlockType]->RemoveBlock(BlockInstances[BlockType]->FindBlockInstance(Block));
+				}
+			});
+		}
+
+		Slot = MoveTemp(Chunk);
+
+		if (bMergedPlacedBlocks && RegionStore.IsValid())
+		{
+			UnsavedChunks.Add(ChunkCoord);
+		}
+
+		if (Lighting.IsValid())
+		{
+			Lighting->AddChunk(ChunkCoord);
+		}
+	}
+
+	MarkChunkDirty(ChunkCoord, true);
+
+	if (BlockTicks.IsValid())
+	{
+		BlockTicks->AddChunk(*FindChunk(ChunkCoord));
+	}
+
+	if (RenderMode == EVoxelRenderMode::InstancedMesh)
+	{
+		// only blocks with a face the mesher would keep get an instance, buried ones cost nothing
+		const FVoxelChunk& Loaded = *FindChunk(ChunkCoord);
+		const FVoxelChunkNeighbours Neighbours = FindNeighbours(ChunkCoord);
+
+		for (int32 Z = 0; Z < FVoxelChunk::SizeZ; ++Z)
+		{
+			for (int32 Y = 0; Y < FVoxelChunk::SizeY; ++Y)
+			{
+				for (int32 X = 0; X < FVoxelChunk::SizeX; ++X)
+				{
+					const uint16 BlockType = Loaded.GetBlock(X, Y, Z);
+
+					if (BlockType == FVoxelChunk::Air)
+					{
+						continue;
+					}
+
+					const FIntVector Block(ChunkCoord.X * FVoxelChunk::SizeX + X, ChunkCoord.Y * FVoxelChunk::SizeY + Y, Z);
+					UBlockInstancesComponent* Instances = FindOrAddInstances(BlockType);
+					const int32 Instance = Instances->FindBlockInstance(Block);
+
+					// blocks placed before the terrain arrived may be buried by it now
+					if (FVoxelMesher::IsBlockExposed(Loaded, Neighbours, BlockRegistry, X, Y, Z))
+					{
+						if (Instance == INDEX_NONE)
+						{
+							Instances->AddBlock(Block, FTransform(GetBlockCenter(Block)));
+						}
+					}
+					else if (Instance != INDEX_NONE)
+					{
+						Instances->RemoveBlock(Instance);
+					}
+				}
+			}
+		}
+
+		// the neighbours' border blocks may be covered by this chunk now
+		RefreshBorderInstances(ChunkCoord);
+	}
+
+	OnChunkLoaded.Broadcast(ChunkCoord);
+}
+
+void AVoxelWorld::RebuildChunkMesh(const FIntPoint& ChunkCoord)
+{
+	const FVoxelChunk* Chunk = FindChunk(ChunkCoord);
+	UProceduralMeshComponent** ChunkMesh = ChunkMeshes.Find(ChunkCoord);
+
+	if (Chunk == nullptr || Chunk->IsEmpty())
+	{
+		if (ChunkMesh != nullptr)
+		{
+			(*ChunkMesh)->DestroyComponent();
+			ChunkMeshes.Remove(ChunkCoord);
+		}
+
+		ChunkVisibility.Remove(ChunkCoord);
+		bVisibilityDirty = true;
+		return;
+	}
+
+	const FVoxelChunkNeighbours Neighbours = FindNeighbours(ChunkCoord);
+
+	FVoxelChunkMesh& Mesh = MeshScratch;
+	FVoxelMesher::BuildChunkMesh(*Chunk, Neighbours, BlockRegistry, BlockSize, Mesh);
+
+	UProceduralMeshComponent* Component = ChunkMesh != nullptr ? *ChunkMesh : nullptr;
+
+	if (Component == nullptr)
+	{
+		Component = NewObject<UProceduralMeshComponent>(this);
+		Component->bUseAsyncCooking = true;
+		Component->SetupAttachment(RootComponent);
+		Component->SetWorldLocation(BlockToWorld(FIntVector(ChunkCoord.X * FVoxelChunk::SizeX, ChunkCoord.Y * FVoxelChunk::SizeY, 0)));
+		Component->RegisterComponent();
+		ChunkMeshes.Add(ChunkCoord, Component);
+	}
+
+	Component->ClearAllMeshSections();
+
+	for (int32 SectionIndex = 0; SectionIndex < Mesh.Sections.Num(); ++SectionIndex)
+	{
+		const FVoxelMeshSection& Section = Mesh.Sections[SectionIndex];
+
+		Component->CreateMeshSection(SectionIndex, Section.Vertices, Section.Triangles, Section.Normals, Section.UVs,
+			Section.Colors, TArray<FProcMeshTangent>(), true);
+		Component->SetMaterial(SectionIndex, GetBlockType(Section.BlockType).Material);
+	}
+
+	// new mesh sections start out shown, the next walk hides what it doesn't reach
+	FChunkVisibility& Visibility = ChunkVisibility.FindOrAdd(ChunkCoord);
+	FMemory::Memcpy(Visibility.SectionConnections, Mesh.SectionConnections, sizeof(Mesh.SectionConnections));
+	Visibility.ShownSections = MAX_uint16;
+	Visibility.MeshSections.Reset();
+
+	for (const FVoxelMeshSection& Section : Mesh.Sections)
+	{
+		Visibility.MeshSections.Add((uint8)Section.ChunkSection);
+	}
+
+	bVisibilityDirty = true;
+}
+
+void AVoxelWorld::UpdateVisibility()
+{
+	SCOPE_CYCLE_COUNTER(STAT_CaveCulling);
+
+	const FIntPoint CenterChunk = FVoxelChunk::ToChunkCoord(ViewBlock);
+	const FIntVector Center(CenterChunk.X, CenterChunk.Y, FMath::Clamp(ViewBlock.Z >> FVoxelSection::SizeShift, 0, FVoxelChunk::NumSections - 1));
+
+	if (!bVisibilityDirty && Center == VisibilityCenter)
+	{
+		return;
+	}
+
+	bVisibilityDirty = false;
+	VisibilityCenter = Center;
+
+	for (TPair<FIntPoint, FChunkVisibility>& Pair : ChunkVisibility)
+	{
+		Pair.Value.ReachedSections = 0;
+	}
+
+	int32 NumVisible = 0;
+
+	if (bCaveCulling)
+	{
+		NumVisible = FVoxelVisibility::FindVisibleSections(Center, GenerationRadius + UnloadHysteresis,
+			[this](const FIntVector& Section, uint16& OutConnections)
+			{
+				const FIntPoint ChunkCoord(Section.X, Section.Y);
+
+				if (!IsChunkLoaded(ChunkCoord))
+				{
+					return false;
+				}
+
+				// loaded chunks without an entry are empty or not meshed yet, nothing in them blocks the view
+				const FChunkVisibility* Visibility = ChunkVisibility.Find(ChunkCoord);
+				OutConnections = Visibility != nullptr ? Visibility->SectionConnections[Section.Z] : FVoxelVisibility::AllConnected;
+				return true;
+			},
+			[this](const FIntVector& Section)
+			{
+				if (FChunkVisibility* Visibility = ChunkVisibility.Find(FIntPoint(Section.X, Section.Y)))
+				{
+					Visibility->ReachedSections |= 1 << Section.Z;
+				}
+			});
+	}
+
+	int32 NumHidden = 0;
+
+	for (TPair<FIntPoint, FChunkVisibility>& Pair : ChunkVisibility)
+	{
+		FChunkVisibility& Visibility = Pair.Value;
+
+		// no walk when culling is off or the camera is outside the loaded world, everything shows
+		const uint16 Shown = NumVisible > 0 ? Visibility.ReachedSections : MAX_uint16;
+
+		for (int32 MeshSection = 0; MeshSection < Visibility.MeshSections.Num(); ++MeshSection)
+		{
+			NumHidden += (Shown >> Visibility.MeshSections[MeshSection] & 1) == 0;
+		}
+
+		if (Shown == Visibility.ShownSections)
+		{
+			continue;
+		}
+
+		Visibility.ShownSections = Shown;
+
+		UProceduralMeshComponent* Component = ChunkMeshes.FindRef(Pair.Key);
+
+		if (Component == nullptr)
+		{
+			continue;
+		}
+
+		for (int32 MeshSection = 0; MeshSection < Visibility.MeshSections.Num(); ++MeshSection)
+		{
+			Component->SetMeshSectionVisible(MeshSection, (Shown >> Visibility.MeshSections[MeshSection] & 1) != 0);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_VisibleSections, NumVisible);
+	SET_DWORD_STAT(STAT_HiddenMeshSections, NumHidden);
+}
+
+const FVoxelBlockType& AVoxelWorld::GetBlockType(uint16 BlockType) const
+{
+	return BlockRegistry.Get(BlockRegistry.IsValidId(BlockType) ? BlockType : FVoxelChunk::Air);
+}
+
+FIntVector AVoxelWorld::WorldToBlock(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / BlockSize),
+		FMath::FloorToInt(Location.Y / BlockSize),
+		FMath::FloorToInt(Location.Z / BlockSize));
+}
+
+FVector AVoxelWorld::BlockToWorld(const FIntVector& Block) const
+{
+	return FVector(Block) * BlockSize;
+}
+
+FVector AVoxelWorld::GetBlockCenter(const FIntVector& Block) const
+{
+	return BlockToWorld(Block) + FVector(BlockSize * 0.5f);
+}
+
+bool AVoxelWorld::Raycast(const FVector& Start, const FVector& Direction, float MaxDistance, FVoxelRayHit& OutHit) const
+{
+	FRWScopeLock Lock(ChunksLock, SLT_ReadOnly);
+
+	return FVoxelRaycast::Trace(Start, Direction, MaxDistance, BlockSize, [this](const FIntVector& Block) { return GetRaycastBlock(Block); }, OutHit);
+}
+
+int32 AVoxelWorld::RaycastBatch(TArrayView<const FVoxelRay> Rays, TArrayView<FVoxelRayHit> OutHits) const
+{
+	check(Rays.Num() == OutHits.Num());
+
+	FRWScopeLock Lock(ChunksLock, SLT_ReadOnly);
+
+	int32 NumHits = 0;
+
+	for (int32 RayIndex = 0; RayIndex < Rays.Num(); ++RayIndex)
+	{
+		const FVoxelRay& Ray = Rays[RayIndex];
+		NumHits += FVoxelRaycast::Trace(Ray.Start, Ray.Direction, Ray.MaxDistance, BlockSize, [this](const FIntVector& Block) { return GetRaycastBlock(Block); }, OutHits[RayIndex]);
+	}
+
+	return NumHits;
+}
+
+uint16 AVoxelWorld::GetRaycastBlock(const FIntVector& Block) const
+{
+	const uint16 BlockType = GetBlock(Block);
+
+	return BlockRegistry.IsFluid(BlockType) ? FVoxelChunk::Air : BlockType;
+}
+
+float AVoxelWorld::GetBreakingStage(const FIntVector& Block) const
+{
+	const float* BreakingStage = BreakingStages.Find(Block);
+
+	return BreakingStage != nullptr ? *BreakingStage : 0.f;
+}
+
+void AVoxelWorld::Break(const FIntVector& Block)
+{
+	if (GetBlock(Block) == FVoxelChunk::Air)
+	{
+		return;
+	}
+
+	float& BreakingStage = BreakingStages.FindOrAdd(Block);
+	++BreakingStage;
+
+	ApplyCrackingValue(Block, 1.0f - (BreakingStage / NumBreakingStages));
+
+	if (BreakingStage >= NumBreakingStages)
+	{
+		OnBroken(Block, true);
+	}
+}
+
+void AVoxelWorld::ResetBlock(const FIntVector& Block)
+{
+	// nothing to undo on blocks nobody has hit yet
+	if (BreakingStages.Remove(Block) > 0)
+	{
+		ApplyCrackingValue(Block, 1.0f);
+	}
+}
+
+void AVoxelWorld::OnBroken(const FIntVector& Block, bool HasRequiredPickaxe)
+{
+	SetBlock(Block, FVoxelChunk::Air);
+}
+
+void AVoxelWorld::ApplyCrackingValue(const FIntVector& Block, float CrackingValue)
+{
+	if (CrackingValue >= 1.0f)
+	{
+		// only hide the overlay if it isn't already showing another block's progress
+		if (bCrackOverlayVisible && Block == CrackOverlayBlock)
+		{
+			CrackOverlay->SetHiddenInGame(true);
+			bCrackOverlayVisible = false;
+		}
+		return;
+	}
+
+	if (CrackOverlayMaterialInstance == nullptr)
+	{
+		return;
+	}
+
+	if (!bCrackOverlayVisible || Block != CrackOverlayBlock)
+	{
+		CrackOverlayBlock = Block;
+		CrackOverlay->SetWorldLocation(GetBlockCenter(Block));
+		CrackOverlay->SetHiddenInGame(false);
+		bCrackOverlayVisible = true;
+	}
+
+	CrackOverlayMaterialInstance->SetScalarParameterValue(FName("CrackingValue"), CrackingValue);
+}
+
+UBlockInstancesComponent* AVoxelWorld::FindOrAddInstances(uint16 BlockType)
+{
+	if (BlockInstances.Num() <= BlockType)
+	{
+		BlockInstances.SetNumZeroed(BlockType + 1);
+	}
+
+	UBlockInstancesComponent*& Instances = BlockInstances[BlockType];
+
+	if (Instances == nullptr)
+	{
+		Instances = NewObject<UBlockInstancesComponent>(this);
+		Instances->SetStaticMesh(GetBlockType(BlockType).Mesh);
+		Instances->SetupAttachment(RootComponent);
+		Instances->RegisterComponent();
+	}
+
+	return Instances;
+}
+
+void AVoxelWorld::UpdateBlockInstance(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType)
+{
+	if (RenderMode != EVoxelRenderMode::InstancedMesh)
+	{
+		return;
+	}
+
+	if (OldBlockType != FVoxelChunk::Air && BlockInstances.IsValidIndex(OldBlockType) && BlockInstances[OldBlockType] != nullptr)
+	{
+		UBlockInstancesComponent* OldInstances = BlockInstances[OldBlockType];
+		OldInstances->RemoveBlock(OldInstances->FindBlockInstance(Block));
+	}
+
+	RefreshBlockInstance(Block);
+
+	for (int32 Face = 0; Face < FVoxelVisibility::NumFaces; ++Face)
+	{
+		RefreshBlockInstance(Block + FVoxelVisibility::GetFaceOffset(Face));
+	}
+}
+
+void AVoxelWorld::RefreshBlockInstance(const FIntVector& Block)
+{
+	const uint16 BlockType = GetBlock(Block);
+
+	if (BlockType == FVoxelChunk::Air)
+	{
+		return;
+	}
+
+	const FIntPoint ChunkCoord = FVoxelChunk::ToChunkCoord(Block);
+	const FIntVector Local = FVoxelChunk::ToLocal(Block);
+	const bool bExposed = FVoxelMesher::IsBlockExposed(*FindChunk(ChunkCoord), FindNeighbours(ChunkCoord), BlockRegistry, Local.X, Local.Y, Local.Z);
+
+	UBlockInstancesComponent* Instances = BlockInstances.IsValidIndex(BlockType) ? BlockInstances[BlockType] : nullptr;
+	const int32 Instance = Instances != nullptr ? Instances->FindBlockInstance(Block) : INDEX_NONE;
+
+	if (bExposed && Instance == INDEX_NONE)
+	{
+		// instanced cubes are expected to be BlockSize wide with their pivot in the middle
+		FindOrAddInstances(BlockType)->AddBlock(Block, FTransform(GetBlockCenter(Block)));
+	}
+	else if (!bExposed && Instance != INDEX_NONE)
+	{
+		Instances->RemoveBlock(Instance);
+	}
+}
+
+void AVoxelWorld::RefreshBorderInstances(const FIntPoint& ChunkCoord)
+{
+	const FIntPoint Directions[4] = { FIntPoint(1, 0), FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(0, -1) };
+
+	for (const FIntPoint& Direction : Directions)
+	{
+		const FIntPoint NeighbourCoord = ChunkCoord + Direction;
+
+		if (FindChunk(NeighbourCoord) == nullptr)
+		{
+			continue;
+		}
+
+		// the neighbour's row of columns that touches this chunk
+		const int32 BorderX = Direction.X > 0 ? 0 : FVoxelChunk::SizeX - 1;
+		const int32 BorderY = Direction.Y > 0 ? 0 : FVoxelChunk::SizeY - 1;
+
+		for (int32 Index = 0; Index < FVoxelChunk::SizeX; ++Index)
+		{
+			const int32 X = Direction.X != 0 ? BorderX : Index;
+			const int32 Y = Direction.Y != 0 ? BorderY : Index;
+
+			for (int32 Z = 0; Z < FVoxelChunk::SizeZ; ++Z)
+			{
+				RefreshBlockInstance(FIntVector(NeighbourCoord.X * FVoxelChunk::SizeX + X, NeighbourCoord.Y * FVoxelChunk::SizeY + Y, Z));
+			}
+		}
+	}
+}
+
+FVoxelChunkNeighbours AVoxelWorld::FindNeighbours(const FIntPoint& ChunkCoord) const
+{
+	FVoxelChunkNeighbours Neighbours;
+	Neighbours.PosX = FindChunk(ChunkCoord + FIntPoint(1, 0));
+	Neighbours.NegX = FindChunk(ChunkCoord + FIntPoint(-1, 0));
+	Neighbours.PosY = FindChunk(ChunkCoord + FIntPoint(0, 1));
+	Neighbours.NegY = FindChunk(ChunkCoord + FIntPoint(0, -1));
+	return Neighbours;
+}
+
+void AVoxelWorld::RegisterBlockActor(ABlock* BlockActor)
+{
+	SetBlock(BlockActor->BlockCoord, BlockActor->BlockType);
+
+	if (RenderMode == EVoxelRenderMode::Actors)
+	{
+		BlockActors.Add(BlockActor->BlockCoord, BlockActor);
+	}
+	else
+	{
+		// the voxel world draws the block from here on, the actor was only there to place it
+		BlockActor->Destroy();
+	}
+}
+
+void AVoxelWorld::UnregisterBlockActor(ABlock* BlockActor)
+{
+	ABlock* const* Registered = BlockActors.Find(BlockActor->BlockCoord);
+
+	if (Registered != nullptr && *Registered == BlockActor)
+	{
+		BlockActors.Remove(BlockActor->BlockCoord);
+	}
+}
@@ -0,0 +1,526 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Async/Future.h"
+#include "Containers/Queue.h"
+#include "Misc/ScopeRWLock.h"
+#include "BlockRegistry.h"
+#include "TerrainGenerator.h"
+#include "VoxelBlockTicks.h"
+#include "VoxelFluids.h"
+#include "VoxelChunk.h"
+#include "VoxelEdit.h"
+#include "VoxelLighting.h"
+#include "VoxelMesher.h"
+#include "VoxelRaycast.h"
+#include "VoxelRegion.h"
+#include "VoxelWorld.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogVoxel, Log, All);
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnVoxelBlockChanged, const FIntVector& /*Block*/);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnVoxelBlocksChanged, const FIntVector& /*Min*/, const FIntVector& /*Max*/);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnVoxelChunkLoaded, const FIntPoint& /*ChunkCoord*/);
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnVoxelBlockTick, const FIntVector& /*Block*/, uint16 /*BlockType*/, bool /*bRandom*/);
+
+class ABlock;
+class UBlockInstancesComponent;
+class UProceduralMeshComponent;
+
+// how the voxel world puts its blocks on screen
+UENUM()
+enum class EVoxelRenderMode : uint8
+{
+	// every block keeps its hand placed ABlock actor
+	Actors,
+	// blocks are greedy meshed into one procedural mesh per chunk
+	ChunkMesh,
+	// blocks with a face that can be seen are instances of their type's cube mesh, one instanced component per block type
+	InstancedMesh
+};
+
+// Owns every block in the level as chunked voxel data. Block state that used to
+// sit on each ABlock actor (resistance, minimum material, breaking stage) lives here.
+UCLASS()
+class MCUE_API AVoxelWorld : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AVoxelWorld();
+
+	// the voxel world of the current game, spawned on first use
+	static AVoxelWorld* Get(const UObject* WorldContextObject);
+
+	//edge length of one block in world units
+	UPROPERTY(EditAnywhere, Category = Voxel)
+		float BlockSize;
+
+	//table of FVoxelBlockType rows, row n gets block id n + 1
+	UPROPERTY(EditAnywhere, Category = Voxel)
+		class UDataTable* BlockTable;
+
+	//block properties indexed by block id with id 0 as air, used when there is no block table
+	UPROPERTY(EditAnywhere, Category = Voxel)
+		TArray<FVoxelBlockType> BlockTypes;
+
+	UPROPERTY(EditAnywhere, Category = Voxel)
+		EVoxelRenderMode RenderMode;
+
+	//fill chunks with procedural terrain instead of relying on hand placed blocks only
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		bool bGenerateTerrain;
+
+	UPROPERTY(EditAnywhere, Category = Terrain)
+		FTerrainSettings TerrainSettings;
+
+	//radius in chunks kept generated around the player
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "0"))
+		int32 GenerationRadius;
+
+	//chunks past the generation radius a chunk may drift before it is unloaded, so walking back and forth over the edge doesn't reload it
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "0"))
+		int32 UnloadHysteresis;
+
+	//how much longer chunks behind the camera wait than chunks in view, 0 streams purely by distance
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "0"))
+		float BehindViewPenalty;
+
+	//generation tasks in flight at once, the rest stay queued so closer chunks can still jump ahead
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "1"))
+		int32 MaxPendingChunks;
+
+	//milliseconds per frame the game thread may spend adding, unloading and remeshing chunks
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "0.1"))
+		float StreamingBudgetMs;
+
+	//keep edited chunks in region files under Saved/Voxel/SaveName and load them back instead of regenerating them
+	UPROPERTY(EditAnywhere, Category = Saving)
+		bool bSaveWorld;
+
+	UPROPERTY(EditAnywhere, Category = Saving, meta = (EditCondition = "bSaveWorld"))
+		FString SaveName;
+
+	//Zlib, LZ4 or None
+	UPROPERTY(EditAnywhere, Category = Saving, meta = (EditCondition = "bSaveWorld"))
+		FName SaveCompressionFormat;
+
+	//seconds between autosaves of the chunks edited since the last save, 0 only saves on unload and at the end of play
+	UPROPERTY(EditAnywhere, Category = Saving, meta = (EditCondition = "bSaveWorld", ClampMin = "0"))
+		float AutosaveInterval;
+
+	//light blocks with sky light and light from emitting blocks, passed to chunk meshes as vertex colours
+	UPROPERTY(EditAnywhere, Category = Lighting)
+		bool bLighting;
+
+	//game ticks per second block ticks run at, 0 stops blocks from ticking
+	UPROPERTY(EditAnywhere, Category = Ticking, meta = (ClampMin = "0"))
+		float BlockTickRate;
+
+	//random blocks picked per game tick in every 16 block section holding blocks that take random ticks
+	UPROPERTY(EditAnywhere, Category = Ticking, meta = (ClampMin = "0"))
+		int32 RandomTicksPerSection;
+
+	//block ticks run per game tick at most, scheduled ticks past it wait for the next game tick
+	UPROPERTY(EditAnywhere, Category = Ticking, meta = (ClampMin = "1"))
+		int32 BlockTickBudget;
+
+	//milliseconds per frame block ticks may take, so a flood spreads over several frames instead of stalling one
+	UPROPERTY(EditAnywhere, Category = Ticking, meta = (ClampMin = "0.1"))
+		float BlockTickBudgetMs;
+
+	//bulk edits kept for undoing, the oldest is dropped past this
+	UPROPERTY(EditAnywhere, Category = Editing, meta = (ClampMin = "0"))
+		int32 MaxUndoEdits;
+
+	//material drawn over the block being mined, driven through its CrackingValue parameter. No overlay is shown without one
+	UPROPERTY(EditAnywhere, Category = Voxel)
+		class UMaterialInterface* CrackOverlayMaterial;
+
+	//hides the parts of chunk meshes the camera can't see into through caves and open air
+	UPROPERTY(EditAnywhere, Category = Voxel)
+		bool bCaveCulling;
+
+	// number of breaks it takes to destroy a block
+	static constexpr float NumBreakingStages = 5.f;
+
+	// broadcast after a block changed type, including being broken or placed
+	FOnVoxelBlockChanged OnBlockChanged;
+
+	// broadcast once a bulk edit is done, with the box around every block it changed. Bulk edits
+	// don't broadcast OnBlockChanged for each of their blocks.
+	FOnVoxelBlocksChanged OnBlocksChanged;
+
+	// broadcast after a generated chunk was added to the world
+	FOnVoxelChunkLoaded OnChunkLoaded;
+
+	// broadcast for every scheduled and random block tick, after built in behaviour like falling ran
+	FOnVoxelBlockTick OnBlockTick;
+
+	// game thread only, other threads go through the raycast functions. Blocks set while a light
+	// batch runs are queued and written once it is done at the start of the next world tick, until
+	// then GetBlock still returns the old block.
+	uint16 GetBlock(const FIntVector& Block) const;
+	void SetBlock(const FIntVector& Block, uint16 BlockType);
+
+	const FVoxelBlockType& GetBlockType(uint16 BlockType) const;
+
+	// Bulk edits for admin tools, explosions and level building. Blocks are written a section at a
+	// time under one lock, light and meshes catch up once for every chunk touched, and the edit is
+	// undone in one step. Only loaded columns are edited. Each returns the number of blocks changed.
+	int32 FillBox(const FIntVector& Min, const FIntVector& Max, uint16 BlockType);
+	int32 ReplaceBlocks(const FIntVector& Min, const FIntVector& Max, uint16 FromBlockType, uint16 ToBlockType);
+	int32 FillSphere(const FIntVector& Center, int32 Radius, uint16 BlockType);
+
+	// clears the blocks in the sphere that the blast overcomes: Power against a block's resistance at
+	// the center, falling off to nothing at the edge. Fluids are left alone.
+	int32 Explode(const FIntVector& Center, int32 Radius, float Power);
+
+	void CopyBlocks(const FIntVector& Min, const FIntVector& Max, FVoxelClipboard& OutClipboard) const;
+
+	// puts the clipboard's minimum corner at Origin, with bSkipAir the air in it leaves blocks as they are
+	int32 PasteBlocks(const FVoxelClipboard& Clipboard, const FIntVector& Origin, bool bSkipAir);
+
+	// bulk edits until the matching EndEdit become one transaction, undone in one step. May nest.
+	void BeginEdit();
+	void EndEdit();
+
+	// takes back the last bulk edit, or applies again the last one taken back. False if there is none.
+	bool UndoEdit();
+	bool RedoEdit();
+
+	// memory held by the undo and redo journals
+	SIZE_T GetUndoAllocatedSize() const;
+
+	// relights and remeshes everything edits queued right away instead of over the next frames,
+	// for tools and benchmarks that need to see an edit finished
+	void FlushEdits();
+
+	// ticks the block Delay game ticks from now if it is still of the same type by then
+	void ScheduleBlockTick(const FIntVector& Block, int32 Delay);
+
+	const FBlockRegistry& GetBlockRegistry() const { return BlockRegistry; }
+
+	// block that contains the given world position
+	FIntVector WorldToBlock(const FVector& Location) const;
+
+	// world position of the block's minimum corner
+	FVector BlockToWorld(const FIntVector& Block) const;
+
+	FVector GetBlockCenter(const FIntVector& Block) const;
+
+	// first solid block along the ray within MaxDistance. Safe to call from any thread.
+	bool Raycast(const FVector& Start, const FVector& Direction, float MaxDistance, FVoxelRayHit& OutHit) const;
+
+	// traces every ray under a single read lock, OutHits[i] is invalid where Rays[i] hit nothing.
+	// Safe to call from any thread, returns the number of rays that hit a block.
+	int32 RaycastBatch(TArrayView<const FVoxelRay> Rays, TArrayView<FVoxelRayHit> OutHits) const;
+
+	float GetBreakingStage(const FIntVector& Block) const;
+
+	//called every time we want to break the block down further
+	void Break(const FIntVector& Block);
+
+	void ResetBlock(const FIntVector& Block);
+
+	//called once the block has hit the final breaking stage
+	void OnBroken(const FIntVector& Block, bool HasRequiredPickaxe);
+
+	// hand placed blocks register here so they can be driven by the voxel data
+	void RegisterBlockActor(ABlock* BlockActor);
+	void UnregisterBlockActor(ABlock* BlockActor);
+
+	int32 GetNumChunks() const { return Chunks.Num(); }
+
+	// queues the chunk for generation on a worker thread unless it is loaded or already queued
+	void RequestChunk(const FIntPoint& ChunkCoord);
+
+	// true if the chunk was generated, columns that only hold hand placed blocks don't count
+	bool IsChunkLoaded(const FIntPoint& ChunkCoord) const;
+
+	// chunks waiting to be generated, in flight on worker threads, or waiting for a remesh
+	int32 GetStreamingQueueDepth() const { return ChunkQueue.Num() + PendingChunks.Num() + DirtyChunks.Num(); }
+
+	// frames in which streaming work ran past StreamingBudgetMs
+	int32 GetNumBudgetOverruns() const { return NumBudgetOverruns; }
+
+	// snapshots every chunk edited since the last save and writes them on a background thread.
+	// With bWaitForWrite the game thread waits until everything queued so far is on disk.
+	void SaveWorld(bool bWaitForWrite);
+
+	// loaded chunks with edits that aren't part of a save yet
+	int32 GetNumUnsavedChunks() const { return UnsavedChunks.Num(); }
+
+	// milliseconds the game thread spent copying chunks for the last save
+	double GetLastSnapshotMs() const { return LastSnapshotSeconds * 1000.0; }
+
+	// what the background writes stored so far, empty unless the world is saved
+	FVoxelRegionWriteStats GetSaveWriteStats() const;
+
+	// checks every loaded edited chunk: encoding it for the save and regenerating and patching it has
+	// to give back its blocks, and a chunk without unsaved edits has to match what the save holds.
+	// Returns the number of chunks that failed, OutNumChecked is set to the number looked at.
+	int32 VerifySave(int32& OutNumChecked) const;
+
+protected:
+	// builds the block registry before any block can register with us
+	virtual void PostInitializeComponents() override;
+
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	// writes every edited chunk to the save
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+private:
+	FVoxelChunk* FindChunk(const FIntPoint& ChunkCoord) const;
+
+	// the block as rays see it, fluid lets them through so the player aims at whatever is under the water
+	uint16 GetRaycastBlock(const FIntVector& Block) const;
+	FVoxelChunk& FindOrAddChunk(const FIntPoint& ChunkCoord);
+
+	// moves the crack overlay onto the block and shows its breaking progress, 1 hides it again
+	void ApplyCrackingValue(const FIntVector& Block, float CrackingValue);
+
+	// runs Edit over the box as part of the open transaction, opening one for just this edit if there is none
+	int32 EditBox(const FIntVector& Min, const FIntVector& Max, FVoxelEdit::FEditBlock Edit);
+
+	// what every block a bulk edit changed needs besides its chunk: ticks, fluids, actors and instances.
+	// Light is redone per chunk in FinishEditedChunks.
+	void OnBulkBlockChanged(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType);
+
+	// schedules the ticks a changed block and the blocks around it need, for falling blocks and fluids
+	void WakeBlockTicks(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType);
+
+	// forgets the box and chunks of the last transaction
+	void ResetEditedChunks();
+
+	// queues every chunk the transaction changed for saving, relighting and remeshing and tells listeners
+	void FinishEditedChunks();
+
+	// keeps a finished transaction for undoing, dropping the oldest past MaxUndoEdits
+	void AddUndoJournal(FVoxelEditJournal&& Journal);
+
+	// queues the chunk holding the block for remeshing, plus any neighbour whose border faces it touches.
+	// With lighting the remesh waits until the light batch with the edit is done.
+	void MarkBlockDirty(const FIntVector& Block);
+
+	void MarkChunkDirty(const FIntPoint& ChunkCoord, bool bIncludeNeighbours);
+
+	// moves a chunk finished by a worker thread into the world
+	void AddGeneratedChunk(TUniquePtr<FVoxelChunk> Chunk);
+
+	// follows the player, reprioritizes the chunk queue when they moved or turned and hands chunks to worker threads
+	void UpdateStreaming();
+
+	// lower loads sooner, grows with distance from the player and with the angle away from where they look
+	float GetChunkPriority(const FIntPoint& ChunkCoord) const;
+
+	bool IsInStreamingRange(const FIntPoint& ChunkCoord, int32 Radius) const;
+
+	// drops the chunk's voxel data and everything drawing it, unsaved edits are queued for writing first
+	void UnloadChunk(const FIntPoint& ChunkCoord);
+
+	// autosaves once AutosaveInterval passed and starts a write for whatever got queued
+	void UpdateSaving(float DeltaTime);
+
+	// queues a copy of every unsaved chunk with the region store
+	void SnapshotUnsavedChunks();
+
+	// writes the queued chunks on a worker thread unless a write is still running
+	void StartSaveTask();
+
+	// waits for the light batch started last frame, queues the chunks it relit for remeshing and
+	// writes the blocks set while it ran. Bulk edits call it before they write blocks themselves.
+	void FinishLighting();
+
+	// hands the light updates queued this frame to a worker thread as one batch
+	void StartLighting();
+
+	// runs the game ticks that are due since last frame
+	void TickBlocks(float DeltaTime);
+
+	// publishes the occupancy of the chunk buffer pools, which every world shares
+	void UpdatePoolStats() const;
+
+	// walks the sections the camera can see into and shows only their part of each chunk mesh.
+	// Only runs when the camera entered another section or a chunk was meshed or dropped.
+	void UpdateVisibility();
+
+	void RunBlockTick(const FIntVector& Block, uint16 BlockType, bool bRandom);
+
+	// rebuilds the procedural mesh of one chunk from its voxel data
+	void RebuildChunkMesh(const FIntPoint& ChunkCoord);
+
+	// the loaded columns around a chunk
+	FVoxelChunkNeighbours FindNeighbours(const FIntPoint& ChunkCoord) const;
+
+	// moves the block between instanced components after its type changed, and gives its six
+	// neighbours an instance or takes it away as they became exposed or buried
+	void UpdateBlockInstance(const FIntVector& Block, uint16 OldBlockType, uint16 NewBlockType);
+
+	// gives the block an instance if any of its faces can be seen and takes it away otherwise, like
+	// the mesher culls faces. Buried blocks have no instance.
+	void RefreshBlockInstance(const FIntVector& Block);
+
+	// refreshes the instances of the blocks in the loaded columns next to the chunk that face it,
+	// after it was loaded or dropped
+	void RefreshBorderInstances(const FIntPoint& ChunkCoord);
+
+	UBlockInstancesComponent* FindOrAddInstances(uint16 BlockType);
+
+	FBlockRegistry BlockRegistry;
+
+	TMap<FIntPoint, TUniquePtr<FVoxelChunk>> Chunks;
+
+	// held for writing while the game thread edits chunks, and for reading by raycasts from other threads
+	mutable FRWLock ChunksLock;
+
+	typedef TQueue<TUniquePtr<FVoxelChunk>, EQueueMode::Mpsc> FGeneratedChunkQueue;
+
+	// shared with the generation tasks so they stay valid if the world goes away first
+	TSharedPtr<const FTerrainGenerator, ESPMode::ThreadSafe> TerrainGenerator;
+	TSharedPtr<FGeneratedChunkQueue, ESPMode::ThreadSafe> GeneratedChunks;
+
+	// chunks handed to a worker thread that haven't come back yet
+	TSet<FIntPoint> PendingChunks;
+
+	// saved chunks, null unless the world is saved. Shared with generation tasks, which load from it.
+	TSharedPtr<FVoxelRegionStore, ESPMode::ThreadSafe> RegionStore;
+
+	// null unless bLighting. Queued to under the write lock, the batch runs under the read lock.
+	TUniquePtr<FVoxelLighting> Lighting;
+
+	// light batch running on a worker thread, joined at the start of the next tick
+	TFuture<void> LightingTask;
+
+	// copy of the block registry for generation tasks that light their chunk, they may outlive the world
+	TSharedPtr<const FBlockRegistry, ESPMode::ThreadSafe> LightingRegistry;
+
+	// created along with the block registry, so blocks placed before BeginPlay are seen too
+	TUniquePtr<FVoxelBlockTicks> BlockTicks;
+	TUniquePtr<FVoxelFluids> Fluids;
+
+	// seconds since the last game tick of block ticks
+	float BlockTickTime;
+
+	// write of queued chunks running on a worker thread, holds its own reference to the region store
+	TFuture<void> SaveTask;
+
+	// populated chunks with edits since their last snapshot, only tracked while the world is saved
+	TSet<FIntPoint> UnsavedChunks;
+
+	// seconds since the last autosave
+	float AutosaveTime;
+
+	double LastSnapshotSeconds;
+
+	struct FChunkRequest
+	{
+		FIntPoint Coord;
+		float Priority;
+
+		FChunkRequest(const FIntPoint& InCoord, float InPriority)
+			: Coord(InCoord), Priority(InPriority) {}
+
+		bool operator<(const FChunkRequest& Other) const { return Priority < Other.Priority; }
+	};
+
+	// chunks in range that still need generating, a heap with the most urgent one on top
+	TArray<FChunkRequest> ChunkQueue;
+
+	// generated chunks that left the unload radius, unloaded a few per frame
+	TArray<FIntPoint> ChunksToUnload;
+
+	// chunk the player was in and the way they were looking when the queue was last sorted
+	FIntPoint StreamingCenter;
+	FVector2D StreamingView;
+	bool bStreamingStarted;
+
+	// block the camera was in when streaming last looked
+	FIntVector ViewBlock;
+
+	int32 NumBudgetOverruns;
+
+	// only blocks that are currently being mined have an entry
+	TMap<FIntVector, float> BreakingStages;
+
+	// one overlay shared by every block, moved to whichever block is being mined
+	UPROPERTY(VisibleDefaultsOnly, Category = Voxel)
+		UStaticMeshComponent* CrackOverlay;
+
+	// created once in BeginPlay so mining never allocates a material instance
+	UPROPERTY()
+		class UMaterialInstanceDynamic* CrackOverlayMaterialInstance;
+
+	// block the overlay currently sits on
+	FIntVector CrackOverlayBlock;
+
+	bool bCrackOverlayVisible;
+
+	UPROPERTY()
+		TMap<FIntVector, ABlock*> BlockActors;
+
+	UPROPERTY()
+		TMap<FIntPoint, UProceduralMeshComponent*> ChunkMeshes;
+
+	// every chunk is meshed into this one, so its buffers are reused from chunk to chunk
+	FVoxelChunkMesh MeshScratch;
+
+	// what cave culling knows about a meshed chunk
+	struct FChunkVisibility
+	{
+		// face connections of each section, from the last mesh build
+		uint16 SectionConnections[FVoxelChunk::NumSections];
+
+		// chunk section of each mesh section of the component
+		TArray<uint8> MeshSections;
+
+		// one bit per chunk section whose mesh sections are shown, and the ones the last walk reached
+		uint16 ShownSections;
+		uint16 ReachedSections;
+	};
+
+	// only meshed chunks that aren't empty have an entry
+	TMap<FIntPoint, FChunkVisibility> ChunkVisibility;
+
+	// section the camera was in during the last walk, in visibility section coordinates
+	FIntVector VisibilityCenter;
+
+	bool bVisibilityDirty;
+
+	// instanced components indexed by block type, created when the first block of a type shows up
+	UPROPERTY()
+		TArray<UBlockInstancesComponent*> BlockInstances;
+
+	// chunks whose mesh is out of date with their voxel data
+	TSet<FIntPoint> DirtyChunks;
+
+	// open BeginEdit calls, the transaction is finished when the last one ends
+	int32 EditDepth;
+
+	// what the open transaction changed so far, and the box and chunks it changed them in
+	FVoxelEditJournal EditJournal;
+	FIntVector EditMin;
+	FIntVector EditMax;
+	TSet<FIntPoint> EditedChunks;
+
+	// finished transactions, newest last, and those taken back since the last new one
+	TArray<FVoxelEditJournal> UndoJournals;
+	TArray<FVoxelEditJournal> RedoJournals;
+
+	// chunks edited since the last light batch started and those edited before it, remeshed once their light is in
+	TSet<FIntPoint> ChunksAwaitingLight;
+	TSet<FIntPoint> ChunksInLightBatch;
+
+	// SetBlock calls made while a light batch ran, in order, written by FinishLighting
+	TArray<TPair<FIntVector, uint16>> QueuedBlockEdits;
+};
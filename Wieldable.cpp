@@ -2,27 +2,36 @@
 
 
 #include "Wieldable.h"
-#include "MCUECharacter.h"
+#include "PickupManager.h"
 #include "Runtime/Engine/Classes/Components/BoxComponent.h"
-#include "Kismet/GameplayStatics.h"
 
 // Sets default values
 AWieldable::AWieldable()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// dropped items are turned by the pickup manager, none of them tick on their own
+	PrimaryActorTick.bCanEverTick = false;
 
 	WieldableMesh = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("WieldableMesh"));
 
 	PickupTrigger = CreateDefaultSubobject<UBoxComponent>(TEXT("PickTrigger"));
 
-	PickupTrigger->SetGenerateOverlapEvents(true);
-	PickupTrigger->OnComponentBeginOverlap.AddDynamic(this, &AWieldable::OnRadiusEnter);
+	// characters find items through the pickup manager's grid, nothing of an item needs to be in the physics scene
+	WieldableMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	WieldableMesh->SetGenerateOverlapEvents(false);
+
+	PickupTrigger->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	PickupTrigger->SetGenerateOverlapEvents(false);
 	PickupTrigger->SetupAttachment(WieldableMesh);
 	MaterialType = EMaterial::None;
 	ToolType = ETool::Unarmed;
 
+	MaxStackSize = 64;
+	Count = 1;
+	Durability = 0;
+
 	bIsActive = true;
+	PickupIndex = INDEX_NONE;
+	PickupCell = FIntVector::ZeroValue;
 
 }
 
@@ -30,39 +39,52 @@ AWieldable::AWieldable()
 void AWieldable::BeginPlay()
 {
 	Super::BeginPlay();
-	
-}
-
-// Called every frame
-void AWieldable::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
 
-	FRotator rotation = WieldableMesh->GetComponentRotation();
-	rotation.Yaw += 1.f;
-	WieldableMesh->SetRelativeRotation(rotation);
-	   
+	if (bIsActive)
+	{
+		if (APickupManager* PickupManager = APickupManager::Get(this))
+		{
+			PickupManager->AddPickup(this);
+		}
+	}
 }
 
-void AWieldable::OnRadiusEnter(class UPrimitiveComponent* HitComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void AWieldable::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	if (bIsActive)
+	if (PickupIndex != INDEX_NONE)
 	{
-		AMCUECharacter* Character = Cast<AMCUECharacter>(UGameplayStatics::GetPlayerCharacter(this, 0));
-		Character->FP_WieldedItem->SetSkeletalMesh(WieldableMesh->SkeletalMesh);
-		Character->AddItemToInventory(this);
-		OnPickedUp();
+		if (APickupManager* PickupManager = APickupManager::Get(this))
+		{
+			PickupManager->RemovePickup(this);
+		}
 	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AWieldable::OnPickedUp()
 {
-	WieldableMesh->SetVisibility(false);
-	bIsActive = false;
+	// the inventory keeps a stack, the actor waits in the pool for the next drop
+	if (APickupManager* PickupManager = APickupManager::Get(this))
+	{
+		PickupManager->ReleasePickup(this);
+	}
+	else
+	{
+		bIsActive = false;
+		Destroy();
+	}
 }
 
-void AWieldable::OnUsed()
+int32 FItemStack::GetMaxCount() const
 {
-	Destroy();
+	if (ItemClass == nullptr)
+	{
+		return 0;
+	}
+
+	// a stack shares one Durability, tools wear one at a time and so never stack
+	const AWieldable* Defaults = ItemClass->GetDefaultObject<AWieldable>();
+	return Defaults->ToolType != ETool::Unarmed ? 1 : FMath::Max(1, Defaults->MaxStackSize);
 }
  
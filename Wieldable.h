@@ -27,6 +27,53 @@
 		Golden = 12
 	};
 
+// What an inventory slot holds: the kind of item, how many of them and how worn they are. Items
+// only exist as actors while they lie in the world, picking one up turns it into a stack and
+// dropping one spawns it from the stack again. Thumbnails, meshes and stack sizes are read from
+// the item class's defaults.
+USTRUCT(BlueprintType)
+struct FItemStack
+{
+	GENERATED_BODY()
+
+	//the item, null for an empty slot
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Inventory)
+		TSubclassOf<class AWieldable> ItemClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Inventory)
+		int32 Count;
+
+	//uses left before the items break, 0 for items that don't wear
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Inventory)
+		int32 Durability;
+
+	FItemStack()
+		: ItemClass(nullptr)
+		, Count(0)
+		, Durability(0)
+	{
+	}
+
+	FItemStack(TSubclassOf<class AWieldable> InItemClass, int32 InCount, int32 InDurability)
+		: ItemClass(InItemClass)
+		, Count(InCount)
+		, Durability(InDurability)
+	{
+	}
+
+	bool IsEmpty() const { return ItemClass == nullptr || Count <= 0; }
+
+	// items only stack with items of the same kind and wear, so a merged stack never loses
+	// anyone's durability
+	bool CanStackWith(const FItemStack& Other) const
+	{
+		return ItemClass == Other.ItemClass && Durability == Other.Durability;
+	}
+
+	// most items of this kind a slot holds
+	int32 GetMaxCount() const;
+};
+
 UCLASS()
 class MCUE_API AWieldable : public AActor
 {
@@ -40,10 +87,9 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-public:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+public:
 
 	UPROPERTY(EditAnywhere)
 		ETool ToolType;
@@ -54,19 +100,37 @@ public:
 	UPROPERTY(EditAnywhere)
 		USkeletalMeshComponent* WieldableMesh;
 	
+	// kept for the item blueprints built on it, pickups are found through the pickup manager
 	UPROPERTY(EditAnywhere)
 		UShapeComponent* PickupTrigger;
 
-	UFUNCTION()
-		void OnRadiusEnter(class UPrimitiveComponent* HitComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
-
 	UPROPERTY(EditDefaultsOnly)
 		UTexture2D* PickupThumbnail;
 
+	//most items of this kind one inventory slot holds, tools always take a slot each
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "1"))
+		int32 MaxStackSize;
+
+	//how many items lying here, picked up together
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "1"))
+		int32 Count;
+
+	//uses left before the item breaks, 0 for items that don't wear
+	UPROPERTY(EditAnywhere)
+		int32 Durability;
+
 	bool bIsActive;
 
-	void OnPickedUp();
+	// where the pickup manager keeps the item while it spins on the ground, INDEX_NONE otherwise
+	int32 PickupIndex;
 
-	void OnUsed();
+	// grid cell the pickup manager sorted the item into
+	FIntVector PickupCell;
+
+	// the items lying here as an inventory stack
+	FItemStack GetItemStack() const { return FItemStack(GetClass(), Count, Durability); }
+
+	// the items went into an inventory, the actor leaves the world until it is dropped again
+	void OnPickedUp();
 
 };